@@ -0,0 +1,232 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Bare-Metal HAL
+
+Description: Header-only stand-in for the Arduino core, so the firmware
+sources build unchanged with avr-gcc alone. Only what the firmware uses is
+provided. Every call is an inline register operation: with the constant pins
+the firmware always passes, pinMode(), digitalRead() and digitalWrite()
+compile to single sbi, cbi or in instructions. Sketch-Main.h has the rest of
+the core, main() and the timer0 interrupt behind millis().
+
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef BAREMETALHAL
+#define BAREMETALHAL
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+#define HAL_INLINE  inline __attribute__((always_inline))
+
+////////////////////
+// Arduino Basics //
+////////////////////
+
+#define HIGH          0x1
+#define LOW           0x0
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+// ATtiny84 (attiny core): digital 0-7 are PA0-PA7, 8-10 are PB2-PB0.
+// Analog channel n is ADCn on PAn.
+#define A0            0
+#define A1            1
+#define A2            2
+#define A3            3
+#define A4            4
+#define A5            5
+#define A6            6
+#define A7            7
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#ifdef abs
+#undef abs
+#endif
+#define abs(x)                  ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define bitRead(value, bit)         (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)          ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)        ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) \
+  (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+
+void setup();
+void loop();
+
+//////////////////
+// Digital Pins //
+//////////////////
+
+HAL_INLINE volatile uint8_t& pinDDR(uint8_t pin) {
+  return (pin < 8) ? DDRA : DDRB;
+}
+
+HAL_INLINE volatile uint8_t& pinPORT(uint8_t pin) {
+  return (pin < 8) ? PORTA : PORTB;
+}
+
+HAL_INLINE volatile uint8_t& pinPIN(uint8_t pin) {
+  return (pin < 8) ? PINA : PINB;
+}
+
+HAL_INLINE uint8_t pinBit(uint8_t pin) {
+  return _BV((pin < 8) ? pin : 10 - pin);
+}
+
+// sbi and cbi cannot be interrupted. A pin only known at run time takes a
+// read-modify-write instead, so that one is done with interrupts off.
+HAL_INLINE void writePinBit(volatile uint8_t& reg, uint8_t pin, bool set) {
+  if (set) {
+    reg |= pinBit(pin);
+  } else {
+    reg &= ~pinBit(pin);
+  }
+}
+
+HAL_INLINE void pinMode(uint8_t pin, uint8_t mode) {
+  uint8_t sreg = 0;
+  if (!__builtin_constant_p(pin)) {
+    sreg = SREG;
+    cli();
+  }
+  // An input's pull-up is off unless asked for, as in the Arduino core
+  writePinBit(pinDDR(pin), pin, mode == OUTPUT);
+  if (mode != OUTPUT) {
+    writePinBit(pinPORT(pin), pin, mode == INPUT_PULLUP);
+  }
+  if (!__builtin_constant_p(pin)) {
+    SREG = sreg;
+  }
+}
+
+HAL_INLINE void digitalWrite(uint8_t pin, uint8_t val) {
+  uint8_t sreg = 0;
+  if (!__builtin_constant_p(pin)) {
+    sreg = SREG;
+    cli();
+  }
+  writePinBit(pinPORT(pin), pin, val != LOW);
+  if (!__builtin_constant_p(pin)) {
+    SREG = sreg;
+  }
+}
+
+HAL_INLINE int digitalRead(uint8_t pin) {
+  return (pinPIN(pin) & pinBit(pin)) ? HIGH : LOW;
+}
+
+//////////////////
+// Analog Input //
+//////////////////
+
+// Blocking conversion against Vcc. Not for use while the ADC sampler has the
+// converter.
+HAL_INLINE int analogRead(uint8_t pin) {
+  ADMUX   = pin & 0x07;
+  ADCSRA |= _BV(ADSC);
+  while (ADCSRA & _BV(ADSC)) {}
+  return ADC;
+}
+
+//////////
+// Time //
+//////////
+
+// Timer0 runs at prescaler 64 as in the Arduino core, overflowing every
+// 2.048 ms at 8 MHz. Its interrupt keeps whole milliseconds and eighths of
+// the remainder, the same arithmetic as the core's.
+#define TIMER0_OVERFLOW_US  (64UL*256*1000000/F_CPU)
+#define TIMER0_MILLIS_INC   (TIMER0_OVERFLOW_US/1000)
+#define TIMER0_FRACT_INC    ((TIMER0_OVERFLOW_US % 1000) >> 3)
+#define TIMER0_FRACT_MAX    (1000 >> 3)
+
+extern volatile uint32_t timer0millis;
+extern volatile uint32_t timer0overflows;
+
+HAL_INLINE uint32_t millis() {
+  uint8_t  sreg = SREG;
+  cli();
+  uint32_t ms   = timer0millis;
+  SREG = sreg;
+  return ms;
+}
+
+HAL_INLINE uint32_t micros() {
+  uint8_t  sreg      = SREG;
+  cli();
+  uint32_t overflows = timer0overflows;
+  uint8_t  count     = TCNT0;
+  // An overflow not yet counted by the interrupt
+  if ((TIFR0 & _BV(TOV0)) && count < 255) {
+    overflows++;
+  }
+  SREG = sreg;
+  return ((overflows << 8) + count)*(64/(F_CPU/1000000));
+}
+
+inline void delay(uint32_t ms) {
+  uint32_t start = micros();
+  while (ms > 0) {
+    if (micros() - start >= 1000) {
+      ms--;
+      start += 1000;
+    }
+  }
+}
+
+// Four cycles a pass, the Arduino core's loop for 8 MHz
+inline void delayMicroseconds(unsigned int us) {
+  if (us <= 1) {
+    return;
+  }
+  us = (us << 1) - 2;
+  __asm__ __volatile__ (
+    "1: sbiw %0,1" "\n\t"
+    "brne 1b" : "=w" (us) : "0" (us)
+  );
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min)*(out_max - out_min)/(in_max - in_min) + out_min;
+}
+
+#endif
@@ -0,0 +1,98 @@
+# Blue Robotics Thruster Commander Firmware - Bare-Metal Build
+#
+# Per-function size and cycle estimate from `avr-objdump -d
+# --no-show-raw-insn`. The estimate is every instruction of the function run
+# once on the ATtiny84's AVRe core, branches and skips not taken and calls not
+# followed into: a figure for comparing two builds of the same code, not a
+# worst case. Given a second listing (the Arduino build) it lines the two up
+# by function name, with functions only in the second at the end.
+#
+#   awk [-v titles="bare-metal arduino"] -f Cycle-Estimate.awk bare.lst \
+#       [arduino.lst]
+
+BEGIN {
+  FS = "\t"
+  n = split("adiw sbiw ld ldd st std lds sts push pop sbi cbi rjmp ijmp",
+            ops, " ")
+  for (i = 1; i <= n; i++) {
+    cost[ops[i]] = 2
+  }
+  n = split("rcall icall lpm jmp", ops, " ")
+  for (i = 1; i <= n; i++) {
+    cost[ops[i]] = 3
+  }
+  n = split("call ret reti", ops, " ")
+  for (i = 1; i <= n; i++) {
+    cost[ops[i]] = 4
+  }
+}
+
+FNR == 1 {
+  file++
+  files = file
+  source[file] = FILENAME
+}
+
+# Function label: "000000aa <loop>:"
+/^[0-9a-f]+ <.*>:$/ {
+  name = $0
+  sub(/^[0-9a-f]+ </, "", name)
+  sub(/>:$/, "", name)
+  if (!((file, name) in bytes)) {
+    bytes[file, name] = 0
+    count[file]++
+    order[file, count[file]] = name
+  }
+  next
+}
+
+# Instruction: "  aa:<tab>push<tab>r28"
+/^ +[0-9a-f]+:\t/ && name != "" {
+  op = $2
+  gsub(/ /, "", op)
+  bytes[file, name] += (op == "lds" || op == "sts" || op == "jmp" \
+                        || op == "call") ? 4 : 2
+  cycles[file, name] += (op in cost) ? cost[op] : 1
+  next
+}
+
+function row(name,    i, line) {
+  line = sprintf("  %-32.32s", name)
+  for (i = 1; i <= files; i++) {
+    if ((i, name) in bytes) {
+      line = line sprintf(" %8d %8d", bytes[i, name], cycles[i, name])
+      total[i, "bytes"]  += bytes[i, name]
+      total[i, "cycles"] += cycles[i, name]
+    } else {
+      line = line sprintf(" %8s %8s", "-", "-")
+    }
+  }
+  print line
+}
+
+END {
+  split(titles, title, " ")
+  header = sprintf("  %-32s", "")
+  for (i = 1; i <= files; i++) {
+    header = header sprintf(" %17.17s", (i in title) ? title[i] : source[i])
+  }
+  print header
+  header = sprintf("  %-32s", "function")
+  for (i = 1; i <= files; i++) {
+    header = header sprintf(" %8s %8s", "bytes", "cycles")
+  }
+  print header
+  for (i = 1; i <= count[1]; i++) {
+    row(order[1, i])
+  }
+  for (i = 1; i <= count[2]; i++) {
+    if (!((1, order[2, i]) in bytes)) {
+      row(order[2, i])
+    }
+  }
+  line = sprintf("  %-32s", "total")
+  for (i = 1; i <= files; i++) {
+    line = line sprintf(" %8d %8d", total[i, "bytes"], total[i, "cycles"])
+  }
+  print line
+}
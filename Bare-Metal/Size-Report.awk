@@ -0,0 +1,19 @@
+# Blue Robotics Thruster Commander Firmware - Bare-Metal Build
+#
+# Flash and RAM use of an image from `avr-size -A`, against the ATtiny84's
+# 8 KB of flash and 512 bytes of RAM. Flash holds .text and the initial
+# values of .data; RAM holds .data, .bss and .noinit, the rest is stack.
+#
+#   avr-size -A image.elf | awk -v title=name -f Size-Report.awk
+
+$1 == ".text" || $1 == ".data" {
+  flash += $2
+}
+$1 == ".data" || $1 == ".bss" || $1 == ".noinit" {
+  ram += $2
+}
+
+END {
+  printf "%-12s flash %5d bytes %5.1f %%   RAM %4d bytes %5.1f %%\n",
+         title, flash, 100*flash/8192, ram, 100*ram/512
+}
@@ -0,0 +1,84 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Bare-Metal Main
+
+Description: The parts of the Arduino core that cannot live in a header
+included by every source: main(), which sets up the timers as the core's
+init() does before calling setup() and loop(), and the timer0 overflow
+interrupt that keeps millis(). The bare-metal build force-includes this into
+the sketch alone.
+
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef SKETCHMAIN
+#define SKETCHMAIN
+
+#include <Arduino.h>
+
+volatile uint32_t timer0millis;
+volatile uint32_t timer0overflows;
+
+namespace {
+
+uint8_t timer0fract;
+
+} // namespace
+
+// Triggered every time TIMER0 overflows (488 Hz)
+ISR(TIM0_OVF_vect) {
+  uint32_t ms    = timer0millis;
+  uint8_t  fract = timer0fract + TIMER0_FRACT_INC;
+
+  ms += TIMER0_MILLIS_INC;
+  if (fract >= TIMER0_FRACT_MAX) {
+    fract -= TIMER0_FRACT_MAX;
+    ms++;
+  }
+  timer0millis  = ms;
+  timer0fract   = fract;
+  timer0overflows++;
+}
+
+// The core's init() less what the firmware sets up itself: timer0 fast PWM
+// at prescaler 64 for millis() and the indicator, ADC enabled at 125 kHz.
+// Timer1 is left alone, the servo driver configures all of it.
+int main() {
+  sei();
+
+  TCCR0A = _BV(WGM01) | _BV(WGM00);
+  TCCR0B = _BV(CS01) | _BV(CS00);
+  TIMSK0 = _BV(TOIE0);
+
+  ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1);
+
+  setup();
+  for (;;) {
+    loop();
+  }
+}
+
+#endif
@@ -0,0 +1,269 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Arduino Core
+
+Description: Stand-in for the Arduino core and the ATtiny84 register file so
+the firmware sources compile unchanged on a Linux host. Only what the firmware
+uses is provided. Register names are objects that report reads and writes to
+the simulated hardware in Sim-Hardware.cpp.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef ARDUINO_MOCK
+#define ARDUINO_MOCK
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Sim-Hardware.h"
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+////////////////////
+// Arduino Basics //
+////////////////////
+
+#define HIGH          0x1
+#define LOW           0x0
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+// ATtiny84 (attiny core): digital 0-7 are PA0-PA7, 8-10 are PB2-PB0.
+// Analog channel n is ADCn on PAn.
+#define A0            0
+#define A1            1
+#define A2            2
+#define A3            3
+#define A4            4
+#define A5            5
+#define A6            6
+#define A7            7
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#ifdef abs
+#undef abs
+#endif
+#define abs(x)                  ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define _BV(bit)                    (1 << (bit))
+#define bitRead(value, bit)         (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)          ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)        ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) \
+  (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t val);
+int      digitalRead(uint8_t pin);
+int      analogRead(uint8_t pin);
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+void     delayMicroseconds(unsigned int us);
+long     map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(addr)     (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t*)(addr))
+
+// avr-gcc exact cycle delay; the simulator just lets the time pass
+#define __builtin_avr_delay_cycles(cycles)  simAdvance(cycles)
+
+void     setup();
+void     loop();
+
+////////////////
+// Interrupts //
+////////////////
+
+void     cli();
+void     sei();
+
+#define SIGNAL(vector)      extern "C" void vector(void)
+#define ISR(vector, ...)    extern "C" void vector(void)
+
+extern "C" {
+void PCINT0_vect(void) __attribute__((weak));
+void WDT_vect(void) __attribute__((weak));
+void TIM1_COMPA_vect(void) __attribute__((weak));
+void TIM1_COMPB_vect(void) __attribute__((weak));
+void TIM1_OVF_vect(void) __attribute__((weak));
+void TIM0_COMPA_vect(void) __attribute__((weak));
+void ADC_vect(void) __attribute__((weak));
+void USI_STR_vect(void) __attribute__((weak));
+void USI_OVF_vect(void) __attribute__((weak));
+}
+
+///////////////
+// Registers //
+///////////////
+
+// Status register
+extern SimReg8  SREG;
+#define SREG_I  7
+
+// Timer0
+extern SimReg8  TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+#define WGM00   0
+#define WGM01   1
+#define COM0B0  4
+#define COM0B1  5
+#define COM0A0  6
+#define COM0A1  7
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define WGM02   3
+#define TOIE0   0
+#define OCIE0A  1
+#define OCIE0B  2
+#define TOV0    0
+#define OCF0A   1
+#define OCF0B   2
+
+// Timer1
+extern SimReg8  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern SimReg16 TCNT1, OCR1A, OCR1B, ICR1;
+#define WGM10   0
+#define WGM11   1
+#define COM1B0  4
+#define COM1B1  5
+#define COM1A0  6
+#define COM1A1  7
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+#define ICES1   6
+#define ICNC1   7
+#define FOC1B   6
+#define FOC1A   7
+#define TOIE1   0
+#define OCIE1A  1
+#define OCIE1B  2
+#define ICIE1   5
+#define TOV1    0
+#define OCF1A   1
+#define OCF1B   2
+#define ICF1    5
+
+// ADC
+extern SimReg8  ADMUX, ADCSRA, ADCSRB, DIDR0;
+extern SimReg16 ADC;
+#define MUX0    0
+#define MUX1    1
+#define MUX2    2
+#define MUX3    3
+#define MUX4    4
+#define MUX5    5
+#define REFS0   6
+#define REFS1   7
+#define ADPS0   0
+#define ADPS1   1
+#define ADPS2   2
+#define ADIE    3
+#define ADIF    4
+#define ADATE   5
+#define ADSC    6
+#define ADEN    7
+#define ADLAR   4
+
+// Pin change interrupts
+extern SimReg8  GIMSK, GIFR, PCMSK0, PCMSK1;
+#define PCIE0   4
+#define PCIE1   5
+#define INT0    6
+#define PCIF0   4
+#define PCIF1   5
+#define INTF0   6
+
+// Watchdog and reset flags
+extern SimReg8  WDTCSR, MCUSR;
+#define WDP0    0
+#define WDP1    1
+#define WDP2    2
+#define WDE     3
+#define WDCE    4
+#define WDP3    5
+#define WDIE    6
+#define WDIF    7
+#define PORF    0
+#define EXTRF   1
+#define BORF    2
+#define WDRF    3
+
+// Universal serial interface
+extern SimReg8  USICR, USISR, USIDR, USIBR;
+#define USITC   0
+#define USICLK  1
+#define USICS0  2
+#define USICS1  3
+#define USIWM0  4
+#define USIWM1  5
+#define USIOIE  6
+#define USISIE  7
+#define USICNT0 0
+#define USIDC   4
+#define USIPF   5
+#define USIOIF  6
+#define USISIF  7
+
+// Sleep and power reduction
+extern SimReg8  MCUCR, PRR;
+#define SM0     3
+#define SM1     4
+#define SE      5
+#define PRADC   0
+#define PRUSI   1
+#define PRTIM0  2
+#define PRTIM1  3
+
+// Ports
+extern SimReg8  PORTA, DDRA, PINA, PORTB, DDRB, PINB;
+#define PA0     0
+#define PA1     1
+#define PA2     2
+#define PA3     3
+#define PA4     4
+#define PA5     5
+#define PA6     6
+#define PA7     7
+#define PB0     0
+#define PB1     1
+#define PB2     2
+#define PB3     3
+
+#endif
@@ -0,0 +1,86 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Baseline Benchmark
+
+Description: Runs the firmware against a scripted set of pot steps in L/R
+mode and reports what each kind of loop() pass costs and how long an input
+change takes to reach the thruster pulses.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+
+#define BASELINE_RUN_MS   30000
+#define BASELINE_STEP_MS  1337      // not a multiple of any firmware period
+
+void benchBaseline() {
+#if PWM_SCHEDULED
+  printf("\nBaseline: skipped, it times OC1A/OC1B pulses and the outputs "
+         "come from the PWM scheduler\n");
+#else
+  LoopStats stats;
+  std::vector<uint64_t> stepcycles;
+
+  // L and R pots centered, STR floating, switch enabled
+  scriptAnalog(0, INPUT_L, 512);
+  scriptAnalog(0, INPUT_R, 512);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+
+  // Alternate both pots between center and ahead
+  bool ahead = false;
+  for (uint32_t ms = 1000; ms < BASELINE_RUN_MS - BASELINE_STEP_MS;
+       ms += BASELINE_STEP_MS) {
+    ahead = !ahead;
+    scriptAnalog(ms, INPUT_L, ahead ? 900 : 512);
+    scriptAnalog(ms, INPUT_R, ahead ? 900 : 512);
+    stepcycles.push_back((uint64_t)ms*SIM_CYCLES_PER_MS);
+  }
+
+  bootFirmware(&stats);
+  runFirmware(BASELINE_RUN_MS, &stats);
+
+  std::vector<StepLatency> steps;
+  for (size_t i = 0; i < stepcycles.size(); i++) {
+    steps.push_back(measureStep(stepcycles[i], PWM_L));
+    steps.push_back(measureStep(stepcycles[i], PWM_R));
+  }
+
+  static const char *protocols[] = { "PWM50", "PWM400", "OneShot125",
+                                     "OneShot42", "DShot150" };
+  printf("\nBaseline: %s output, control update %s\n",
+         protocols[PWM_PROTOCOL],
+         FRAME_SYNC ? "synced to the PWM frame" : "every UPDATE_DT");
+  printLoopStats("Baseline: loop() cost per pass (virtual time, ops/call)",
+                 stats);
+  printLatencies("Baseline: input-to-output latency", steps);
+
+  if (traceFile) {
+    writeTrace(traceFile);
+  }
+#endif
+}
@@ -0,0 +1,563 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Black Box Benchmark
+
+Description: Decodes the black box log the firmware keeps in EEPROM back
+into a time series of inputs, outputs, blink pattern and detect flags. In a
+BLACK_BOX build it drives a minute of pots moving and the switch going off
+and on, several times round the log, then powers the part off at moments
+spread over a batch being written and boots it again. Checks that every
+sample decoded from the EEPROM is the one the firmware logged, that power
+loss never leaves a record that decodes wrong, how evenly the EEPROM wears,
+and that the recorder stays within its time budgets: what it adds to an
+update, and each run of its writer in the task table. It can also decode an
+EEPROM image read from a real board.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include <vector>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Black-Box.h"
+#include "Task-Scheduler.h"
+#include "Sketch-Prototypes.h"
+
+
+#define BOX_RUN_MS        60000     // first session, round the log a few times
+#define BOX_OFF_MS        50000     // switch off, outputs ramp to neutral
+#define BOX_ON_MS         55000     // and on again
+#define BOX_STEP_MS       1337      // R pot steps
+#define BOX_SWEEP_MS      8000      // L pot goes end to end and back
+#define BOX_CUT_MS        8000      // second session, power cut from here
+#define BOX_CUTS          12        // cut times, BOX_CUT_GAP ms apart
+#define BOX_CUT_GAP       7
+#define BOX_REBOOT_MS     3000      // third session, after the cut
+#define BOX_MAX_SAMPLES   (BOX_RUN_MS/BLACK_BOX_DT + 16)
+#define BOX_PRINT_ROWS    12        // of a session's time series
+#define BOX_RECORDS       400       // direct calls for the time budgets
+#define BOX_ENDURANCE     100000    // rated writes per EEPROM byte
+
+// The most the recorder may add to an update, in us, and estimated ATtiny84
+// cycles of its worst case, a full sample at the start of a block, on top of
+// what the simulator charges: the interval test (20), changedFields() over seven
+// fields (7*18), sampleBytes() twice (2*(5*14 + 20)), the block header and
+// bookkeeping (60), 15 bytes through put() (15*20) and putSample()'s loops
+// (7*14 + 7*10). The update builds the sample every pass (40).
+#define RECORD_BUDGET     150
+#define RECORD_CYCLES     (20 + 7*18 + 2*(5*14 + 20) + 60 + 15*20 + 7*14 \
+                           + 7*10 + 40)
+// A run of the writer: eeprom_is_ready() (2), choosing a batch (40), the
+// step's address and ring offset (35) and the bookkeeping after a batch
+// (45), on top of the EEPROM read and write start the simulator charges
+#define FLUSH_CYCLES      (2 + 40 + 35 + 45)
+
+namespace {
+
+// One sample decoded from the log
+struct Decoded {
+  int            session;           // counted from the oldest in the log
+  uint16_t       index;             // samples since its power-up
+  bool           known;             // false for one the ring dropped
+  BlackBoxSample values;
+};
+
+int16_t readDelta(const uint8_t *block, uint8_t *at) {
+  uint8_t first = block[(*at)++];
+  if (!(first & 0x80)) {
+    return (int16_t)(first << 9) >> 9;
+  }
+  uint16_t value = ((first & 0x7F) << 8) | block[(*at)++];
+  return (int16_t)(value << 1) >> 1;
+}
+
+void clearValues(BlackBoxSample *values) {
+  memset(values, 0, sizeof(*values));
+  values->field[BOX_OUT_L] = PWM_NEUTRAL;
+  values->field[BOX_OUT_R] = PWM_NEUTRAL;
+}
+
+uint8_t nextSeq(uint8_t s) {
+  return (s < BOX_ERASED - 1) ? s + 1 : 0;
+}
+
+// The blocks in the order they were written: back from the newest for as
+// long as each follows on from the one before it
+std::vector<uint8_t> blockOrder(const uint8_t *eeprom) {
+  std::vector<uint8_t> order;
+  const uint8_t *log = eeprom + BLACK_BOX_EEPROM;
+  int newest = -1;
+  for (uint8_t b = 0; b < BLACK_BOX_BLOCKS && newest < 0; b++) {
+    uint8_t s    = log[b*BLACK_BOX_BLOCK];
+    uint8_t next = log[((b + 1) % BLACK_BOX_BLOCKS)*BLACK_BOX_BLOCK];
+    if (s != BOX_ERASED && next != nextSeq(s)) {
+      newest = b;
+    }
+  }
+  if (newest < 0) {
+    return order;
+  }
+  uint8_t b = newest;
+  order.insert(order.begin(), b);
+  for (uint8_t i = 1; i < BLACK_BOX_BLOCKS; i++) {
+    uint8_t before = (b + BLACK_BOX_BLOCKS - 1) % BLACK_BOX_BLOCKS;
+    uint8_t s      = log[before*BLACK_BOX_BLOCK];
+    if (s == BOX_ERASED || nextSeq(s) != log[b*BLACK_BOX_BLOCK]) {
+      break;
+    }
+    b = before;
+    order.insert(order.begin(), b);
+  }
+  return order;
+}
+
+// The whole log as a time series. False if a record runs past its block.
+bool decodeLog(const uint8_t *eeprom, std::vector<Decoded> *series) {
+  std::vector<uint8_t> order = blockOrder(eeprom);
+  int  session = 0;
+  bool ok      = true;
+
+  series->clear();
+  for (size_t i = 0; i < order.size(); i++) {
+    const uint8_t *block = eeprom + BLACK_BOX_EEPROM
+                           + order[i]*BLACK_BOX_BLOCK;
+    Decoded d;
+    d.session = session;
+    d.index   = block[1] | (block[2] << 8);
+    d.known   = true;
+    clearValues(&d.values);
+
+    uint8_t at = BOX_HEADER;
+    while (at < BLACK_BOX_BLOCK) {
+      uint8_t code = block[at++];
+      if (code == BOX_END || code == BOX_ERASED) {
+        break;
+      }
+      if (code == BOX_POWER_UP) {
+        d.session = ++session;
+        d.index   = 0;
+        clearValues(&d.values);
+      } else if (code == BOX_GAP) {
+        uint8_t n = block[at++];
+        d.known = false;
+        for (uint8_t k = 0; k < n; k++) {
+          series->push_back(d);
+          d.index++;
+        }
+        d.known = true;
+      } else if (code > BOX_RUN) {
+        for (uint8_t k = 0; k < code - BOX_RUN; k++) {
+          series->push_back(d);
+          d.index++;
+        }
+      } else {
+        for (uint8_t f = 0; f < BOX_PATTERN; f++) {
+          if (code & (1 << f)) {
+            d.values.field[f] += readDelta(block, &at);
+          }
+        }
+        if (code & (1 << BOX_PATTERN)) {
+          d.values.field[BOX_PATTERN] = block[at] | (block[at + 1] << 8);
+          at += 2;
+        }
+        if (code & (1 << BOX_FLAGS)) {
+          d.values.field[BOX_FLAGS] = block[at++];
+        }
+        series->push_back(d);
+        d.index++;
+      }
+    }
+    if (at > BLACK_BOX_BLOCK) {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+void printRow(const Decoded& d) {
+  static const char letters[] = "ECLRPS";
+  char flags[8];
+  for (uint8_t i = 0; i < 6; i++) {
+    flags[i] = (d.values.field[BOX_FLAGS] & (1 << i)) ? letters[i] : '-';
+  }
+  flags[6] = 0;
+
+  printf("  %7d %8.1f", d.session, d.index*BLACK_BOX_DT/1000.0);
+  if (!d.known) {
+    printf("  not logged, the ring was full\n");
+    return;
+  }
+  printf(" %5d %5d %6d %6d %6d   0x%04x %6s\n",
+         d.values.field[BOX_INPUT_L], d.values.field[BOX_INPUT_R],
+         d.values.field[BOX_INPUT_STR], d.values.field[BOX_OUT_L],
+         d.values.field[BOX_OUT_R], (uint16_t)d.values.field[BOX_PATTERN],
+         flags);
+}
+
+void printHeading() {
+  printf("  %7s %8s %5s %5s %6s %6s %6s %8s %6s\n", "session", "time s",
+         "in L", "in R", "in STR", "out L", "out R", "pattern", "flags");
+  printf("  (inputs in adc counts, outputs in us; flags: Enabled, "
+         "Classified, L R sPd Str connected)\n");
+}
+
+void printSeries(const std::vector<Decoded>& series, size_t from) {
+  printHeading();
+  for (size_t i = from; i < series.size(); i++) {
+    printRow(series[i]);
+  }
+}
+
+void decodeFile(const char *path) {
+  uint8_t eeprom[SIM_EEPROM_SIZE];
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  memset(eeprom, BOX_ERASED, sizeof(eeprom));
+  size_t got = fread(eeprom, 1, sizeof(eeprom), f);
+  fclose(f);
+  if (got < BLACK_BOX_EEPROM + BLACK_BOX_BLOCKS*BLACK_BOX_BLOCK) {
+    printf("\nBlack box: %s is too short for the log\n", path);
+    return;
+  }
+
+  std::vector<Decoded> series;
+  bool ok = decodeLog(eeprom, &series);
+  printf("\nBlack box: log from EEPROM image, %u blocks in order, "
+         "%u samples%s\n", (uint32_t)blockOrder(eeprom).size(),
+         (uint32_t)series.size(), ok ? "" : ", a record runs past its block");
+  printSeries(series, 0);
+}
+
+#if BLACK_BOX
+
+// What a session leaves behind, passed from the child that ran it to the
+// parent and on to the child that boots again afterwards
+struct Session {
+  uint8_t        eeprom[SIM_EEPROM_SIZE];
+  uint32_t       writes[SIM_EEPROM_SIZE];
+  uint16_t       samples;
+  BlackBoxSample logged[BOX_MAX_SAMPLES];
+  TaskStats      update, flush;       // up to BOX_OFF_MS
+  uint8_t        maxpending;
+  uint32_t       recordcycles;        // charged, worst of BOX_RECORDS
+  uint32_t       flushcycles;
+};
+
+const TaskStats& statsOf(void (*run)()) {
+  for (uint8_t i = 0; i < taskCount(); i++) {
+    if (taskEntry(i).run == run) {
+      return taskStats(i);
+    }
+  }
+  return taskStats(0);
+}
+
+// L sweeps end to end, R steps, STR is off; the switch goes off and on
+void scriptInputs(uint32_t until) {
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  for (uint32_t ms = 0; ms < until; ms += 100) {
+    uint32_t t = ms % BOX_SWEEP_MS;
+    int      l = (t < BOX_SWEEP_MS/2) ? t*1023/(BOX_SWEEP_MS/2)
+                                      : (BOX_SWEEP_MS - t)*1023/(BOX_SWEEP_MS/2);
+    scriptAnalog(ms, INPUT_L, l);
+  }
+  bool ahead = false;
+  scriptAnalog(0, INPUT_R, 512);
+  for (uint32_t ms = 1000; ms < until; ms += BOX_STEP_MS) {
+    ahead = !ahead;
+    scriptAnalog(ms, INPUT_R, ahead ? 200 : 700);
+  }
+  if (until > BOX_OFF_MS) {
+    scriptSwitch(BOX_OFF_MS, false);
+    scriptSwitch(BOX_ON_MS, true);
+  }
+}
+
+// Boot on what the session before left and run to the given time a
+// millisecond at a time, keeping the values logged for each sample
+void runSession(const void *arg, void *result) {
+  Session *s = (Session*)result;
+  uint32_t until = *(const uint32_t*)arg;
+  LoopStats stats;
+
+  scriptInputs(until);
+  memcpy(simEEPROM, s->eeprom, sizeof(simEEPROM));
+  memcpy(simEEPROMWrites, s->writes, sizeof(simEEPROMWrites));
+  bootFirmware(&stats);
+
+  s->samples    = 0;
+  s->maxpending = 0;
+  for (uint32_t ms = 1; ms <= until; ms++) {
+    runFirmware(ms, &stats);
+    while (s->samples < blackBoxSamples() && s->samples < BOX_MAX_SAMPLES) {
+      s->logged[s->samples++] = blackBoxLogged();
+    }
+    if (blackBoxPending() > s->maxpending) {
+      s->maxpending = blackBoxPending();
+    }
+    if (ms == BOX_OFF_MS) {
+      s->update = statsOf(updateOutputs);
+      s->flush  = statsOf(flushBlackBox);
+    }
+  }
+  if (until < BOX_OFF_MS) {
+    s->update = statsOf(updateOutputs);
+    s->flush  = statsOf(flushBlackBox);
+  }
+  memcpy(s->eeprom, simEEPROM, sizeof(s->eeprom));
+  memcpy(s->writes, simEEPROMWrites, sizeof(s->writes));
+}
+
+// Let time pass outside loop(), keeping the failsafe watchdog fed
+void idle(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    simAdvance(SIM_CYCLES_PER_MS);
+    simWatchdogReset();
+  }
+}
+
+// The recorder called directly, every sample a full one far from the last,
+// with the writer emptying the ring in between. Worst charged cycles of
+// each.
+void timeRecorder(const void *, void *result) {
+  Session *s = (Session*)result;
+  LoopStats stats;
+
+  simEraseEEPROM();
+  bootFirmware(&stats);
+  s->recordcycles = 0;
+  s->flushcycles  = 0;
+  for (uint32_t i = 0; i < BOX_RECORDS; i++) {
+    BlackBoxSample sample;
+    for (uint8_t f = 0; f < BOX_FIELDS; f++) {
+      sample.field[f] = (i & 1) ? 1000 + f : f;
+    }
+    idle(BLACK_BOX_DT);
+    uint64_t start = simNow();
+    recordBlackBox(sample);
+    uint32_t cycles = simNow() - start;
+    if (cycles > s->recordcycles) {
+      s->recordcycles = cycles;
+    }
+    while (blackBoxPending()) {
+      idle(BLACK_BOX_FLUSH_DT);
+      start = simNow();
+      flushBlackBox();
+      cycles = simNow() - start;
+      if (cycles > s->flushcycles) {
+        s->flushcycles = cycles;
+      }
+    }
+  }
+}
+
+// Samples in the log that differ from what the firmware logged. The latest
+// session in the log is the last of sessions, the one before it the one
+// before that. Unknown samples and those from earlier sessions are skipped.
+uint32_t compareLog(const std::vector<Decoded>& series,
+                    const Session *const *sessions, int count,
+                    uint32_t *compared, uint32_t *unknown) {
+  uint32_t wrong = 0;
+  int      last  = series.empty() ? 0 : series.back().session;
+  *compared = 0;
+  *unknown  = 0;
+  for (size_t i = 0; i < series.size(); i++) {
+    const Decoded& d = series[i];
+    int back = last - d.session;
+    if (back >= count) {
+      continue;
+    }
+    const Session& s = *sessions[count - 1 - back];
+    if (!d.known) {
+      (*unknown)++;
+      continue;
+    }
+    if (d.index >= s.samples
+        || memcmp(&d.values, &s.logged[d.index], sizeof(d.values)) != 0) {
+      wrong++;
+    }
+    (*compared)++;
+  }
+  return wrong;
+}
+
+// Wear over the log: the most and fewest writes to any byte, and how long
+// the most worn byte lasts at that rate
+void printWear(const Session& s, uint32_t laps) {
+  uint32_t most = 0, fewest = UINT32_MAX;
+  uint64_t total = 0;
+  for (uint16_t a = BLACK_BOX_EEPROM;
+       a < BLACK_BOX_EEPROM + BLACK_BOX_BLOCKS*BLACK_BOX_BLOCK; a++) {
+    uint32_t n = s.writes[a];
+    most   = n > most ? n : most;
+    fewest = n < fewest ? n : fewest;
+    total += n;
+  }
+  printf("Black box: wear over %u bytes, writes per byte %u-%u, mean %.1f, "
+         "%u laps of the log\n", BLACK_BOX_BLOCKS*BLACK_BOX_BLOCK, fewest,
+         most, (double)total/(BLACK_BOX_BLOCKS*BLACK_BOX_BLOCK), laps);
+  printf("  (at %u writes a byte, %.0f hours with the pots moving like "
+         "this)\n", BOX_ENDURANCE,
+         most ? (double)BOX_ENDURANCE/most*BOX_RUN_MS/3600000 : 0.0);
+}
+
+bool firmwareRuns() {
+  static Session first, cut, reboot, timing;
+  bool ok = true;
+
+  // A minute round the log a few times, on an erased EEPROM
+  memset(first.eeprom, BOX_ERASED, sizeof(first.eeprom));
+  memset(first.writes, 0, sizeof(first.writes));
+  uint32_t until = BOX_RUN_MS;
+  runInChild(runSession, &until, &first, sizeof(first));
+
+  std::vector<Decoded> series;
+  bool parsed = decodeLog(first.eeprom, &series);
+  uint32_t compared, unknown;
+  const Session *one[] = { &first };
+  uint32_t wrong = compareLog(series, one, 1, &compared, &unknown);
+  uint32_t laps  = 0;
+  for (uint8_t b = 0; b < BLACK_BOX_BLOCKS; b++) {
+    uint32_t n = first.writes[BLACK_BOX_EEPROM + b*BLACK_BOX_BLOCK];
+    laps = n > laps ? n : laps;
+  }
+
+  printf("\nBlack box: %u s session, %u samples logged, the log holds the "
+         "last %.1f s\n", BOX_RUN_MS/1000, first.samples,
+         series.empty() ? 0.0
+         : (series.back().index - series.front().index + 1)
+           *BLACK_BOX_DT/1000.0);
+  printSeries(series, series.size() > BOX_PRINT_ROWS
+                      ? series.size() - BOX_PRINT_ROWS : 0);
+  printf("Black box: %u samples decoded, %u not logged, %u wrong, "
+         "ring up to %u of %u bytes: %s\n", compared, unknown, wrong,
+         first.maxpending, BLACK_BOX_RING,
+         verdict(parsed && wrong == 0 && compared > 0));
+  ok = ok && parsed && wrong == 0 && compared > 0;
+  printWear(first, laps);
+
+  // Power lost at moments spread over the writes of a batch, then a boot
+  // that carries on after what was left
+  uint32_t cutwrong = 0, cutbad = 0, rebootwrong = 0, rebootbad = 0;
+  uint32_t minkept  = UINT32_MAX, maxkept = 0;
+  for (uint8_t c = 0; c < BOX_CUTS; c++) {
+    memcpy(cut.eeprom, first.eeprom, sizeof(cut.eeprom));
+    memcpy(cut.writes, first.writes, sizeof(cut.writes));
+    until = BOX_CUT_MS + c*BOX_CUT_GAP;
+    runInChild(runSession, &until, &cut, sizeof(cut));
+
+    const Session *two[] = { &first, &cut };
+    cutbad   += !decodeLog(cut.eeprom, &series);
+    cutwrong += compareLog(series, two, 2, &compared, &unknown);
+    uint32_t kept = 0;
+    for (size_t i = 0; i < series.size(); i++) {
+      kept += series[i].session == series.back().session;
+    }
+    minkept = kept < minkept ? kept : minkept;
+    maxkept = kept > maxkept ? kept : maxkept;
+
+    memcpy(reboot.eeprom, cut.eeprom, sizeof(reboot.eeprom));
+    memcpy(reboot.writes, cut.writes, sizeof(reboot.writes));
+    until = BOX_REBOOT_MS;
+    runInChild(runSession, &until, &reboot, sizeof(reboot));
+
+    const Session *three[] = { &first, &cut, &reboot };
+    rebootbad   += !decodeLog(reboot.eeprom, &series);
+    rebootwrong += compareLog(series, three, 3, &compared, &unknown);
+  }
+  printf("\nBlack box: power cut %u times %u-%u ms into a second session, "
+         "%u-%u of its %u samples survived\n", BOX_CUTS, BOX_CUT_MS,
+         BOX_CUT_MS + (BOX_CUTS - 1)*BOX_CUT_GAP, minkept, maxkept,
+         BOX_CUT_MS/BLACK_BOX_DT);
+  printf("Black box: after the cut %u wrong samples, %u logs unreadable; "
+         "after booting again %u wrong, %u unreadable: %s\n", cutwrong,
+         cutbad, rebootwrong, rebootbad,
+         verdict(cutwrong + cutbad + rebootwrong + rebootbad == 0));
+  ok = ok && cutwrong + cutbad + rebootwrong + rebootbad == 0;
+  printf("Black box: the last boot's log\n");
+  series.clear();
+  decodeLog(reboot.eeprom, &series);
+  size_t from = series.size();
+  while (from > 0 && series[from - 1].session >= series.back().session - 1
+         && series.size() - from < BOX_PRINT_ROWS) {
+    from--;
+  }
+  printSeries(series, from);
+
+  // Time budgets: the update with the recorder in it, and the writer's runs
+  runInChild(timeRecorder, 0, &timing, sizeof(timing));
+  double recordus = (timing.recordcycles + RECORD_CYCLES)
+                    /(double)SIM_CYCLES_PER_US;
+  double flushus  = (timing.flushcycles + FLUSH_CYCLES)
+                    /(double)SIM_CYCLES_PER_US;
+  bool   intime   = recordus <= RECORD_BUDGET && flushus <= BLACK_BOX_BUDGET
+                    && first.flush.overruns == 0
+                    && first.update.overruns == 0
+                    && first.flush.maxrun + FLUSH_CYCLES/SIM_CYCLES_PER_US
+                       <= BLACK_BOX_BUDGET
+                    && first.update.maxrun + RECORD_CYCLES/SIM_CYCLES_PER_US
+                       <= UPDATE_BUDGET;
+  printf("\nBlack box: time added, charged by the simulator plus estimated "
+         "AVR cycles\n");
+  printf("  %-22s %9s %9s %9s %9s\n", "", "charged", "est.", "us",
+         "budget us");
+  printf("  %-22s %9u %9u %9.1f %9u\n", "sample, worst case",
+         timing.recordcycles, RECORD_CYCLES, recordus, RECORD_BUDGET);
+  printf("  %-22s %9u %9u %9.1f %9u\n", "writer run",
+         timing.flushcycles, FLUSH_CYCLES, flushus, BLACK_BOX_BUDGET);
+  printf("Black box: in the session to %u ms the update ran %u times, "
+         "longest %u us, %u over %u us; the writer %u times, longest %u us, "
+         "%u over %u us: %s\n", BOX_OFF_MS, first.update.runs,
+         first.update.maxrun, first.update.overruns, UPDATE_BUDGET,
+         first.flush.runs, first.flush.maxrun, first.flush.overruns,
+         BLACK_BOX_BUDGET, verdict(intime));
+  return ok && intime;
+}
+
+#endif
+
+} // namespace
+
+void benchBlackBox() {
+  printf("\nBlack box: %u blocks of %u bytes at EEPROM address %u, a sample "
+         "every %u ms\n", BLACK_BOX_BLOCKS, BLACK_BOX_BLOCK, BLACK_BOX_EEPROM,
+         BLACK_BOX_DT);
+
+  if (eepromFile) {
+    decodeFile(eepromFile);
+    return;
+  }
+#if BLACK_BOX
+  firmwareRuns();
+#else
+  printf("\nBlack box: firmware runs skipped, build with "
+         "OPTIONS=\"-DBLACK_BOX=1\"\n");
+#endif
+}
@@ -0,0 +1,146 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Boot Benchmark
+
+Description: Powers the firmware up with different inputs connected and
+reads the output pulses back from the trace: when the first pulse went out,
+when both outputs had sent neutral (an ESC can arm from then on), whether
+anything but neutral went out before that, and when the first pulse
+following the pots went out.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+
+
+#define BOOT_RUN_MS       1000
+#define BOOT_POT          800       // pot reading, well off neutral
+#define BOOT_NEUTRAL_NS   ((int32_t)PWM_NEUTRAL*1000)
+
+namespace {
+
+#define POT_NONE  -1
+
+struct BootCase {
+  const char *name;
+  int         left, right, steering;    // pot readings or POT_NONE
+  uint32_t    switchms;                 // switch turned on
+};
+
+const BootCase cases[] = {
+  { "L and R pots",          BOOT_POT, BOOT_POT, POT_NONE, 0   },
+  { "SPD and STR pots",      BOOT_POT, POT_NONE, 600,      0   },
+  { "L pot only",            BOOT_POT, POT_NONE, POT_NONE, 0   },
+  { "nothing connected",     POT_NONE, POT_NONE, POT_NONE, 0   },
+  { "switch on at 500 ms",   BOOT_POT, BOOT_POT, POT_NONE, 500 },
+};
+
+void scriptPot(uint8_t channel, int value) {
+  if (value == POT_NONE) {
+    scriptDisconnect(0, channel);
+  } else {
+    scriptAnalog(0, channel, value);
+  }
+}
+
+double ms(int64_t cycle) {
+  return (cycle < 0) ? -1 : (double)cycle/SIM_CYCLES_PER_MS;
+}
+
+void runCase(const void *arg, void *) {
+  const BootCase& c = *(const BootCase*)arg;
+  LoopStats stats;
+
+  scriptPot(INPUT_L, c.left);
+  scriptPot(INPUT_R, c.right);
+  scriptPot(INPUT_STR, c.steering);
+  if (c.switchms == 0) {
+    scriptSwitch(0, true);
+  } else {
+    scriptSwitch(0, false);
+    scriptSwitch(c.switchms, true);
+  }
+
+  bootFirmware(&stats);
+  runFirmware(BOOT_RUN_MS, &stats);
+
+  // Per output: first pulse, first neutral pulse, first pulse off neutral
+  int64_t  first[2]   = { -1, -1 };
+  int64_t  neutral[2] = { -1, -1 };
+  int64_t  command    = -1;
+  int32_t  firstns[2] = { 0, 0 };
+  uint32_t early      = 0;           // off neutral before both were neutral
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind != EVENT_PULSE_A && e.kind != EVENT_PULSE_B) {
+      continue;
+    }
+    uint8_t out = (e.kind == EVENT_PULSE_A) ? 0 : 1; 
+    if (first[out] < 0) {
+      first[out]   = e.cycle;
+      firstns[out] = e.value;
+    }
+    if (e.value == BOOT_NEUTRAL_NS) {
+      if (neutral[out] < 0) {
+        neutral[out] = e.cycle;
+      }
+    } else if (neutral[0] < 0 || neutral[1] < 0) {
+      early++;
+    } else if (command < 0) {
+      command = e.cycle;
+    }
+  }
+  int64_t armed = (neutral[0] < 0 || neutral[1] < 0) ? -1
+                  : (neutral[0] > neutral[1] ? neutral[0] : neutral[1]);
+
+  printf("  %-22s %9.3f %9.3f %9.3f %10.3f %9.3f %6u\n", c.name,
+         stats.setupcycles/(double)SIM_CYCLES_PER_MS,
+         ms(first[0] > first[1] ? first[0] : first[1]),
+         firstns[0] > firstns[1] ? firstns[0]/1000.0 : firstns[1]/1000.0,
+         ms(armed), ms(command), early);
+}
+
+} // namespace
+
+void benchBoot() {
+#if PWM_SCHEDULED
+  printf("\nBoot: skipped, it times OC1A/OC1B pulses and the outputs come "
+         "from the PWM scheduler\n");
+  return;
+#endif
+  printf("\nBoot: times from power-on in ms, -1 for never "
+         "(first command counts from boot, not from the switch)\n");
+  printf("  %-22s %9s %9s %9s %10s %9s %6s\n", "case", "setup()",
+         "1st pulse", "width us", "armed", "1st cmd", "early");
+  // The firmware's globals only start out fresh once per process, so each
+  // power-up runs in a child of its own
+  for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+    if (!runInChild(runCase, &cases[i], 0, 0)) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,438 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Bus Benchmark
+
+Description: Runs several Commanders in I2C target mode behind one master,
+each in its own process with its own address, boot time and clock error,
+all seeing the same traffic in master time. The master writes every node a
+new command each frame, then sends the sync general call, now and then reads
+a node's registers back and addresses a node that is not there. Checks that
+every node puts each command out on the frame starting I2C_SYNC_LEAD after
+its sync, and not a frame earlier or later, and how far apart the nodes'
+frames start. Then the master goes quiet and every node must go to neutral.
+Last, one node runs again with a read given up part way through a byte and
+then the switch grounding SCL, and must go to neutral and take commands
+again once it is let go.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "I2C-Target.h"
+
+
+#define BUS_NODES       4
+#define BUS_PERIOD_US   20000         // a command and sync every PWM frame
+#define BUS_START_US    20000         // first commands, all nodes are up
+#define BUS_ARM_SYNC    5             // syncs sent disarmed before arming
+#define BUS_CHECK_SYNC  50            // limiters have caught up by then
+#define BUS_SYNCS       125           // then the master goes quiet
+#define BUS_RUN_MS      3200
+#define BUS_STEP        10            // us, command change per sync
+#define BUS_MATCH       1.5           // us, width taken as the command
+#define BUS_READ_EVERY  10            // syncs between register reads
+#define BUS_ABSENT      0x50          // address nobody has
+#define BUS_STUCK_SYNC  10            // the read after it is given up
+#define BUS_STUCK_FALLS 30            //   on this SCL fall, a bit into the
+                                      //   first byte read, the node holding
+                                      //   SDA low
+#define BUS_STUCK_MS    1200          // then the switch is on for this long
+#define BUS_STUCK_CHECK 100           // limiters have caught up again
+
+namespace {
+
+#if I2C_TARGET
+
+struct Node {
+  uint8_t  address;
+  double   bootus;      // master time at power-on
+  int32_t  ppm;         // clock error
+};
+
+const Node nodes[BUS_NODES] = {
+  { 0x30,     0,     0 },
+  { 0x31,  3700,  4000 },
+  { 0x32,  7100, -3000 },
+  { 0x33, 11300,  5000 },
+};
+
+enum PlanKind { PLAN_COMMAND, PLAN_SYNC, PLAN_READ, PLAN_ABSENT };
+
+// A transfer of the master's schedule, at a time in master us
+struct Planned {
+  uint8_t        kind;
+  uint8_t        node;
+  uint16_t       sync;
+  double         us;
+  SimI2CTransfer transfer;
+};
+
+// What a node's process reports back
+struct NodeReport {
+  double   rise[BUS_SYNCS];         // first frame after each sync, master us
+  bool     applied[BUS_SYNCS];      // it carried that sync's command, and
+                                    //   the frame before the last one's
+  uint8_t  syncacks;                // ACKs of the last sync
+  uint8_t  absentacks;              // ACKs of a transfer to BUS_ABSENT
+  uint8_t  regs[2][I2C_REGISTERS];  // the last two register reads
+  uint8_t  reads;
+  uint32_t stretchmax;              // cycles
+  uint32_t failed;                  // transfers to it not acknowledged
+  double   neutralms;               // from the last sync, -1 never
+};
+
+// Left command of a node at a sync, ramping up and down in BUS_STEP steps
+int commandAt(uint8_t node, uint16_t sync) {
+  uint16_t phase = sync % 40;
+  return 1520 + 20*node + BUS_STEP*(phase < 20 ? phase : 40 - phase);
+}
+
+int rightFor(int left) {
+  return 2*PWM_NEUTRAL - left;
+}
+
+double syncUs(uint16_t sync) {
+  return BUS_START_US + (double)sync*BUS_PERIOD_US + 3000;
+}
+
+// The switch in the stuck run, on node 0, so in master ms
+uint32_t stuckOnMs() {
+  return (uint32_t)(syncUs(BUS_STUCK_SYNC)/1000) + 2;
+}
+
+// No traffic from the given-up read until the switch is off
+bool stuckQuiet(uint16_t sync) {
+  return sync > BUS_STUCK_SYNC
+         && syncUs(sync) - 3000 < 1000.0*(stuckOnMs() + BUS_STUCK_MS);
+}
+
+// Node cycles at a master time, and back
+uint64_t nodeCycle(const Node& node, double us) {
+  return (uint64_t)((us - node.bootus)*SIM_CYCLES_PER_US
+                    *(1 + node.ppm/1e6));
+}
+
+double masterUs(const Node& node, uint64_t cycle) {
+  return node.bootus + cycle/(SIM_CYCLES_PER_US*(1 + node.ppm/1e6));
+}
+
+uint16_t regWord(const uint8_t *regs, uint8_t reg) {
+  return regs[reg] | (regs[reg + 1] << 8);
+}
+
+// Every frame: each node's command, then the sync. Every BUS_READ_EVERY
+// syncs one node's registers are read back, and half way between, a write
+// goes to BUS_ABSENT. In the stuck run the read after BUS_STUCK_SYNC is
+// given up and the bus is quiet while the switch is on.
+std::vector<Planned> busPlan(bool stuck) {
+  std::vector<Planned> plan;
+  for (uint16_t k = 0; k < BUS_SYNCS; k++) {
+    if (stuck && stuckQuiet(k)) {
+      continue;
+    }
+    double start = syncUs(k) - 3000;
+    for (uint8_t n = 0; n < BUS_NODES; n++) {
+      Planned p = { PLAN_COMMAND, n, k, start, SimI2CTransfer() };
+      int     l = commandAt(n, k);
+      int     r = rightFor(l);
+      uint8_t w[] = { I2C_REG_ARM, k >= BUS_ARM_SYNC,
+                      (uint8_t)(l & 0xFF), (uint8_t)(l >> 8),
+                      (uint8_t)(r & 0xFF), (uint8_t)(r >> 8) };
+      p.transfer.address = nodes[n].address;
+      p.transfer.writes  = sizeof(w);
+      memcpy(p.transfer.write, w, sizeof(w));
+      plan.push_back(p);
+    }
+    Planned s = { PLAN_SYNC, 0, k, syncUs(k), SimI2CTransfer() };
+    s.transfer.address  = 0;
+    s.transfer.writes   = 1;
+    s.transfer.write[0] = I2C_SYNC;
+    plan.push_back(s);
+
+    if (stuck && k == BUS_STUCK_SYNC) {
+      Planned r = { PLAN_READ, 0, k, syncUs(k) + 500, SimI2CTransfer() };
+      r.transfer.address  = nodes[0].address;
+      r.transfer.writes   = 1;
+      r.transfer.write[0] = I2C_REG_STATUS;
+      r.transfer.reads    = I2C_REGISTERS;
+      r.transfer.giveup   = BUS_STUCK_FALLS;
+      plan.push_back(r);
+    } else if (k % BUS_READ_EVERY == 0) {
+      Planned r = { PLAN_READ, (uint8_t)((k/BUS_READ_EVERY) % BUS_NODES), k,
+                    syncUs(k) + 500, SimI2CTransfer() };
+      r.transfer.address  = nodes[r.node].address;
+      r.transfer.writes   = 1;
+      r.transfer.write[0] = I2C_REG_STATUS;
+      r.transfer.reads    = I2C_REGISTERS;
+      plan.push_back(r);
+    } else if (k % BUS_READ_EVERY == BUS_READ_EVERY/2) {
+      Planned a = { PLAN_ABSENT, 0, k, syncUs(k) + 500, SimI2CTransfer() };
+      a.transfer.address  = BUS_ABSENT;
+      a.transfer.writes   = 1;
+      a.transfer.write[0] = I2C_REG_STATUS;
+      plan.push_back(a);
+    }
+  }
+  return plan;
+}
+
+double widthUs(const TracePulse& p) {
+  return (double)(p.fall - p.rise)/SIM_CYCLES_PER_US;
+}
+
+bool carries(const TracePulse& l, const TracePulse& r, int command) {
+  return fabs(widthUs(l) - command) <= BUS_MATCH
+         && fabs(widthUs(r) - rightFor(command)) <= BUS_MATCH;
+}
+
+////////////////////////
+// One Node's Process //
+////////////////////////
+
+// Which node, and whether it is the stuck run
+struct NodeRun {
+  uint8_t  node;
+  bool     stuck;
+};
+
+void runNode(const void *arg, void *result) {
+  uint8_t     n      = ((const NodeRun*)arg)->node;
+  bool        stuck  = ((const NodeRun*)arg)->stuck;
+  NodeReport *report = (NodeReport*)result;
+  const Node& node   = nodes[n];
+  LoopStats   stats;
+
+  simEraseEEPROM();
+  simEEPROM[I2C_EEPROM] = node.address;
+  scriptAnalog(0, INPUT_L, 700);
+  scriptAnalog(0, INPUT_R, 300);
+  scriptDisconnect(0, INPUT_STR);
+  if (stuck) {
+    scriptSwitch(stuckOnMs(), true);
+    scriptSwitch(stuckOnMs() + BUS_STUCK_MS, false);
+  }
+  bootFirmware(&stats);
+
+  // The master's traffic from here on, in this node's cycles
+  std::vector<Planned> plan = busPlan(stuck);
+  for (size_t i = 0; i < plan.size(); i++) {
+    SimI2CTransfer& t = plan[i].transfer;
+    t.cycle      = nodeCycle(node, plan[i].us);
+    t.halfcycles = (uint32_t)(SIM_I2C_HALF*(1 + node.ppm/1e6) + 0.5);
+    if (t.cycle > simNow()) {
+      simI2CTransfer(&t);
+    }
+  }
+  runFirmware((uint32_t)((BUS_RUN_MS - node.bootus/1000)
+                         *(1 + node.ppm/1e6)), 0);
+
+  memset(report, 0, sizeof(*report));
+  for (size_t i = 0; i < plan.size(); i++) {
+    const Planned&        p = plan[i];
+    const SimI2CTransfer& t = p.transfer;
+    if (t.stretchcycles > report->stretchmax) {
+      report->stretchmax = t.stretchcycles;
+    }
+    if (p.kind == PLAN_SYNC) {
+      report->syncacks = t.acks;
+    } else if (p.kind == PLAN_ABSENT) {
+      report->absentacks = t.acks;
+    } else if (p.node == n && t.acks != 1 + t.writes + (t.reads ? 1 : 0)) {
+      report->failed++;
+    } else if (p.kind == PLAN_READ && p.node == n) {
+      memcpy(report->regs[0], report->regs[1], I2C_REGISTERS);
+      memcpy(report->regs[1], t.read, I2C_REGISTERS);
+      report->reads++;
+    }
+  }
+
+  // The first frame after each sync, with the frame before it
+  std::vector<TracePulse> l = findPulses(PWM_L);
+  std::vector<TracePulse> r = findPulses(PWM_R);
+  size_t i = 0;
+  for (uint16_t k = 0; k < BUS_SYNCS; k++) {
+    report->rise[k] = -1;
+    while (i < l.size() && masterUs(node, l[i].rise) < syncUs(k)) {
+      i++;
+    }
+    if (i == 0 || i >= l.size() || i >= r.size()) {
+      continue;
+    }
+    report->rise[k]    = masterUs(node, l[i].rise);
+    report->applied[k] = carries(l[i], r[i], commandAt(n, k))
+                         && (k == 0 || carries(l[i - 1], r[i - 1],
+                                               commandAt(n, k - 1)));
+  }
+
+  // Quiet bus: neutral once the command times out and the limiter is back
+  double last = syncUs(stuck ? BUS_STUCK_SYNC : BUS_SYNCS - 1);
+  report->neutralms = -1;
+  for (size_t j = 0; j < l.size(); j++) {
+    double us = masterUs(node, l[j].rise);
+    if (us > last && fabs(widthUs(l[j]) - PWM_NEUTRAL) <= BUS_MATCH) {
+      report->neutralms = (us - last)/1000;
+      break;
+    }
+  }
+}
+
+// One process per node run, so each has its own firmware globals
+bool nodeInChild(uint8_t n, bool stuck, NodeReport *report) {
+  NodeRun run = { n, stuck };
+  if (!runInChild(runNode, &run, report, sizeof(*report))) {
+    printf("\nBus: node %u did not report\n", n);
+    return false;
+  }
+  return true;
+}
+
+#endif
+
+} // namespace
+
+void benchBus() {
+#if I2C_TARGET
+  NodeReport reports[BUS_NODES];
+
+  for (uint8_t n = 0; n < BUS_NODES; n++) {
+    if (!nodeInChild(n, false, &reports[n])) {
+      return;
+    }
+  }
+
+  uint32_t checked = BUS_SYNCS - BUS_CHECK_SYNC;
+  printf("\nBus: %u nodes at %u kHz, commands and a sync every %u ms, "
+         "syncs %u-%u checked\n", BUS_NODES,
+         (unsigned)(SIM_CLOCK_FREQ/1000/(2*SIM_I2C_HALF)),
+         BUS_PERIOD_US/1000, BUS_CHECK_SYNC, BUS_SYNCS - 1);
+  printf("  %-4s %5s %7s %7s %8s %9s %9s %9s %10s %9s\n", "node", "addr",
+         "boot ms", "clock %", "aligned", "min ms", "mean ms", "max ms",
+         "stretch us", "failed");
+
+  bool ok = true;
+  for (uint8_t n = 0; n < BUS_NODES; n++) {
+    const NodeReport& r = reports[n];
+    double   min = 1e30, max = -1e30, sum = 0;
+    uint32_t aligned = 0;
+    for (uint16_t k = BUS_CHECK_SYNC; k < BUS_SYNCS; k++) {
+      double lead = (r.rise[k] - syncUs(k))/1000;
+      aligned += r.applied[k] && r.rise[k] >= 0;
+      sum += lead;
+      if (lead < min) min = lead;
+      if (lead > max) max = lead;
+    }
+    printf("  %-4u  0x%02X %7.1f %7.2f %4u/%-3u %9.3f %9.3f %9.3f %10.1f "
+           "%9u\n", n, nodes[n].address, nodes[n].bootus/1000,
+           nodes[n].ppm/1e4, aligned, checked, min, sum/checked, max,
+           (double)r.stretchmax/SIM_CYCLES_PER_US, r.failed);
+    ok = ok && aligned == checked && r.failed == 0;
+  }
+
+  // How far apart the nodes start the same frame
+  double spreadmax = 0, spreadsum = 0;
+  for (uint16_t k = BUS_CHECK_SYNC; k < BUS_SYNCS; k++) {
+    double first = 1e30, last = -1e30;
+    for (uint8_t n = 0; n < BUS_NODES; n++) {
+      if (reports[n].rise[k] < first) first = reports[n].rise[k];
+      if (reports[n].rise[k] > last)  last  = reports[n].rise[k];
+    }
+    spreadsum += last - first;
+    if (last - first > spreadmax) {
+      spreadmax = last - first;
+    }
+  }
+  printf("  frame start spread across nodes: mean %.1f us, max %.1f us\n",
+         spreadsum/checked, spreadmax);
+  printf("Bus: every node took each command on the frame after its sync: "
+         "%s\n", verdict(ok));
+
+  // Register reads, a general call every node takes and an absent address
+  printf("\nBus: last register read of each node\n");
+  printf("  %-4s %6s %8s %8s %8s %8s %8s %8s %8s\n", "node", "status",
+         "out L", "out R", "frames", "syncs", "+frames", "+syncs",
+         "overruns");
+  bool regsok = true;
+  for (uint8_t n = 0; n < BUS_NODES; n++) {
+    const NodeReport& r    = reports[n];
+    const uint8_t    *last = r.regs[1];
+    const uint8_t    *prev = r.regs[0];
+    uint16_t frames = regWord(last, I2C_REG_FRAMES)
+                      - regWord(prev, I2C_REG_FRAMES);
+    uint16_t syncs  = regWord(last, I2C_REG_SYNCS)
+                      - regWord(prev, I2C_REG_SYNCS);
+    printf("  %-4u   0x%02X %8u %8u %8u %8u %8u %8u %8u\n", n,
+           last[I2C_REG_STATUS], regWord(last, I2C_REG_OUTPUT),
+           regWord(last, I2C_REG_OUTPUT + 2), regWord(last, I2C_REG_FRAMES),
+           regWord(last, I2C_REG_SYNCS), frames, syncs,
+           regWord(last, I2C_REG_OVERRUNS));
+    regsok = regsok && r.reads >= 2
+             && (last[I2C_REG_STATUS] & I2C_STATUS_ARMED)
+             && syncs == BUS_NODES*BUS_READ_EVERY && frames == syncs;
+  }
+  printf("  (+ since the read before, %u syncs apart)\n",
+         BUS_NODES*BUS_READ_EVERY);
+  printf("Bus: registers armed, one update per sync: %s\n",
+         verdict(regsok));
+
+  bool absent = true, general = true;
+  for (uint8_t n = 0; n < BUS_NODES; n++) {
+    absent  = absent && reports[n].absentacks == 0;
+    general = general && reports[n].syncacks == 2;
+  }
+  printf("Bus: sync acknowledged by every node: %s; address 0x%02X not "
+         "acknowledged: %s\n", verdict(general), BUS_ABSENT,
+         verdict(absent));
+
+  double bound = I2C_TIMEOUT + 1000.0*(PWM_MAX - PWM_NEUTRAL)/MAX_ACCEL;
+  bool   quiet = true;
+  printf("\nBus: master quiet after the last sync, neutral after");
+  for (uint8_t n = 0; n < BUS_NODES; n++) {
+    printf(" %.0f", reports[n].neutralms);
+    quiet = quiet && reports[n].neutralms >= 0
+            && reports[n].neutralms <= bound;
+  }
+  printf(" ms (bound %.0f ms): %s\n", bound, verdict(quiet));
+
+  // A master that gives up mid-byte can leave the node holding SDA low,
+  // and the switch on grounds SCL
+  NodeReport stuck;
+  if (!nodeInChild(0, true, &stuck)) {
+    return;
+  }
+  uint32_t taken = 0;
+  for (uint16_t k = BUS_STUCK_CHECK; k < BUS_SYNCS; k++) {
+    taken += stuck.applied[k] && stuck.rise[k] >= 0;
+  }
+  bool stuckok = stuck.neutralms >= 0 && stuck.neutralms <= bound
+                 && taken == BUS_SYNCS - BUS_STUCK_CHECK;
+  printf("\nBus: read given up mid-byte, then SCL grounded for %u ms: "
+         "neutral after %.0f ms, syncs %u-%u taken %u/%u: %s\n",
+         BUS_STUCK_MS, stuck.neutralms, BUS_STUCK_CHECK, BUS_SYNCS - 1,
+         taken, BUS_SYNCS - BUS_STUCK_CHECK, verdict(stuckok));
+#else
+  printf("\nBus: skipped, build with OPTIONS=\"-DI2C_TARGET=1\"\n");
+#endif
+}
@@ -0,0 +1,265 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - DShot Benchmark
+
+Description: Decodes the DShot waveform the driver puts on PWM_L and PWM_R
+back into frames, checking every bit's timing and every frame's checksum
+and throttle over the whole command range, then runs the firmware with the
+LED and ADC interrupts busy and checks every frame sent. The driver is only
+built in when PWM_PROTOCOL or PWM_PROTOCOL_ALT is DShot150.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "DShot-Driver.h"
+
+// DShot150 nominal timing and what the decoder accepts, us
+#define BIT_US        (1000.0/150)
+#define T0H_US        2.5
+#define T1H_US        5.0
+#define BIT_TOLERANCE 0.03          // of the bit period
+#define HIGH_TOLERANCE 0.25
+
+#define FIRMWARE_RUN_MS   10000
+
+#if PWM_DSHOT
+
+namespace {
+
+struct Frame {
+  uint64_t cycle;       // first rising edge
+  uint16_t packet;
+  bool     timingok;
+};
+
+struct Timing {
+  double bitmin, bitmax, t0min, t0max, t1min, t1max;
+};
+
+void resetTiming(Timing *t) {
+  t->bitmin = t->t0min = t->t1min = 1e30;
+  t->bitmax = t->t0max = t->t1max = 0;
+}
+
+void track(double v, double *lo, double *hi) {
+  if (v < *lo) *lo = v;
+  if (v > *hi) *hi = v;
+}
+
+// Split one pin's edges into frames: a bit is a rising edge and the falling
+// edge after it, a frame is 16 bits or whatever came before a long gap
+std::vector<Frame> decodeFrames(uint8_t pin, size_t from, Timing *timing) {
+  std::vector<std::pair<uint64_t, uint64_t> > bits;   // rise, fall
+  std::vector<Frame> frames;
+  uint64_t rise = 0;
+
+  for (size_t i = from; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind != EVENT_PIN || e.channel != pin) {
+      continue;
+    }
+    if (e.value) {
+      rise = e.cycle;
+    } else {
+      bits.push_back(std::make_pair(rise, e.cycle));
+    }
+  }
+
+  size_t first = 0;
+  while (first < bits.size()) {
+    size_t last = first + 1;
+    while (last < bits.size() && last - first < 16
+           && (double)(bits[last].first - bits[last - 1].first)
+              /SIM_CYCLES_PER_US < 3*BIT_US) {
+      last++;
+    }
+
+    Frame f = { bits[first].first, 0, last - first == 16 };
+    for (size_t b = first; b < last; b++) {
+      double highus = (double)(bits[b].second - bits[b].first)
+                      /SIM_CYCLES_PER_US;
+      bool one = highus > BIT_US/2;
+      f.packet = (f.packet << 1) | one;
+      if (one) {
+        track(highus, &timing->t1min, &timing->t1max);
+        f.timingok &= fabs(highus - T1H_US) <= HIGH_TOLERANCE;
+      } else {
+        track(highus, &timing->t0min, &timing->t0max);
+        f.timingok &= fabs(highus - T0H_US) <= HIGH_TOLERANCE;
+      }
+      if (b + 1 < last) {
+        double bitus = (double)(bits[b + 1].first - bits[b].first)
+                       /SIM_CYCLES_PER_US;
+        track(bitus, &timing->bitmin, &timing->bitmax);
+        f.timingok &= fabs(bitus - BIT_US) <= BIT_US*BIT_TOLERANCE;
+      }
+    }
+    frames.push_back(f);
+    first = last;
+  }
+  return frames;
+}
+
+bool crcOk(uint16_t packet) {
+  uint16_t value = packet >> 4;
+  return ((value ^ (value >> 4) ^ (value >> 8)) & 0x0F) == (packet & 0x0F);
+}
+
+// Throttle the spec gives for a command: 1 us of command is 2 steps, 0 in
+// the deadzone. 3D: 48-1047 reverse and 1048-2047 ahead, slowest first.
+uint16_t expectedThrottle(int us) {
+  if (DSHOT_3D) {
+    if (us >= PWM_NEUTRAL + DEADZONE) {
+      return 2047 - 2*(PWM_MAX - us);
+    }
+    if (us <= PWM_NEUTRAL - DEADZONE) {
+      return 1047 - 2*(us - PWM_MIN);
+    }
+    return 0;
+  }
+  return (us >= PWM_MIN + DEADZONE) ? 2047 - 2*(PWM_MAX - us) : 0;
+}
+
+void printTiming(const Timing& t) {
+  printf("  %-10s %10s %10s %10s\n", "", "nominal", "min us", "max us");
+  printf("  %-10s %10.3f %10.3f %10.3f\n", "bit", BIT_US, t.bitmin, t.bitmax);
+  printf("  %-10s %10.3f %10.3f %10.3f\n", "0 high", T0H_US, t.t0min, t.t0max);
+  printf("  %-10s %10.3f %10.3f %10.3f\n", "1 high", T1H_US, t.t1min, t.t1max);
+}
+
+// Every command from PWM_MIN to PWM_MAX through the driver, L rising while
+// R falls, one frame each
+void sweepCommands() {
+  Timing   timing;
+  uint32_t frames = 0, badtiming = 0, badcrc = 0, badthrottle = 0;
+
+  resetTiming(&timing);
+  simPowerOn();
+  DDRA = (1 << PWM_L) | (1 << PWM_R);
+
+  for (int us = PWM_MIN; us <= PWM_MAX; us++) {
+    int      usr   = PWM_MIN + PWM_MAX - us;
+    size_t   start = simTrace.size();
+
+    writeDShot(PWM_L, dshotPacket(dshotThrottle(us)));
+    writeDShot(PWM_R, dshotPacket(dshotThrottle(usr)));
+    cli();
+    sendDShot();
+    sei();
+    simAdvance(100*SIM_CYCLES_PER_US);
+
+    std::vector<Frame> l = decodeFrames(PWM_L, start, &timing);
+    std::vector<Frame> r = decodeFrames(PWM_R, start, &timing);
+    for (size_t c = 0; c < 2; c++) {
+      const std::vector<Frame>& f = c ? r : l;
+      int cmd = c ? usr : us;
+      frames++;
+      if (f.size() != 1 || !f[0].timingok) {
+        badtiming++;
+        continue;
+      }
+      if (!crcOk(f[0].packet)) {
+        badcrc++;
+      }
+      if ((f[0].packet >> 5) != expectedThrottle(cmd)
+          || (f[0].packet & 0x10)) {
+        badthrottle++;
+      }
+    }
+  }
+
+  printf("\nDShot: driver sweep %d-%d us on both pins (%s)\n", PWM_MIN,
+         PWM_MAX, DSHOT_3D ? "3D" : "one direction");
+  printTiming(timing);
+  printf("  frames %u, bad timing %u, bad checksum %u, wrong throttle %u\n",
+         frames, badtiming, badcrc, badthrottle);
+}
+
+// The firmware sending DShot while pots move, LEDs blink and the ADC runs
+void runDShotFirmware() {
+  LoopStats stats;
+  Timing    timing;
+
+  resetTiming(&timing);
+  scriptAnalog(0, INPUT_L, 512);
+  scriptAnalog(0, INPUT_R, 512);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  for (uint32_t ms = 1000; ms < FIRMWARE_RUN_MS; ms += 1000) {
+    scriptAnalog(ms, INPUT_L, (ms/1000) % 2 ? 900 : 100);
+    scriptAnalog(ms, INPUT_R, (ms/1000) % 2 ? 100 : 900);
+  }
+
+  bootFirmware(&stats);
+  runFirmware(FIRMWARE_RUN_MS, &stats);
+
+  printf("\nDShot: firmware for %u ms\n", FIRMWARE_RUN_MS);
+  for (uint8_t c = 0; c < 2; c++) {
+    uint8_t  pin = c ? PWM_R : PWM_L;
+    uint32_t badtiming = 0, badcrc = 0;
+    uint16_t lowest = 0xFFFF, highest = 0;
+    std::vector<Frame> f = decodeFrames(pin, 0, &timing);
+    for (size_t i = 0; i < f.size(); i++) {
+      uint16_t throttle = f[i].packet >> 5;
+      badtiming += !f[i].timingok;
+      badcrc    += !crcOk(f[i].packet);
+      if (throttle != 0 && throttle < lowest) lowest = throttle;
+      if (throttle > highest) highest = throttle;
+    }
+    double span = f.size() > 1 ? (double)(f.back().cycle - f[0].cycle)
+                                 /SIM_CYCLES_PER_MS : 0;
+    printf("  %-6s frames %u (%.0f/s), bad timing %u, bad checksum %u, "
+           "throttle %u-%u\n", c ? "PWM_R" : "PWM_L", (uint32_t)f.size(),
+           span > 0 ? (f.size() - 1)*1000/span : 0, badtiming, badcrc,
+           lowest, highest);
+  }
+  printTiming(timing);
+  printf("  interrupts serviced %llu\n",
+         (unsigned long long)(stats.pass[PASS_CONTROL].ops[OP_ISR]
+                              + stats.pass[PASS_DETECT].ops[OP_ISR]
+                              + stats.pass[PASS_IDLE].ops[OP_ISR]));
+}
+
+} // namespace
+
+void benchDShot() {
+  sweepCommands();
+  if (PWM_PROTOCOL == PROTOCOL_DSHOT150) {
+    runDShotFirmware();
+  } else {
+    printf("\nDShot: firmware run skipped, it starts with PWM_PROTOCOL\n");
+  }
+}
+
+#else
+
+void benchDShot() {
+  printf("\nDShot: skipped, build with "
+         "OPTIONS=\"-DPWM_PROTOCOL=PROTOCOL_DSHOT150\"\n");
+}
+
+#endif
@@ -0,0 +1,334 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Failsafe Benchmark
+
+Description: Runs the firmware with both outputs at full, then injects a
+fault: loop() hanging with or without interrupts, one overlong loop() pass,
+or an ADC conversion that never completes. Counts the pulses that still
+went out with the old command and how long it took until both outputs sent
+neutral, across fault times spread over a PWM frame. A reset ends the power
+cycle and the part boots again with the reset flags, EEPROM and uncleared
+RAM it would have, so the reset log can be checked too.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Failsafe.h"
+
+
+#define FAILSAFE_POT        900       // both pots, well off neutral
+#define FAILSAFE_FAULT_MS   1000      // outputs have reached full by then
+#define FAILSAFE_PHASES     10        // fault times, 2 ms apart
+#define FAILSAFE_RUN_MS     200       // after the fault
+#define FAILSAFE_REBOOT_MS  100       // after a reset
+#define FAILSAFE_BOUND_MS   40        // two PWM50 frames
+#define FAILSAFE_STALE      2         // pulses with the command, the same
+#define FAILSAFE_NEUTRAL_NS ((int32_t)PWM_NEUTRAL*1000)
+
+namespace {
+
+// Reset cause, then the counters
+void printLog(const FailsafeLog& log) {
+  static const char *flags[] = { "PORF", "EXTRF", "BORF", "WDRF" };
+  char cause[32] = "";
+  for (uint8_t i = 0; i < 4; i++) {
+    if (log.lastcause & _BV(i)) {
+      if (cause[0]) {
+        strcat(cause, "+");
+      }
+      strcat(cause, flags[i]);
+    }
+  }
+  printf(" %5s %5u %5u %8u\n", cause, log.watchdogresets, log.trips,
+         log.overruns);
+}
+
+void decodeFile(const char *path) {
+  FailsafeLog log;
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  memset(&log, 0, sizeof(log));
+  if (fseek(f, FAILSAFE_EEPROM, SEEK_SET) != 0
+      || fread(&log, sizeof(log), 1, f) != 1) {
+    printf("\nFailsafe: %s is too short for a reset log\n", path);
+  } else if (log.magic != FAILSAFE_MAGIC) {
+    printf("\nFailsafe: no reset log (magic 0x%02x)\n", log.magic);
+  } else {
+    printf("\nFailsafe: reset log from EEPROM image, %u brownouts\n",
+           log.brownouts);
+    printf("  %5s %5s %5s %8s\n", "cause", "wdt", "trips", "overruns");
+    printf(" ");
+    printLog(log);
+  }
+  fclose(f);
+}
+
+#if FAILSAFE && PWM_PROTOCOL != PROTOCOL_DSHOT150 && !PWM_SCHEDULED
+
+enum FaultKind {
+  FAULT_NONE,
+  FAULT_HANG,
+  FAULT_HANG_CLI,
+  FAULT_PASS,
+  FAULT_ADC_STALL
+};
+
+struct FaultCase {
+  const char *name;
+  uint8_t     kind;
+  uint32_t    passms;                   // FAULT_PASS: length of the pass
+  int         wdtpercent;               // watchdog oscillator off nominal
+};
+
+const FaultCase cases[] = {
+  { "no fault",                FAULT_NONE,        0,  0   },
+  { "loop() hangs",            FAULT_HANG,        0,  0   },
+  { "hangs, interrupts off",   FAULT_HANG_CLI,    0,  0   },
+  { "one 25 ms pass",          FAULT_PASS,        25, 0   },
+  { "one 45 ms pass",          FAULT_PASS,        45, 0   },
+  { "ADC stalls",              FAULT_ADC_STALL,   0,  0   },
+  { "hangs, WDT -10%",         FAULT_HANG,        0,  -10 },
+  { "interrupts off, WDT -10%", FAULT_HANG_CLI,   0,  -10 },
+};
+
+// What a power cycle leaves behind, passed from the child that ran it to
+// the parent and on to the child that boots again after a reset
+struct Cycle {
+  bool        reset;
+  uint8_t     flags;                    // MCUSR after the reset
+  double      resetms;                  // from the fault
+  uint32_t    stale;                    // pulses with the old command
+  double      neutralms;                // until both sent neutral, -1 never
+  FailsafeLog log;
+  FailsafeRun run;
+  uint8_t     eeprom[SIM_EEPROM_SIZE];
+};
+
+void scriptInputs() {
+  scriptAnalog(0, INPUT_L, FAILSAFE_POT);
+  scriptAnalog(0, INPUT_R, FAILSAFE_POT);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+}
+
+// After a reset nothing of the firmware may run again, its log in RAM is
+// gone and the next boot picks up the rest
+void leaveBehind(Cycle *cycle) {
+  cycle->run = failsafeRun;
+  memcpy(cycle->eeprom, simEEPROM, sizeof(cycle->eeprom));
+  if (!cycle->reset) {
+    readFailsafeLog(&cycle->log);
+  }
+}
+
+struct Fault {
+  const FaultCase *c;
+  uint32_t         ms;
+};
+
+// Both outputs at full, then the fault. Per output, count the pulses from
+// the fault on that still carry a command, up to the first neutral one.
+void faultCycle(const void *arg, void *result) {
+  Cycle *cycle = (Cycle*)result;
+  const Fault& f = *(const Fault*)arg;
+  LoopStats stats;
+
+  scriptInputs();
+  switch (f.c->kind) {
+  case FAULT_HANG:
+  case FAULT_HANG_CLI:
+    injectHang(f.ms, f.c->kind == FAULT_HANG);
+    break;
+  case FAULT_PASS:
+    injectStall(f.ms, f.c->passms);
+    break;
+  case FAULT_ADC_STALL:
+    scriptADCFault(f.ms, ADC_FAULT_STALL);
+    break;
+  }
+  simSetWatchdogClock(SIM_WDT_FREQ/100*(100 + f.c->wdtpercent));
+  simEraseEEPROM();
+
+  bootFirmware(&stats);
+  bool     ran   = runFirmware(f.ms + FAILSAFE_RUN_MS, &stats);
+  uint64_t fault = (uint64_t)f.ms*SIM_CYCLES_PER_MS;
+
+  cycle->reset   = !ran;
+  cycle->flags   = resetFlags();
+  cycle->resetms = ran ? -1 : (double)(simNow() - fault)/SIM_CYCLES_PER_MS;
+
+  int64_t  neutral[2] = { -1, -1 };
+  uint32_t stale[2]   = { 0, 0 };
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if ((e.kind != EVENT_PULSE_A && e.kind != EVENT_PULSE_B)
+        || e.cycle < fault) {
+      continue;
+    }
+    uint8_t out = (e.kind == EVENT_PULSE_A) ? 0 : 1;
+    if (neutral[out] >= 0) {
+      continue;
+    }
+    if (e.value == FAILSAFE_NEUTRAL_NS) {
+      neutral[out] = e.cycle - fault;
+    } else {
+      stale[out]++;
+    }
+  }
+  cycle->stale     = stale[0] > stale[1] ? stale[0] : stale[1];
+  cycle->neutralms = (neutral[0] < 0 || neutral[1] < 0) ? -1
+                     : (neutral[0] > neutral[1] ? neutral[0] : neutral[1])
+                       /(double)SIM_CYCLES_PER_MS;
+  leaveBehind(cycle);
+}
+
+// Boot again after a reset with what the reset left: MCUSR, the EEPROM and
+// the RAM the startup code does not clear. Time to the first neutral pulse
+// on both outputs goes in neutralms.
+void rebootCycle(const void *arg, void *result) {
+  Cycle *cycle = (Cycle*)result;
+  const Cycle& before = *(const Cycle*)arg;
+  LoopStats stats;
+
+  scriptInputs();
+  memcpy(simEEPROM, before.eeprom, sizeof(simEEPROM));
+  failsafeRun = before.run;
+  simSetResetFlags(before.flags);
+
+  bootFirmware(&stats);
+  cycle->reset = !runFirmware(FAILSAFE_REBOOT_MS, &stats);
+
+  int64_t first[2] = { -1, -1 };
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if ((e.kind == EVENT_PULSE_A || e.kind == EVENT_PULSE_B)
+        && e.value == FAILSAFE_NEUTRAL_NS) {
+      uint8_t out = (e.kind == EVENT_PULSE_A) ? 0 : 1;
+      if (first[out] < 0) {
+        first[out] = e.cycle;
+      }
+    }
+  }
+  cycle->neutralms = (first[0] < 0 || first[1] < 0) ? -1
+                     : (first[0] > first[1] ? first[0] : first[1])
+                       /(double)SIM_CYCLES_PER_MS;
+  leaveBehind(cycle);
+}
+
+#endif
+
+} // namespace
+
+void benchFailsafe() {
+  printf("\nFailsafe: reset log is %u bytes at EEPROM address %u\n",
+         (uint32_t)sizeof(FailsafeLog), FAILSAFE_EEPROM);
+
+  if (eepromFile) {
+    decodeFile(eepromFile);
+    return;
+  }
+#if !FAILSAFE
+  printf("\nFailsafe: firmware runs skipped, build with "
+         "OPTIONS=\"-DFAILSAFE=1\"\n");
+#elif PWM_PROTOCOL == PROTOCOL_DSHOT150
+  printf("\nFailsafe: firmware runs skipped, they count PWM pulses\n");
+#elif PWM_SCHEDULED
+  printf("\nFailsafe: firmware runs skipped, they count OC1A/OC1B pulses; "
+         "the scheduler benchmark has a hang\n");
+#else
+
+  printf("\nFailsafe: faults at %u-%u ms with both outputs at full, worst "
+         "of %u; times in ms from the fault, -1 for never\n",
+         FAILSAFE_FAULT_MS, FAILSAFE_FAULT_MS + 2*(FAILSAFE_PHASES - 1),
+         FAILSAFE_PHASES);
+  printf("  %-26s %6s %8s %7s %8s | log: %5s %5s %5s %8s\n", "case", "stale",
+         "neutral", "resets", "reset at", "cause", "wdt", "trips",
+         "overruns");
+  printf("  (stale: pulses still carrying the command, per output)\n");
+
+  bool held = true;
+  for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+    const FaultCase& c = cases[i];
+    uint32_t stale   = 0, resets = 0;
+    double   neutral = 0, resetat = -1;
+    Cycle    first;
+
+    for (uint8_t p = 0; p < FAILSAFE_PHASES; p++) {
+      Fault f = { &c, FAILSAFE_FAULT_MS + 2u*p };
+      Cycle cycle;
+      memset(&cycle, 0, sizeof(cycle));
+      runInChild(faultCycle, &f, &cycle, sizeof(cycle));
+
+      // After a reset, neutral comes from the next boot
+      if (cycle.reset) {
+        Cycle after;
+        memset(&after, 0, sizeof(after));
+        runInChild(rebootCycle, &cycle, &after, sizeof(after));
+        cycle.neutralms = (after.neutralms < 0) ? -1
+                          : cycle.resetms + after.neutralms;
+        cycle.log      = after.log;
+        resets++;
+        if (cycle.resetms > resetat) {
+          resetat = cycle.resetms;
+        }
+      }
+      if (p == 0) {
+        first = cycle;
+      }
+      if (cycle.stale > stale) {
+        stale = cycle.stale;
+      }
+      if (neutral >= 0 && (cycle.neutralms < 0 || cycle.neutralms > neutral)) {
+        neutral = cycle.neutralms;
+      }
+    }
+
+    if (c.kind == FAULT_NONE) {
+      // Nothing may trip or reset without a fault
+      held = held && resets == 0 && first.log.trips == 0
+             && first.log.overruns == 0;
+      printf("  %-26s %6s %8s %7u %8s | log:", c.name, "-", "-", resets, "-");
+    } else {
+      held = held && neutral >= 0 && neutral <= FAILSAFE_BOUND_MS
+             && stale <= FAILSAFE_STALE;
+      char at[16] = "-";
+      if (resets) {
+        snprintf(at, sizeof(at), "%.1f", resetat);
+      }
+      printf("  %-26s %6u %8.1f %7u %8s | log:", c.name, stale, neutral,
+             resets, at);
+    }
+    printLog(first.log);
+  }
+  printf("\nFailsafe: both outputs neutral within %u ms of any fault, at "
+         "most %u stale pulses: %s\n", FAILSAFE_BOUND_MS, FAILSAFE_STALE,
+         verdict(held));
+#endif
+}
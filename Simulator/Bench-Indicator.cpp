@@ -0,0 +1,182 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Indicator Benchmark
+
+Description: Checks that the two LEDs blink on their own. Each shows its own
+pattern, a new pattern on one leaves the other's running on, and one can dim
+while the other blinks. Then counts what the Timer0 compare interrupt that
+shifts the patterns out costs per call.
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include <time.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Indicator.h"
+#include "Mapping.h"
+
+// One pattern bit, as Indicator.cpp times it: BLINK_TICKS Timer0 compare
+// matches of 256 counts at prescaler 64
+#define BLINK_TICKS       (2*(F_CPU/64/256)/16)
+#define BIT_CYCLES        ((uint64_t)BLINK_TICKS*256*64)
+#define ISR_PER_S         ((double)F_CPU/(256*64))
+
+#define SAMPLE_BITS       24        // between changes, not whole patterns
+#define DIM_PWM           1700      // us, for the LED handed to the timer
+
+namespace {
+
+// LED levels in the middle of pattern bits, bit 0 first
+struct Shown {
+  uint64_t l, r;
+};
+
+// Let time pass until either LED changes, which is on a pattern bit, and
+// return the middle of the bit that starts there
+uint64_t findBit() {
+  bool l = simPinLevel(LED_L), r = simPinLevel(LED_R);
+  for (uint64_t limit = simNow() + 2*BIT_CYCLES; simNow() < limit; ) {
+    simAdvance(SIM_CYCLES_PER_MS);
+    if (simPinLevel(LED_L) != l || simPinLevel(LED_R) != r) {
+      return simNow() - SIM_CYCLES_PER_MS/2 + BIT_CYCLES/2;
+    }
+  }
+  return 0;
+}
+
+// Both LEDs over count bits from the one in the middle at *mid on
+Shown sample(uint64_t *mid, uint8_t count) {
+  Shown s = {};
+  for (uint8_t k = 0; k < count; k++) {
+    simAdvanceTo(*mid);
+    s.l |= (uint64_t)simPinLevel(LED_L) << k;
+    s.r |= (uint64_t)simPinLevel(LED_R) << k;
+    *mid += BIT_CYCLES;
+  }
+  return s;
+}
+
+// Whether count bits are the pattern running on without a break, from any
+// of its bits
+bool continues(uint64_t bits, uint8_t count, uint16_t ptrn) {
+  for (uint8_t start = 0; start < 16; start++) {
+    bool same = true;
+    for (uint8_t k = 0; k < count && same; k++) {
+      same = ((bits >> k) & 1) == ((ptrn >> ((start + k) % 16)) & 1);
+    }
+    if (same) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool checkIndependent() {
+  simPowerOn();
+  pinMode(LED_L, OUTPUT);
+  pinMode(LED_R, OUTPUT);
+  initializeLEDs();
+  writeBlinker(LED_L, BLINK_1L);
+  writeBlinker(LED_R, BLINK_3S);
+
+  uint64_t mid = findBit();
+  if (mid == 0) {
+    printf("\nIndicator: LEDs never changed: %s\n", verdict(false));
+    return false;
+  }
+
+  // A new pattern on R, then L handed to the timer, each mid-bit and part
+  // way through a pattern, where starting it over would show
+  Shown first  = sample(&mid, SAMPLE_BITS);
+  writeBlinker(LED_R, BLINK_2S);
+  Shown second = sample(&mid, SAMPLE_BITS);
+  writeDimmer(LED_L, DIM_PWM);
+  Shown third  = sample(&mid, SAMPLE_BITS);
+
+  bool own     = continues(first.l, SAMPLE_BITS, BLINK_1L)
+                 && continues(first.r, SAMPLE_BITS, BLINK_3S);
+  bool changed = continues(first.l | second.l << SAMPLE_BITS, 2*SAMPLE_BITS,
+                           BLINK_1L)
+                 && continues(second.r, SAMPLE_BITS, BLINK_2S);
+  bool dimmed  = continues(second.r | third.r << SAMPLE_BITS, 2*SAMPLE_BITS,
+                           BLINK_2S)
+                 && (TCCR0A & (_BV(COM0A0) | _BV(COM0A1)))
+                 && !(TCCR0A & (_BV(COM0B0) | _BV(COM0B1)))
+                 && OCR0A == mapDimmer(DIM_PWM);
+
+  printf("\nIndicator: LED_L and LED_R on their own\n");
+  printf("  L %-4s R %-4s %-36s %s\n", "1L", "3S", "each shows its pattern",
+         verdict(own));
+  printf("  L %-4s R %-4s %-36s %s\n", "1L", "2S",
+         "a new one on R leaves L running", verdict(changed));
+  printf("  L %-4s R %-4s %-36s %s\n", "dim", "2S", "L dims while R blinks on",
+         verdict(dimmed));
+  return own && changed && dimmed;
+}
+
+// The interrupt with both LEDs blinking, over whole patterns
+void measureIsr() {
+  const uint32_t calls = 16*BLINK_TICKS*64;
+  uint32_t maxregs = 0;
+  uint64_t regs = 0;
+  timespec start, end;
+
+  simPowerOn();
+  initializeLEDs();
+  writeBlinker(LED_L, BLINK_S);
+  writeBlinker(LED_R, BLINK_L);
+  for (uint32_t i = 0; i < calls; i++) {
+    uint32_t before = simOps[OP_REGREAD] + simOps[OP_REGWRITE];
+    TIM0_COMPA_vect();
+    uint32_t used = simOps[OP_REGREAD] + simOps[OP_REGWRITE] - before;
+    regs   += used;
+    maxregs = used > maxregs ? used : maxregs;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < calls; i++) {
+    TIM0_COMPA_vect();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double hostns = ((end.tv_sec - start.tv_sec)*1e9
+                   + (end.tv_nsec - start.tv_nsec))/calls;
+
+  printf("\nIndicator: TIM0_COMPA interrupt, both LEDs blinking\n");
+  printf("  %.1f calls/s, a pattern bit every %u\n", ISR_PER_S,
+         (unsigned)BLINK_TICKS);
+  printf("  register accesses per call: mean %.2f, max %u (on a bit)\n",
+         (double)regs/calls, maxregs);
+  printf("  charged %u cycles per call for the vector, %.2f%% of the CPU, "
+         "plus the body\n", COST_ISR, 100.0*COST_ISR*ISR_PER_S/F_CPU);
+  printf("  host ns per call: %.1f\n", hostns);
+}
+
+} // namespace
+
+void benchIndicator() {
+  checkIndependent();
+  measureIsr();
+}
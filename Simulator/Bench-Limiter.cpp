@@ -0,0 +1,296 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Limiter Benchmark
+
+Description: Drives the fixed point Limiter and the original float limiter
+side by side through long random input traces on the virtual clock and
+reports how far apart their outputs get, plus what a step costs each way.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+// Standard headers first: the Arduino abs() macro breaks <random>
+#include <random>
+#include <time.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Limiter.h"
+#include "SCurve-Limiter.h"
+#include "Float-Limiter.h"
+
+#define TRACES            200
+#define STEPS_PER_TRACE   20000
+
+// Step responses run at the PWM50 frame rate until the output settles
+#define RESPONSE_DT       20        // ms
+#define RESPONSE_MS       4000
+
+// Hand estimates, not measurements, of ATtiny84 cycles per step() including
+// the caller's int/float conversions, summed from typical avr-libc routine
+// costs. Without avr-gcc here nothing checks them against compiled code:
+// __floatunsisf 60, __divsf3 470, __mulsf3 140, __addsf3/__subsf3 95,
+// compare 45, __floatsisf 65, __fixsfsi 55, millis() 28.
+#define FLOAT_STEP_CYCLES (2*28 + 60 + 470 + 2*140 + 2*95 + 2*45 + 65 + 55)
+// millis(), 32-bit subtract and clamp, __mulsi3 45, byte shifts and two
+// 32-bit compares/adds
+#define FIXED_STEP_CYCLES (28 + 12 + 45 + 3*8 + 2*12 + 10)
+
+namespace {
+
+double hostNsPerStep(bool fixed) {
+  Limiter      limiter(MAX_ACCEL, PWM_NEUTRAL);
+  FloatLimiter floatlimiter(MAX_ACCEL, PWM_NEUTRAL);
+  volatile int sink = 0;
+  const uint32_t n  = 2000000;
+  timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < n; i++) {
+    int input = (i & 0x400) ? PWM_MAX : PWM_MIN;
+    if ((i & 0x3f) == 0) {
+      simAdvance(UPDATE_DT*SIM_CYCLES_PER_MS);
+    }
+    sink = fixed ? limiter.step(input) : (int)floatlimiter.step(input);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  (void)sink;
+  return ((end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec))/n;
+}
+
+// Largest output difference between the two limiters over random traces.
+// With the clock frozen during step() both see the same dt; with it running,
+// the float version's two millis() reads can straddle a timer0 tick.
+int compareTraces(uint16_t maxaccel, bool clockrunning, uint64_t *mismatches,
+                  uint64_t *steps) {
+  std::mt19937 rng(84);
+  int maxdiff = 0;
+
+  for (uint32_t t = 0; t < TRACES; t++) {
+    simPowerOn();
+    simSetCosting(clockrunning);
+    int start = PWM_MIN + (int)(rng() % (PWM_MAX - PWM_MIN + 1));
+    Limiter      limiter(maxaccel, start);
+    FloatLimiter floatlimiter(maxaccel, start);
+    int          input = start;
+
+    for (uint32_t s = 0; s < STEPS_PER_TRACE; s++) {
+      // Mostly firmware-like ticks, sometimes long or short gaps
+      uint32_t r  = rng() % 100;
+      uint32_t dt = (r < 80) ? UPDATE_DT + rng() % 3
+                  : (r < 95) ? 1 + rng() % UPDATE_DT
+                  : 1 + rng() % 2000;
+      simAdvance(dt*SIM_CYCLES_PER_MS);
+
+      // Hold the input for a while, then jump anywhere in range
+      if (rng() % 20 == 0) {
+        input = PWM_MIN + (int)(rng() % (PWM_MAX - PWM_MIN + 1));
+      }
+
+      int fixed = limiter.step(input);
+      int fl    = (int)floatlimiter.step(input);
+      int diff  = abs(fixed - fl);
+      if (diff > maxdiff) {
+        maxdiff = diff;
+      }
+      if (diff != 0) {
+        (*mismatches)++;
+      }
+      (*steps)++;
+    }
+  }
+  simSetCosting(true);
+  return maxdiff;
+}
+
+// An input step, optionally followed by a second one part way through
+struct StepCase {
+  const char *name;
+  int         from;
+  int         to;
+  uint32_t    thenms;       // 0: no second step
+  int         then;
+};
+
+struct StepResponse {
+  double rise;              // ms from 10% to 90% of the first step
+  double settle;            // ms until the output stays on the final input
+  int    overshoot;         // us past the final input, against the step
+  double peakrate;          // us/s
+  double peakjerk;          // us/s^2, largest change in rate between steps
+  double ratejerk;          // us/s^2, the same from the limiter's own rate
+                            //   over the millis() it saw, -1 without one
+};
+
+// The rate a limiter keeps itself, us/s. Limiter has none.
+bool ownRate(Limiter&, double *rate) {
+  return false;
+}
+
+bool ownRate(SCurveLimiter& limiter, double *rate) {
+  *rate = limiter.rate();
+  return true;
+}
+
+// Drive a limiter (Limiter or SCurveLimiter) through one case
+template <typename L>
+StepResponse stepResponse(L limiter, const StepCase& c) {
+  StepResponse r = { -1, -1, 0, 0, 0, 0 };
+  double lo      = c.from + 0.1*(c.to - c.from);
+  double hi      = c.from + 0.9*(c.to - c.from);
+  double t10     = -1, lastrate = 0, lastown = 0, own;
+  uint32_t then  = millis();
+  int    last    = c.from;
+  int    final   = c.thenms ? c.then : c.to;
+  int    sign    = (final > c.from) ? 1 : -1;
+
+  for (uint32_t t = RESPONSE_DT; t <= RESPONSE_MS; t += RESPONSE_DT) {
+    simAdvance(RESPONSE_DT*SIM_CYCLES_PER_MS);
+    int input  = (c.thenms && t > c.thenms) ? c.then : c.to;
+    int output = limiter.step(input);
+
+    bool pastlo = (c.to > c.from) ? output >= lo : output <= lo;
+    bool pasthi = (c.to > c.from) ? output >= hi : output <= hi;
+    if (t10 < 0 && pastlo) {
+      t10 = t;
+    }
+    if (r.rise < 0 && pasthi) {
+      r.rise = t - t10;
+    }
+    if (output != final) {
+      r.settle = -1;
+    } else if (r.settle < 0) {
+      r.settle = t;
+    }
+    int over = (output - final)*sign;
+    if (over > r.overshoot) {
+      r.overshoot = over;
+    }
+
+    double rate = (output - last)*1000.0/RESPONSE_DT;
+    double jerk = fabs(rate - lastrate)*1000.0/RESPONSE_DT;
+    if (fabs(rate) > r.peakrate) r.peakrate = fabs(rate);
+    if (jerk > r.peakjerk) r.peakjerk = jerk;
+    lastrate = rate;
+    last     = output;
+
+    uint32_t now = millis();
+    if (!ownRate(limiter, &own)) {
+      r.ratejerk = -1;
+    } else if (fabs(own - lastown)*1000.0/(now - then) > r.ratejerk) {
+      r.ratejerk = fabs(own - lastown)*1000.0/(now - then);
+    }
+    lastown = own;
+    then    = now;
+  }
+  return r;
+}
+
+void printResponse(const char *limiter, const StepResponse& r) {
+  printf("  %-10s %10.0f %10.0f %10d %10.0f %12.0f", limiter, r.rise,
+         r.settle, r.overshoot, r.peakrate, r.peakjerk);
+  if (r.ratejerk >= 0) {
+    printf(" %12.0f", r.ratejerk);
+  }
+  printf("\n");
+}
+
+} // namespace
+
+void benchLimiterSteps() {
+  static const StepCase cases[] = {
+    { "neutral to full ahead",  PWM_NEUTRAL, PWM_MAX, 0, 0 },
+    { "full ahead to neutral",  PWM_MAX, PWM_NEUTRAL, 0, 0 },
+    { "full astern to ahead",   PWM_MIN, PWM_MAX, 0, 0 },
+    { "small step",             PWM_NEUTRAL, PWM_NEUTRAL + 100, 0, 0 },
+    { "ahead, back at 300 ms",  PWM_NEUTRAL, PWM_MAX, 300, PWM_NEUTRAL },
+  };
+
+  printf("\nLimiter: step responses every %u ms (SCurveLimiter: %u/%u/%u us/s"
+         " speed up/slow down/reverse within %u us, jerk %u us/s^2)\n",
+         RESPONSE_DT, SCURVE_SPEEDUP, SCURVE_SLOWDOWN, SCURVE_REVERSAL,
+         SCURVE_BAND, SCURVE_JERK);
+  double worst = 0;
+  for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+    const StepCase& c = cases[i];
+    printf("  %s, %d -> %d", c.name, c.from, c.to);
+    if (c.thenms) {
+      printf(" -> %d", c.then);
+    }
+    printf("\n  %-10s %10s %10s %10s %10s %12s %12s\n", "", "rise ms",
+           "settle ms", "overshoot", "peak us/s", "peak us/s^2",
+           "own us/s^2");
+
+    simPowerOn();
+    simSetCosting(false);
+    printResponse("Limiter", stepResponse(Limiter(MAX_ACCEL, c.from), c));
+
+    simPowerOn();
+    simSetCosting(false);
+    SCurveLimiter scurve(SCURVE_SPEEDUP, SCURVE_JERK, c.from);
+    scurve.setDirectionalLimits(PWM_NEUTRAL, SCURVE_BAND, SCURVE_SPEEDUP,
+                                SCURVE_SLOWDOWN, SCURVE_REVERSAL);
+    StepResponse r = stepResponse(scurve, c);
+    printResponse("SCurve", r);
+    worst = r.ratejerk > worst ? r.ratejerk : worst;
+  }
+  simSetCosting(true);
+  // The output is whole us, so its own steps only bound the jerk to within
+  // 2 us/RESPONSE_DT^2. The rate SCurveLimiter keeps must stay inside it.
+  printf("  (own: from the rate the limiter keeps, peak us/s^2 from its "
+         "whole us output)\n");
+  printf("Limiter: SCurve's own rate within its jerk of %u us/s^2, peak %.0f:"
+         " %s\n", SCURVE_JERK, worst, verdict(worst <= SCURVE_JERK));
+}
+
+void benchLimiter() {
+  static const uint16_t accels[] = { 50, MAX_ACCEL, 2500, 10000 };
+
+  printf("\nLimiter: fixed point vs float over %u random traces of %u steps\n",
+         TRACES, STEPS_PER_TRACE);
+  printf("  %10s %12s %12s %12s %16s\n", "us/s", "steps", "max |diff|",
+         "diff != 0", "clock running");
+
+  for (size_t a = 0; a < sizeof(accels)/sizeof(accels[0]); a++) {
+    uint64_t steps = 0, mismatches = 0, unused = 0;
+    int maxdiff = compareTraces(accels[a], false, &mismatches, &steps);
+    int running = compareTraces(accels[a], true, &unused, &unused);
+    printf("  %10u %12llu %12d %12llu %16d\n", accels[a],
+           (unsigned long long)steps, maxdiff,
+           (unsigned long long)mismatches, running);
+  }
+
+  simPowerOn();
+  printf("\nLimiter: cost per step(), measured on the host only\n");
+  printf("  %-8s %18s %14s\n", "", "host ns", "AVR by hand");
+  printf("  %-8s %18.1f %14u\n", "float", hostNsPerStep(false),
+         FLOAT_STEP_CYCLES);
+  printf("  %-8s %18.1f %14u\n", "fixed", hostNsPerStep(true),
+         FIXED_STEP_CYCLES);
+  printf("  (AVR cycles are hand estimates from routine costs, not a build "
+         "for the chip)\n");
+
+  benchLimiterSteps();
+}
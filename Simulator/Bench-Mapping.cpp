@@ -0,0 +1,178 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Mapping Benchmark
+
+Description: Checks the division-free input and LED mappings against the
+Arduino map() expressions they replaced for every input they can see, prints
+the configured response curves and estimates what a mapping costs each way.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include <time.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Mapping.h"
+
+// 12-bit sampler readings, a little past ADC_MAX for noise at the ends
+#define READING_MAX       4095
+// Pulses the LEDs could be asked to show, well past the output range
+#define DIMMER_PWM_MIN    0
+#define DIMMER_PWM_MAX    3000
+
+// Estimated ATtiny84 cycles per call. map(): the call, a 32-bit subtract,
+// __mulsi3 and __divmodsi4, as charged by the simulator. Fixed point: the
+// subtract and sign test (12), __mulsi3 as a shift-and-add loop without a
+// hardware multiplier (~16 per bit of the 13-bit count), byte moves and a
+// few bit shifts for the >> SHIFT (24). A curve adds two pgm_read_word()
+// (2*7), the interpolation multiply by the 7-bit fraction (7*16) and the
+// mirroring (20).
+#define MAP_CYCLES        COST_MAP
+#define FIXED_CYCLES      (12 + 13*16 + 24)
+#define CURVE_CYCLES      (2*7 + 7*16 + 20)
+
+namespace {
+
+// Arduino's map() without the simulator's cycle charge
+long referenceMap(long x, long in_min, long in_max, long out_min,
+                  long out_max) {
+  return (x - in_min)*(out_max - out_min)/(in_max - in_min) + out_min;
+}
+
+long referenceThrottle(int reading) {
+  return referenceMap(reading - POT_OFFSET*ADC_SCALE, 0, ADC_MAX,
+                      PWM_MIN, PWM_MAX);
+}
+
+long referenceSteering(int reading) {
+  return referenceMap(reading - POT_OFFSET*ADC_SCALE, 0, ADC_MAX,
+                      -STEER_MAX, STEER_MAX);
+}
+
+long referenceDimmer(int pwm) {
+  return constrain(referenceMap(abs(pwm - PWM_NEUTRAL), DEADZONE, HALF_RANGE,
+                                255, 0), 0, 255);
+}
+
+const char *curveName(int curve) {
+  static const char *names[] = { "linear", "expo", "thrust" };
+  return names[curve];
+}
+
+void printComparison(const char *name, int from, int to, long (*fixed)(int),
+                     long (*reference)(int)) {
+  uint32_t mismatches = 0;
+  long     maxdiff    = 0;
+
+  for (int x = from; x <= to; x++) {
+    long diff = abs(fixed(x) - reference(x));
+    if (diff != 0) {
+      mismatches++;
+    }
+    if (diff > maxdiff) {
+      maxdiff = diff;
+    }
+  }
+  printf("  %-10s %6d..%-6d %10d %12u %12ld\n", name, from, to,
+         to - from + 1, mismatches, maxdiff);
+}
+
+long fixedThrottle(int reading) { return mapThrottle(reading); }
+long fixedSteering(int reading) { return mapSteering(reading); }
+long fixedDimmer(int pwm)       { return mapDimmer(pwm); }
+
+// Whether a mapping never steps backwards over the sampler range
+bool monotonic(long (*fixed)(int)) {
+  for (int x = 1; x <= READING_MAX; x++) {
+    if (fixed(x) < fixed(x - 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double hostNsPerCall(bool fixed) {
+  volatile long sink = 0;
+  const uint32_t n   = 4000000;
+  timespec start, end;
+
+  simSetCosting(false);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < n; i++) {
+    int reading = i & 0xfff;
+    sink = fixed ? mapThrottle(reading)
+                 : map(reading - POT_OFFSET*ADC_SCALE, 0, ADC_MAX,
+                       PWM_MIN, PWM_MAX);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  simSetCosting(true);
+  (void)sink;
+  return ((end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec))/n;
+}
+
+} // namespace
+
+void benchMapping() {
+  printf("\nMapping: fixed point vs map() over every input\n");
+  printf("  %-10s %14s %10s %12s %12s\n", "mapping", "range", "inputs",
+         "mismatches", "max |diff|");
+  if (THROTTLE_CURVE == CURVE_LINEAR) {
+    printComparison("throttle", 0, READING_MAX, fixedThrottle,
+                    referenceThrottle);
+  } else {
+    printf("  %-10s %s curve, not comparable\n", "throttle",
+           curveName(THROTTLE_CURVE));
+  }
+  if (STEERING_CURVE == CURVE_LINEAR) {
+    printComparison("steering", 0, READING_MAX, fixedSteering,
+                    referenceSteering);
+  } else {
+    printf("  %-10s %s curve, not comparable\n", "steering",
+           curveName(STEERING_CURVE));
+  }
+  printComparison("dimmer", DIMMER_PWM_MIN, DIMMER_PWM_MAX, fixedDimmer,
+                  referenceDimmer);
+
+  printf("\nMapping: throttle %s, steering %s (monotonic: %s, %s)\n",
+         curveName(THROTTLE_CURVE), curveName(STEERING_CURVE),
+         verdict(monotonic(fixedThrottle)),
+         verdict(monotonic(fixedSteering)));
+  printf("  %8s %10s %12s %12s\n", "pot %", "reading", "throttle us",
+         "steering us");
+  for (int percent = 0; percent <= 100; percent += 10) {
+    int reading = (long)percent*ADC_MAX/100 + POT_OFFSET*ADC_SCALE;
+    reading = constrain(reading, 0, READING_MAX);
+    printf("  %8d %10d %12d %12d\n", percent, reading, mapThrottle(reading),
+           mapSteering(reading));
+  }
+
+  uint32_t fixedcycles = FIXED_CYCLES
+                       + (THROTTLE_CURVE == CURVE_LINEAR ? 0 : CURVE_CYCLES);
+  printf("\nMapping: cost per throttle mapping\n");
+  printf("  %-8s %18s %14s\n", "", "est. AVR cycles", "host ns");
+  printf("  %-8s %18u %14.1f\n", "map()", MAP_CYCLES, hostNsPerCall(false));
+  printf("  %-8s %18u %14.1f\n", "fixed", fixedcycles, hostNsPerCall(true));
+}
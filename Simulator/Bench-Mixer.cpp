@@ -0,0 +1,397 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Mixer Benchmark
+
+Description: Checks the mixer over every input the mappings can hand it.
+The connected inputs must pick the same mode the if/else chain in
+updateOutputs() used to, tank and single-input mixing must come out as
+before, and for every desaturation policy the outputs must stay in range,
+move the right way as either input moves and mirror left for right. Then
+compares the arcade mix with the code it replaced over the whole SPD and
+STR space: how often the mix saturates, how much of the steering and the
+throttle asked for survive it, and what is left of each at full ahead.
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+
+#include <math.h>
+#include <time.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Mapping.h"
+#include "Mixer.h"
+
+// 12-bit sampler readings, a little past ADC_MAX for noise at the ends
+#define READING_MAX       4095
+
+namespace {
+
+// Every mapped input the mixer can be handed, us from neutral
+struct Span {
+  int lo, hi;
+};
+
+Span throttleSpan() {
+  Span s = { mapThrottle(0) - PWM_NEUTRAL, mapThrottle(READING_MAX)
+                                           - PWM_NEUTRAL };
+  return s;
+}
+
+Span steeringSpan() {
+  Span s = { mapSteering(0), mapSteering(READING_MAX) };
+  return s;
+}
+
+// The if/else chain updateOutputs() used before the mixer, for the inputs
+// that are connected. -1 for neutral with nothing usable.
+int referenceMode(uint8_t connected) {
+  bool l   = connected & MIX_CONNECTED_L;
+  bool r   = connected & MIX_CONNECTED_R;
+  bool spd = connected & MIX_CONNECTED_SPD;
+  bool str = connected & MIX_CONNECTED_STR;
+  if (l && r) {
+    return MIX_TANK;
+  }
+  if (spd && str) {
+    return MIX_ARCADE;
+  }
+  if (l) {
+    return MIX_SINGLE_L;
+  }
+  if (r) {
+    return MIX_SINGLE_R;
+  }
+  return MIX_NEUTRAL;
+}
+
+// What that chain made of the inputs, as writePWM() would constrain it
+void referenceMix(uint8_t mode, const int16_t *in, int *outL, int *outR) {
+  int pwmL = PWM_NEUTRAL, pwmR = PWM_NEUTRAL;
+  switch (mode) {
+  case MIX_TANK:
+    pwmL = PWM_NEUTRAL + in[MIX_L];
+    pwmR = PWM_NEUTRAL + in[MIX_R];
+    break;
+  case MIX_ARCADE:
+    pwmL = constrain(PWM_NEUTRAL + in[MIX_SPD] + in[MIX_STR],
+                     PWM_MIN, PWM_MAX);
+    pwmR = constrain(PWM_NEUTRAL + in[MIX_SPD] - in[MIX_STR],
+                     PWM_MIN, PWM_MAX);
+    break;
+  case MIX_SINGLE_L:
+    pwmL = pwmR = PWM_NEUTRAL + in[MIX_L];
+    break;
+  case MIX_SINGLE_R:
+    pwmL = pwmR = PWM_NEUTRAL + in[MIX_R];
+    break;
+  }
+  *outL = constrain(pwmL, PWM_MIN, PWM_MAX);
+  *outR = constrain(pwmR, PWM_MIN, PWM_MAX);
+}
+
+bool checkModes() {
+  uint32_t differ = 0;
+  for (uint8_t connected = 0; connected < 16; connected++) {
+    if (mixerMode(connected) != referenceMode(connected)) {
+      differ++;
+    }
+  }
+  printf("\nMixer: mode for each of the 16 sets of connected inputs, "
+         "%u differ from the old chain: %s\n", differ,
+         verdict(differ == 0));
+  return differ == 0;
+}
+
+struct Coverage {
+  uint32_t inputs;
+  uint32_t outside;         // an output past PWM_MIN..PWM_MAX
+  uint32_t backwards;       // an output moving against an input
+  uint32_t unmirrored;      // STR negated does not swap the sides
+  uint32_t changed;         // differs from the old chain, constrained
+};
+
+typedef int16_t Grid[MIX_INPUTS];
+
+// One mix and the old chain's result, counted into the coverage
+void mixBoth(uint8_t mode, uint8_t policy, const Grid in, int *outL,
+             int *outR, Coverage *c) {
+  int refL, refR;
+  mixOutputs(mode, policy, in, outL, outR);
+  referenceMix(mode, in, &refL, &refR);
+  c->inputs++;
+  if (*outL < PWM_MIN || *outL > PWM_MAX || *outR < PWM_MIN
+      || *outR > PWM_MAX) {
+    c->outside++;
+  }
+  if (*outL != refL || *outR != refR) {
+    c->changed++;
+  }
+}
+
+// L against R, each output following its own input only
+Coverage coverTank(uint8_t policy) {
+  Coverage c = {};
+  Span     t = throttleSpan();
+  Grid     in = {};
+  int      prevL = 0, outL, outR;
+  std::vector<int> prevR(t.hi - t.lo + 1);
+  for (int l = t.lo; l <= t.hi; l++) {
+    for (int r = t.lo; r <= t.hi; r++) {
+      in[MIX_L] = l;
+      in[MIX_R] = r;
+      mixBoth(MIX_TANK, policy, in, &outL, &outR, &c);
+      if ((r > t.lo && outL != prevL)
+          || (l > t.lo && outR < prevR[r - t.lo])) {
+        c.backwards++;
+      }
+      prevL           = outL;
+      prevR[r - t.lo] = outR;
+    }
+  }
+  return c;
+}
+
+// One input to both sides
+Coverage coverSingle(uint8_t mode, uint8_t policy) {
+  Coverage c = {};
+  Span     t = throttleSpan();
+  Grid     in = {};
+  int      prev = PWM_MIN, outL, outR;
+  for (int x = t.lo; x <= t.hi; x++) {
+    in[mode == MIX_SINGLE_L ? MIX_L : MIX_R] = x;
+    mixBoth(mode, policy, in, &outL, &outR, &c);
+    if (outL != outR || outL < prev) {
+      c.backwards++;
+    }
+    prev = outL;
+  }
+  return c;
+}
+
+// SPD against STR: both sides speed up with SPD, STR moves them apart, and
+// STR negated swaps them
+Coverage coverArcade(uint8_t policy) {
+  Coverage c = {};
+  Span     t = throttleSpan();
+  Span     s = steeringSpan();
+  int      width = s.hi - s.lo + 1;
+  std::vector<int> lastL(width), lastR(width), rowL(width), rowR(width);
+  Grid     in = {};
+  for (int spd = t.lo; spd <= t.hi; spd++) {
+    for (int str = s.lo; str <= s.hi; str++) {
+      int i = str - s.lo;
+      in[MIX_SPD] = spd;
+      in[MIX_STR] = str;
+      mixBoth(MIX_ARCADE, policy, in, &rowL[i], &rowR[i], &c);
+      bool back = (i > 0 && (rowL[i] < rowL[i - 1] || rowR[i] > rowR[i - 1]))
+                  || (spd > t.lo && (rowL[i] < lastL[i]
+                                     || rowR[i] < lastR[i]));
+      if (back) {
+        c.backwards++;
+      }
+    }
+    // Mirror within the part of the row that has both signs
+    for (int str = 0; str <= s.hi && -str >= s.lo; str++) {
+      if (rowL[str - s.lo] != rowR[-str - s.lo]
+          || rowR[str - s.lo] != rowL[-str - s.lo]) {
+        c.unmirrored++;
+      }
+    }
+    lastL.swap(rowL);
+    lastR.swap(rowR);
+  }
+  return c;
+}
+
+bool printCoverage(const char *mode, uint8_t policy, const Coverage& c,
+                   bool same) {
+  bool ok = c.outside == 0 && c.backwards == 0 && c.unmirrored == 0
+            && (!same || c.changed == 0);
+  printf("  %-9s %-15s %9u %8u %10u %11u %9u%s  %s\n", mode,
+         policyName(policy), c.inputs, c.outside, c.backwards, c.unmirrored,
+         c.changed, same ? "" : "*", verdict(ok));
+  return ok;
+}
+
+bool checkCoverage() {
+  printf("\nMixer: every mapped input for each desaturation policy\n");
+  printf("  %-9s %-15s %9s %8s %10s %11s %9s\n", "mode", "policy", "inputs",
+         "outside", "backwards", "unmirrored", "changed");
+  bool ok = true;
+  for (uint8_t policy = DESAT_CLIP; policy <= DESAT_PROPORTIONAL; policy++) {
+    ok &= printCoverage("tank", policy, coverTank(policy), true);
+    ok &= printCoverage("single L", policy, coverSingle(MIX_SINGLE_L, policy),
+                        true);
+    ok &= printCoverage("single R", policy, coverSingle(MIX_SINGLE_R, policy),
+                        true);
+    ok &= printCoverage("arcade", policy, coverArcade(policy),
+                        policy == DESAT_CLIP);
+  }
+  printf("  (changed: outputs differ from the old chain after writePWM()'s "
+         "constrain; * where the\n   policy is meant to change them)\n");
+  printf("Mixer: outputs in range, monotonic and mirrored, and as before "
+         "where they should be: %s\n", verdict(ok));
+  return ok;
+}
+
+// How the arcade mix treats what was asked of it
+struct Envelope {
+  uint32_t inputs, saturated;
+  double   steering;        // share of the steering asked for delivered
+  double   throttle;        // and of the throttle, over saturated inputs
+  double   meanerror;       // degrees between the (throttle, steering)
+  double   worsterror;      //   asked for and delivered
+};
+
+// Throttle and steering out of a pair of outputs, us
+void split(int outL, int outR, double *throttle, double *steering) {
+  *throttle = (outL + outR)/2.0 - PWM_NEUTRAL;
+  *steering = (outL - outR)/2.0;
+}
+
+// The pilot asks for SPD and STR as far as each can go
+void asked(int spd, int str, double *throttle, double *steering) {
+  *throttle = constrain(spd, -HALF_RANGE, HALF_RANGE);
+  *steering = constrain(str, -HALF_RANGE, HALF_RANGE);
+}
+
+// policy < 0: the old chain
+void arcade(int policy, int spd, int str, int *outL, int *outR) {
+  Grid in = {};
+  in[MIX_SPD] = spd;
+  in[MIX_STR] = str;
+  if (policy < 0) {
+    referenceMix(MIX_ARCADE, in, outL, outR);
+  } else {
+    mixOutputs(MIX_ARCADE, policy, in, outL, outR);
+  }
+}
+
+Envelope envelope(int policy) {
+  Envelope e = {};
+  Span     t = throttleSpan();
+  Span     s = steeringSpan();
+  uint32_t steered = 0, throttled = 0;
+  for (int spd = t.lo; spd <= t.hi; spd++) {
+    for (int str = s.lo; str <= s.hi; str++) {
+      double wantT, wantS, gotT, gotS;
+      int    outL, outR;
+      asked(spd, str, &wantT, &wantS);
+      arcade(policy, spd, str, &outL, &outR);
+      split(outL, outR, &gotT, &gotS);
+      e.inputs++;
+      if (fabs(wantT) + fabs(wantS) <= HALF_RANGE) {
+        continue;
+      }
+      e.saturated++;
+      if (wantS != 0) {
+        e.steering += gotS/wantS;
+        steered++;
+      }
+      if (wantT != 0) {
+        e.throttle += gotT/wantT;
+        throttled++;
+      }
+      double error = fabs(atan2(gotS, gotT) - atan2(wantS, wantT))*180/M_PI;
+      if (error > 180) {
+        error = 360 - error;
+      }
+      e.meanerror += error;
+      if (error > e.worsterror) {
+        e.worsterror = error;
+      }
+    }
+  }
+  e.steering  = steered ? e.steering/steered : 1;
+  e.throttle  = throttled ? e.throttle/throttled : 1;
+  e.meanerror = e.saturated ? e.meanerror/e.saturated : 0;
+  return e;
+}
+
+void printEnvelope(const char *name, int policy) {
+  Envelope e   = envelope(policy);
+  int      top = throttleSpan().hi;
+  double   quarterT, quarterS, fullT, fullS;
+  int      outL, outR;
+  arcade(policy, top, STEER_MAX/4, &outL, &outR);
+  split(outL, outR, &quarterT, &quarterS);
+  arcade(policy, top, STEER_MAX, &outL, &outR);
+  split(outL, outR, &fullT, &fullS);
+  printf("  %-15s %6.1f %9.1f %9.1f %6.1f %6.1f | %5.0f %5.0f | %5.0f %5.0f\n",
+         name, 100.0*e.saturated/e.inputs, 100*e.steering, 100*e.throttle,
+         e.meanerror, e.worsterror, quarterT, quarterS, fullT, fullS);
+}
+
+double hostNsPerMix(uint8_t policy) {
+  volatile int sink = 0;
+  const uint32_t n  = 4000000;
+  Span     t = throttleSpan();
+  Grid     in = {};
+  int      outL, outR;
+  timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < n; i++) {
+    // Near full ahead, so the policies have work to do
+    in[MIX_SPD] = t.hi - (i & 0x3f);
+    in[MIX_STR] = (int)(i & 0x1ff) - 256;
+    mixOutputs(MIX_ARCADE, policy, in, &outL, &outR);
+    sink = outL + outR;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  (void)sink;
+  return ((end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec))/n;
+}
+
+} // namespace
+
+void benchMixer() {
+  checkModes();
+  checkCoverage();
+
+  Span t = throttleSpan();
+  Span s = steeringSpan();
+  printf("\nMixer: arcade envelope over SPD %d..%d and STR %d..%d us, "
+         "built with %s\n", t.lo, t.hi, s.lo, s.hi,
+         policyName(MIXER_DESATURATE));
+  printf("  %-15s %6s %9s %9s %13s | %11s | %11s\n", "", "sat.", "steering",
+         "throttle", "error deg", "quarter STR", "full STR");
+  printf("  %-15s %6s %9s %9s %6s %6s | %5s %5s | %5s %5s\n", "policy", "%",
+         "kept %", "kept %", "mean", "worst", "thr", "str", "thr", "str");
+  printEnvelope("before (clip)", -1);
+  for (uint8_t policy = DESAT_STEERING; policy <= DESAT_PROPORTIONAL;
+       policy++) {
+    printEnvelope(policyName(policy), policy);
+  }
+  printf("  (kept and error over the saturated inputs; thr and str in us "
+         "at full SPD)\n");
+
+  printf("\nMixer: cost per arcade mix near full ahead\n");
+  printf("  %-15s %14s\n", "policy", "host ns");
+  for (uint8_t policy = DESAT_CLIP; policy <= DESAT_PROPORTIONAL; policy++) {
+    printf("  %-15s %14.1f\n", policyName(policy), hostNsPerMix(policy));
+  }
+}
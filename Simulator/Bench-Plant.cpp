@@ -0,0 +1,480 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Vehicle Plant Benchmark
+
+Description: Closes the loop around the control path with a model of the
+boat. Two thrusters with ESC deadband, a first-order spin-up lag and
+roughly square-law thrust push a kayak hull with surge and yaw drag. The
+right thruster is a little weaker, as real pairs are, so straight runs
+drift off heading. Scripted manoeuvres move the pots: a full-throttle step,
+a reversal from full ahead, and a hard turn at speed that the pilot ends at
+90 degrees. Each reports rise and settling time, heading error and energy.
+
+A fast model runs the firmware's own mapping, mixing and limiter code at
+the update rate, a couple of thousand scenarios a second, and sweeps the
+limiter rate and the steering range for both limiters. The same manoeuvres
+then run once against the whole firmware, pulses and all, to show the fast
+model agrees with it. Thrust, drag and inertia are rough figures for a T200
+pair on a sit-on-top kayak, set below; the comparisons between settings
+matter more than the absolute numbers. DEADZONE only shapes the LEDs and the
+S-curve band, so the deadband the boat feels is the ESC's, set below too.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Mapping.h"
+#include "Mixer.h"
+#include "Limiter.h"
+#include "SCurve-Limiter.h"
+
+#include <math.h>
+#include <time.h>
+
+// Thrusters
+#define THRUST_AHEAD      51.0      // N at full ahead
+#define THRUST_ASTERN     40.0      // N at full astern
+#define THRUST_RIGHT      0.95      // right thruster's share of that
+#define THRUST_POWER      390.0     // W at full speed, either way
+#define ESC_DEADBAND      25        // us either side of neutral
+#define SPIN_TAU          0.10      // s, first-order spin-up lag
+
+// Hull
+#define HULL_MASS         150.0     // kg with paddler and added mass
+#define HULL_INERTIA      60.0      // kg m^2 in yaw, with added inertia
+#define HULL_ARM          0.25      // m from the centreline to a thruster
+#define DRAG_LINEAR       8.0       // N per m/s
+#define DRAG_QUADRATIC    22.0      // N per (m/s)^2
+#define YAW_LINEAR        15.0      // N m per rad/s
+#define YAW_QUADRATIC     60.0      // N m per (rad/s)^2
+#define YAW_KEEL          15.0      // N m per rad/s per m/s of surge
+
+#define PLANT_DT          2         // ms per plant step
+#define PLANT_UPDATE      20        // ms between updates, one PWM50 frame
+#define SETTLE_BAND       0.02      // of the change, to count as settled
+#define TURN_HEADING      90.0      // degrees, the pilot centres the stick
+#define SWEEP_SECONDS     0.5       // wall time for the throughput figure
+
+namespace {
+
+///////////
+// Plant //
+///////////
+
+struct Plant {
+  double spinL, spinR;      // -1..1, thruster speed
+  double surge;             // m/s
+  double yawrate;           // rad/s, positive to starboard
+  double heading;           // rad
+  double energy;            // J
+};
+
+// ESC deadband, then the thruster's command as -1..1
+double escCommand(int us) {
+  int offset = constrain(us, PWM_MIN, PWM_MAX) - PWM_NEUTRAL;
+  if (offset > ESC_DEADBAND) {
+    return (double)(offset - ESC_DEADBAND)/(HALF_RANGE - ESC_DEADBAND);
+  }
+  if (offset < -ESC_DEADBAND) {
+    return (double)(offset + ESC_DEADBAND)/(HALF_RANGE - ESC_DEADBAND);
+  }
+  return 0;
+}
+
+double thrust(double spin) {
+  return spin*fabs(spin)*(spin > 0 ? THRUST_AHEAD : THRUST_ASTERN);
+}
+
+void stepPlant(Plant *p, int usL, int usR, double dt) {
+  // Spin follows the command with a lag; power goes with its cube
+  double k = dt/(SPIN_TAU + dt);
+  p->spinL += k*(escCommand(usL) - p->spinL);
+  p->spinR += k*(escCommand(usR) - p->spinR);
+  p->energy += THRUST_POWER*(p->spinL*p->spinL*fabs(p->spinL)
+                             + p->spinR*p->spinR*fabs(p->spinR))*dt;
+
+  double left  = thrust(p->spinL);
+  double right = thrust(p->spinR)*THRUST_RIGHT;
+  double drag  = DRAG_LINEAR*p->surge + DRAG_QUADRATIC*p->surge*fabs(p->surge);
+  double damp  = (YAW_LINEAR + YAW_KEEL*fabs(p->surge))*p->yawrate
+                 + YAW_QUADRATIC*p->yawrate*fabs(p->yawrate);
+
+  // Semi-implicit Euler: rates first, then the heading from the new rate
+  p->surge   += (left + right - drag)/HULL_MASS*dt;
+  p->yawrate += (HULL_ARM*(left - right) - damp)/HULL_INERTIA*dt;
+  p->heading += p->yawrate*dt;
+}
+
+double degrees(double rad) {
+  return rad*180/M_PI;
+}
+
+/////////////////
+// Manoeuvres  //
+/////////////////
+
+enum Signal { SIGNAL_SURGE, SIGNAL_HEADING };
+
+struct Manoeuvre {
+  const char *name;
+  bool        arcade;       // SPD and STR pots instead of L and R
+  uint32_t    startms;      // the pots move to full ahead
+  uint32_t    changems;     // the change measured, 0: the start itself
+  uint32_t    endms;
+  Signal      signal;       // what rise and settling are measured on
+};
+
+const Manoeuvre manoeuvres[] = {
+  { "full-throttle step", false, 500, 0,     10000, SIGNAL_SURGE   },
+  { "reversal",           false, 500, 10000, 20000, SIGNAL_SURGE   },
+  { "hard turn at speed", true,  500, 10000, 20000, SIGNAL_HEADING },
+};
+const size_t manoeuvrecount = sizeof(manoeuvres)/sizeof(manoeuvres[0]);
+
+// Pot positions (0-1023) the pilot sets at time t: L and R, or SPD and STR
+struct Pots {
+  int a, b;
+};
+
+Pots pilot(const Manoeuvre& m, uint32_t ms, const Plant& p, bool *turning) {
+  Pots pots = { 512, 512 };
+  if (ms < m.startms) {
+    return pots;
+  }
+  pots.a = 1023;
+  pots.b = m.arcade ? 512 : 1023;
+  if (!m.changems || ms < m.changems) {
+    return pots;
+  }
+  if (!m.arcade) {
+    // Full astern on both
+    pots.a = pots.b = 0;
+  } else if (*turning && degrees(p.heading) < TURN_HEADING) {
+    // Full right stick until the bow comes round, then centre it for good
+    pots.b = 1023;
+  } else {
+    *turning = false;
+  }
+  return pots;
+}
+
+struct Metrics {
+  double rise;              // ms, 10% to 90% of the change
+  double settle;            // ms from the change to staying in the band
+  double heading;           // degrees off: drift, or past TURN_HEADING
+  double energy;            // J from the change to the end
+};
+
+// Follows the signal through one run and works out the metrics at the end
+struct Recorder {
+  const Manoeuvre& m;
+  double   from, to;
+  double   t10, t90, energyat;
+  double   startheading;
+  std::vector<float> trace;
+
+  explicit Recorder(const Manoeuvre& man) : m(man), from(0), to(0), t10(-1),
+    t90(-1), energyat(0), startheading(0) {
+    trace.reserve(m.endms/PLANT_DT + 1);
+  }
+
+  double value(const Plant& p) {
+    return m.signal == SIGNAL_SURGE ? p.surge : degrees(p.heading);
+  }
+
+  void sample(uint32_t ms, const Plant& p) {
+    uint32_t changems = m.changems ? m.changems : m.startms;
+    if (ms == changems) {
+      from         = value(p);
+      energyat     = p.energy;
+      startheading = degrees(p.heading);
+    }
+    if (ms >= changems) {
+      trace.push_back((float)value(p));
+    }
+  }
+
+  Metrics finish(const Plant& p) {
+    Metrics r = { -1, -1, 0, p.energy - energyat };
+    to = value(p);
+
+    double change = to - from;
+    double band   = fabs(change)*SETTLE_BAND;
+    for (size_t i = 0; i < trace.size(); i++) {
+      double part = (trace[i] - from)/change;
+      if (t10 < 0 && part >= 0.1) {
+        t10 = i;
+      }
+      if (t90 < 0 && part >= 0.9) {
+        t90 = i;
+      }
+      if (fabs(trace[i] - to) > band) {
+        r.settle = -1;
+      } else if (r.settle < 0) {
+        r.settle = i;
+      }
+    }
+    if (t10 >= 0 && t90 >= 0) {
+      r.rise = (t90 - t10)*PLANT_DT;
+    }
+    if (r.settle >= 0) {
+      r.settle *= PLANT_DT;
+    }
+
+    // A turn is judged against where the pilot aimed, a straight run
+    // against the heading it started on
+    double heading = degrees(p.heading);
+    r.heading = (m.signal == SIGNAL_HEADING) ? heading - TURN_HEADING
+                                             : heading - startheading;
+    return r;
+  }
+};
+
+////////////////
+// Fast Model //
+////////////////
+
+// The control path of updateOutputs() for live pots: mapping, the mix
+// and the limiters, stepped once per PWM frame
+struct Settings {
+  bool     scurve;
+  uint16_t accel;           // us/s, SCurveLimiter: speeding up
+  uint16_t steer;           // us, steering range
+  uint8_t  policy;          // DESAT_, when the mix saturates
+};
+
+template <typename L>
+void mixAndLimit(const Manoeuvre& m, const Pots& pots, const Settings& s,
+                 L *limiterL, L *limiterR, int *outL, int *outR) {
+  int16_t inputs[MIX_INPUTS] = {};
+  int     pwmL, pwmR;
+  if (m.arcade) {
+    inputs[MIX_SPD] = mapThrottle(pots.a*ADC_SCALE) - PWM_NEUTRAL;
+    inputs[MIX_STR] = (int32_t)mapSteering(pots.b*ADC_SCALE)*s.steer
+                      /STEER_MAX;
+  } else {
+    inputs[MIX_L]   = mapThrottle(pots.a*ADC_SCALE) - PWM_NEUTRAL;
+    inputs[MIX_R]   = mapThrottle(pots.b*ADC_SCALE) - PWM_NEUTRAL;
+  }
+  mixOutputs(m.arcade ? MIX_ARCADE : MIX_TANK, s.policy, inputs, &pwmL,
+             &pwmR);
+  *outL = constrain(limiterL->step(pwmL), PWM_MIN, PWM_MAX);
+  *outR = constrain(limiterR->step(pwmR), PWM_MIN, PWM_MAX);
+}
+
+template <typename L>
+Metrics runModel(const Manoeuvre& m, const Settings& s, L limiterL,
+                 L limiterR) {
+  Plant    plant   = {};
+  Recorder rec(m);
+  bool     turning = true;
+  int      outL    = PWM_NEUTRAL, outR = PWM_NEUTRAL;
+
+  for (uint32_t ms = 0; ms <= m.endms; ms += PLANT_DT) {
+    if (ms % PLANT_UPDATE == 0) {
+      simAdvance(PLANT_UPDATE*SIM_CYCLES_PER_MS);
+      mixAndLimit(m, pilot(m, ms, plant, &turning), s, &limiterL, &limiterR,
+                  &outL, &outR);
+    }
+    rec.sample(ms, plant);
+    stepPlant(&plant, outL, outR, PLANT_DT/1000.0);
+  }
+  return rec.finish(plant);
+}
+
+Metrics runModel(const Manoeuvre& m, const Settings& s) {
+  simPowerOn();
+  simSetCosting(false);
+  if (s.scurve) {
+    SCurveLimiter limiter(s.accel, SCURVE_JERK, PWM_NEUTRAL);
+    limiter.setDirectionalLimits(PWM_NEUTRAL, SCURVE_BAND, s.accel,
+                                 (uint32_t)s.accel*SCURVE_SLOWDOWN
+                                 /SCURVE_SPEEDUP,
+                                 (uint32_t)s.accel*SCURVE_REVERSAL
+                                 /SCURVE_SPEEDUP);
+    return runModel(m, s, limiter, limiter);
+  }
+  return runModel(m, s, Limiter(s.accel, PWM_NEUTRAL),
+                  Limiter(s.accel, PWM_NEUTRAL));
+}
+
+///////////////////////
+// Whole Firmware    //
+///////////////////////
+
+// The same manoeuvre against the firmware. The plant sees the pulses as
+// they leave the pins; the pilot's pots go in between plant steps.
+Metrics runWhole(const Manoeuvre& m) {
+  LoopStats stats;
+  Plant     plant   = {};
+  Recorder  rec(m);
+  bool      turning = true;
+  int       outL    = PWM_NEUTRAL, outR = PWM_NEUTRAL;
+
+  // SPD shares its pin with L, so one of R and STR is left off
+  uint8_t chA = m.arcade ? INPUT_SPD : INPUT_L;
+  uint8_t chB = m.arcade ? INPUT_STR : INPUT_R;
+  scriptAnalog(0, chA, 512);
+  scriptAnalog(0, chB, 512);
+  scriptDisconnect(0, m.arcade ? INPUT_R : INPUT_STR);
+  scriptSwitch(0, true);
+  bootFirmware(&stats);
+
+  size_t seen = 0;
+  for (uint32_t ms = 0; ms <= m.endms; ms += PLANT_DT) {
+    Pots pots = pilot(m, ms, plant, &turning);
+    simSetAnalog(chA, pots.a);
+    simSetAnalog(chB, pots.b);
+    runFirmware(ms + PLANT_DT, &stats);
+
+    // Latest pulse on each output; OC1A is PWM_R, OC1B PWM_L
+    for (; seen < simTrace.size(); seen++) {
+      const SimEvent& e = simTrace[seen];
+      if (e.kind == EVENT_PULSE_A) {
+        outR = (e.value + 500)/1000;
+      } else if (e.kind == EVENT_PULSE_B) {
+        outL = (e.value + 500)/1000;
+      }
+    }
+    rec.sample(ms, plant);
+    stepPlant(&plant, outL, outR, PLANT_DT/1000.0);
+  }
+  return rec.finish(plant);
+}
+
+// runWhole() for runInChild(), which starts the firmware's globals fresh
+void wholeRun(const void *arg, void *result) {
+  *(Metrics*)result = runWhole(*(const Manoeuvre*)arg);
+}
+
+void printMetrics(const char *label, const Metrics& r) {
+  printf("  %-24s %9.0f %10.0f %10.1f %10.0f\n", label, r.rise, r.settle,
+         r.heading, r.energy);
+}
+
+} // namespace
+
+void benchPlant() {
+  const Settings current = { SCURVE_LIMITER != 0,
+                             SCURVE_LIMITER ? SCURVE_SPEEDUP : MAX_ACCEL,
+                             STEER_MAX, MIXER_DESATURATE };
+
+  printf("\nPlant: T200 pair (%.0f/%.0f N, right at %.0f%%, lag %.0f ms, "
+         "deadband %u us) on a %.0f kg kayak\n", THRUST_AHEAD, THRUST_ASTERN,
+         THRUST_RIGHT*100, SPIN_TAU*1000, ESC_DEADBAND, HULL_MASS);
+
+  // The fast model against the whole firmware, with the options built in
+  printf("\nPlant: fast model against the whole firmware (%s %u us/s, "
+         "steering %u us, %s)\n", current.scurve ? "SCurveLimiter" : "Limiter",
+         current.accel, current.steer, policyName(current.policy));
+  printf("  %-24s %9s %10s %10s %10s\n", "", "rise ms", "settle ms",
+         "heading", "energy J");
+#if PWM_PROTOCOL == PROTOCOL_DSHOT150 || PWM_SCHEDULED
+  bool whole = false;
+#else
+  bool whole = true;
+#endif
+  for (size_t i = 0; i < manoeuvrecount; i++) {
+    printf("  %s\n", manoeuvres[i].name);
+    printMetrics("  fast model", runModel(manoeuvres[i], current));
+    if (whole) {
+      Metrics r = { -1, -1, 0, 0 };
+      runInChild(wholeRun, &manoeuvres[i], &r, sizeof(r));
+      printMetrics("  firmware", r);
+    }
+  }
+  if (!whole) {
+    printf("  firmware runs skipped, they read OC1A/OC1B pulses\n");
+  }
+
+  // The turn is where the mix saturates: full throttle and full stick
+  printf("\nPlant: hard turn at speed for each desaturation policy\n");
+  printf("  %-24s %9s %10s %10s %10s\n", "", "rise ms", "settle ms",
+         "heading", "energy J");
+  for (uint8_t policy = DESAT_CLIP; policy <= DESAT_PROPORTIONAL; policy++) {
+    Settings s = current;
+    s.policy   = policy;
+    printMetrics(policyName(policy), runModel(manoeuvres[2], s));
+  }
+
+  // Sweep the limiter rate and steering range with the fast model
+  static const uint16_t accels[] = { 250, 625, 1250, 2500, 5000 };
+  static const uint16_t steers[] = { 200, 400, 500 };
+  printf("\nPlant: sweep with the fast model\n");
+  printf("  %-8s %6s %6s", "limiter", "us/s", "steer");
+  for (size_t i = 0; i < manoeuvrecount; i++) {
+    printf(" | %-31.31s", manoeuvres[i].name);
+  }
+  printf("\n  %-8s %6s %6s", "", "", "");
+  for (size_t i = 0; i < manoeuvrecount; i++) {
+    printf(" | %7s %7s %7s %7s", "rise", "settle", "heading", "J");
+  }
+  printf("\n");
+
+  timespec start, end;
+  uint32_t scenarios = 0;
+  double   elapsed   = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (bool print = true; print || elapsed < SWEEP_SECONDS; print = false) {
+    for (uint8_t scurve = 0; scurve < 2; scurve++) {
+      for (size_t a = 0; a < sizeof(accels)/sizeof(accels[0]); a++) {
+        for (size_t st = 0; st < sizeof(steers)/sizeof(steers[0]); st++) {
+          Settings s = { scurve != 0, accels[a], steers[st],
+                         MIXER_DESATURATE };
+          if (print) {
+            printf("  %-8s %6u %6u", scurve ? "SCurve" : "Limiter", s.accel,
+                   s.steer);
+          }
+          for (size_t i = 0; i < manoeuvrecount; i++) {
+            // Steering only matters to the turn
+            if (!manoeuvres[i].arcade && st > 0) {
+              if (print) {
+                printf(" | %7s %7s %7s %7s", "", "", "", "");
+              }
+              continue;
+            }
+            Metrics r = runModel(manoeuvres[i], s);
+            scenarios++;
+            if (print) {
+              printf(" | %7.0f %7.0f %7.1f %7.0f", r.rise, r.settle,
+                     r.heading, r.energy);
+            }
+          }
+          if (print) {
+            printf("\n");
+          }
+        }
+      }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+  }
+  simSetCosting(true);
+  printf("  (rise and settle in ms from the change, heading in degrees, "
+         "energy from the change on)\n");
+  printf("Plant: %u scenarios in %.2f s, %.0f scenarios/s\n", scenarios,
+         elapsed, scenarios/elapsed);
+}
@@ -0,0 +1,160 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Power Benchmark
+
+Description: Runs the firmware enabled, disabled and enabled again, and
+reports for each stretch how much of the time the CPU was awake, what woke it
+and the supply current that works out to. Also checks that every interrupt
+that woke the CPU had a handler and that it never went to sleep unable to
+wake or in a mode that would stop the PWM timer. Build with SLEEP_IDLE=0 to
+compare against a CPU that never sleeps.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+
+// Typical ATtiny84 supply currents at 8 MHz and 5 V, read off the datasheet
+// curves. Not measured on a Thruster Commander; put board figures in here.
+#define CURRENT_ACTIVE_MA   4.5     // CPU running
+#define CURRENT_IDLE_MA     1.4     // idle sleep, timers running
+#define CURRENT_ADC_MA      0.25    // extra while the ADC is powered
+
+#define POWER_ENABLED_MS    1000    // settled after power-up and detect
+#define POWER_MOVING_MS     11000   // pots start moving
+#define POWER_OFF_MS        21000   // switch off, outputs ramp to neutral
+#define POWER_DISABLED_MS   23000   // settled at neutral
+#define POWER_ON_MS         33000   // switch on again
+#define POWER_RUN_MS        35000
+#define POWER_STEP_MS       1337
+
+namespace {
+
+struct Stretch {
+  const char *name;
+  uint32_t    from, to;     // ms
+};
+
+const Stretch stretches[] = {
+  { "enabled, pots still",  POWER_ENABLED_MS,  POWER_MOVING_MS },
+  { "enabled, pots moving", POWER_MOVING_MS,   POWER_OFF_MS },
+  { "disabled at neutral",  POWER_DISABLED_MS, POWER_ON_MS },
+};
+const size_t stretchcount = sizeof(stretches)/sizeof(stretches[0]);
+
+void printStretch(const char *name, const SimPowerStats& a,
+                  const SimPowerStats& b) {
+  double awake  = b.awakecycles - a.awakecycles;
+  double asleep = b.sleepcycles - a.sleepcycles;
+  double total  = awake + asleep;
+  double adc    = (b.adccycles - a.adccycles)/total;
+  double secs   = total/SIM_CLOCK_FREQ;
+  double ma     = (awake*CURRENT_ACTIVE_MA + asleep*CURRENT_IDLE_MA)/total
+                  + adc*CURRENT_ADC_MA;
+
+  printf("  %-22s %7.1f %7.1f %8.2f", name, 100*awake/total, 100*adc, ma);
+  for (uint8_t w = 0; w < WAKE_SOURCES; w++) {
+    printf(" %10.0f", (b.wakes[w] - a.wakes[w])/secs);
+  }
+  printf("\n");
+}
+
+} // namespace
+
+void benchPower() {
+  LoopStats stats;
+  SimPowerStats marks[stretchcount][2];
+
+  // L and R pots, STR floating, switch enabled
+  scriptAnalog(0, INPUT_L, 700);
+  scriptAnalog(0, INPUT_R, 300);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  bool ahead = false;
+  for (uint32_t ms = POWER_MOVING_MS; ms < POWER_OFF_MS;
+       ms += POWER_STEP_MS) {
+    ahead = !ahead;
+    scriptAnalog(ms, INPUT_L, ahead ? 900 : 512);
+    scriptAnalog(ms, INPUT_R, ahead ? 100 : 512);
+  }
+  scriptAnalog(POWER_OFF_MS, INPUT_L, 900);
+  scriptAnalog(POWER_OFF_MS, INPUT_R, 900);
+  scriptSwitch(POWER_OFF_MS, false);
+  scriptSwitch(POWER_ON_MS, true);
+
+  bootFirmware(&stats);
+  for (size_t i = 0; i < stretchcount; i++) {
+    runFirmware(stretches[i].from, 0);
+    marks[i][0] = simPowerStats();
+    runFirmware(stretches[i].to, 0);
+    marks[i][1] = simPowerStats();
+  }
+  runFirmware(POWER_RUN_MS, 0);
+  if (traceFile) {
+    writeTrace(traceFile);
+  }
+
+  printf("\nPower: %s, current from assumed figures (%.2f mA active, "
+         "%.2f mA idle, %.2f mA ADC)\n", SLEEP_IDLE ? "idle sleep between "
+         "passes" : "never sleeping", CURRENT_ACTIVE_MA, CURRENT_IDLE_MA,
+         CURRENT_ADC_MA);
+  printf("  %-22s %7s %7s %8s", "", "awake %", "adc %", "est mA");
+  for (uint8_t w = 0; w < WAKE_SOURCES; w++) {
+    printf(" %10s", simWakeNames[w]);
+  }
+  printf("\n  %-22s %7s %7s %8s", "", "", "", "");
+  for (uint8_t w = 0; w < WAKE_SOURCES; w++) {
+    printf(" %10s", "wakes/s");
+  }
+  printf("\n");
+  for (size_t i = 0; i < stretchcount; i++) {
+    printStretch(stretches[i].name, marks[i][0], marks[i][1]);
+  }
+
+  // Turning the switch back on has to wait for fresh readings. Scheduled
+  // outputs leave no OC1A/OC1B pulses to time.
+#if !PWM_SCHEDULED
+  StepLatency resume = measureStep((uint64_t)POWER_ON_MS*SIM_CYCLES_PER_MS,
+                                   PWM_R);
+  printf("\nPower: switch on -> first writePWM off neutral %.3f ms, "
+         "-> pulse %.3f ms\n", resume.writeus/1000, resume.pulseus/1000);
+#endif
+
+  // Every sleep has to end in a handled interrupt
+  const SimPowerStats& p = simPowerStats();
+  uint32_t unserviced = 0;
+  for (uint8_t w = 0; w < WAKE_SOURCES; w++) {
+    unserviced += p.unserviced[w];
+    if (p.unserviced[w]) {
+      printf("  %s enabled without a handler %u times\n", simWakeNames[w],
+             p.unserviced[w]);
+    }
+  }
+  printf("Power: %u sleeps, %u interrupts without a handler, %u sleeps "
+         "unable to wake, %u in a mode stopping the timers: %s\n", p.sleeps,
+         unserviced, p.neverwoke, p.clockstops,
+         verdict(!unserviced && !p.neverwoke && !p.clockstops));
+}
@@ -0,0 +1,358 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - RC Input Benchmark
+
+Description: Replays receiver pulse trains into the input pins. First on
+the pulse decoder alone: a stick sweeping end to end with width jitter,
+spikes between pulses, pulses too short, too long or jumping far off,
+missing frames and a receiver going silent. Checks that every width taken
+matches the pulse it came from, that no glitch gets through, and how soon
+a silent receiver counts as lost. Then the whole firmware with a receiver
+on L and R that starts silent, moves the sticks and goes quiet again, at
+three frame rates: how long a stick move takes to reach the thrusters,
+the shortest PWM frame the ESCs see, and the time back to neutral.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include <random>
+#include <math.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "RC-Input.h"
+#include "Servo-Driver.h"
+
+#define DECODE_FRAMES     500
+#define DECODE_PIN        INPUT_R
+#define DECODE_SETTLE     20          // pulses taken before judging them
+#define DECODE_TOLERANCE  5.0         // us, a width taken further off is
+                                      //   wrong; an edge can wait a few us
+                                      //   for another interrupt
+#define DECODE_SILENCE    300         // ms the receiver goes quiet for
+#define SWEEP_FRAMES      200         // frames from one end and back
+
+#define FW_START_MS       300         // receiver starts sending
+#define FW_STEP_MS        600         // sticks between neutral and STEP_US
+#define FW_STOP_MS        2700        // receiver goes quiet, sticks at STEP_US
+#define FW_RUN_MS         3300
+#define FW_STEP_US        1750
+#define FW_GAP_US         200         // between channel pulses in a frame
+#define FW_JITTER_US      3
+
+namespace {
+
+#if RC_INPUT
+
+///////////////////////
+// Stand-in Receiver //
+///////////////////////
+
+void setPin(void *arg) {
+  intptr_t v = (intptr_t)arg;
+  simSetAnalog(v >> 1, (v & 1) ? 1023 : 0);
+}
+
+// Schedule one pulse, in cycles
+void sendPulse(uint8_t pin, uint64_t rise, uint64_t fall) {
+  simSchedule(rise, setPin, (void*)(intptr_t)((pin << 1) | 1));
+  simSchedule(fall, setPin, (void*)(intptr_t)(pin << 1));
+}
+
+struct Pulse {
+  uint64_t rise, fall;
+  bool     glitch;      // put there to be rejected
+};
+
+struct Case {
+  const char *name;
+  uint32_t    frameus;
+  uint32_t    jitterus;     // on widths, either way
+  uint32_t    spikeevery;   // frames between spikes between pulses
+  uint32_t    badevery;     // frames between pulses too short, too long or
+                            //   jumping far off
+  uint32_t    dropevery;    // frames between three missing frames
+  bool        silence;      // DECODE_SILENCE ms without pulses halfway
+};
+
+const Case cases[] = {
+  { "clean 20 ms",          20000, 0,  0,  0,  0, false },
+  { "clean 14 ms",          14000, 0,  0,  0,  0, false },
+  { "jitter +/-4 us",       20000, 4,  0,  0,  0, false },
+  { "spikes 1 in 10",       20000, 0, 10,  0,  0, false },
+  { "bad widths 1 in 10",   20000, 0,  0, 10,  0, false },
+  { "dropouts 1 in 50",     20000, 0,  0,  0, 50, false },
+  { "receiver silent",      20000, 0,  0,  0,  0, true  },
+  { "everything",           22000, 4, 10, 10, 50, true  },
+};
+
+// The decoder alone, polled by a main loop that is sometimes busy
+void decodeCase(const Case& c) {
+  std::mt19937 rng(23);
+  std::vector<Pulse> pulses;
+
+  simPowerOn();
+  simSetAnalog(DECODE_PIN, 0);
+  initializePWMController(PWM_PROTOCOL);
+  initializeRCInput();
+
+  uint64_t t    = 20*SIM_CYCLES_PER_MS;
+  uint32_t sent = 0, glitches = 0;
+  uint64_t silencestart = 0;
+  for (uint32_t i = 0; i < DECODE_FRAMES; i++) {
+    if (c.silence && i == DECODE_FRAMES/2) {
+      silencestart = t;
+      t += (uint64_t)DECODE_SILENCE*SIM_CYCLES_PER_MS;
+    }
+    uint64_t frame = (uint64_t)c.frameus*SIM_CYCLES_PER_US;
+    if (c.dropevery && i % c.dropevery == c.dropevery - 1) {
+      t += 3*frame;
+      continue;
+    }
+
+    // The stick sweeps from one end to the other and back, in cycles
+    double us = PWM_NEUTRAL + 450*sin(2*M_PI*i/SWEEP_FRAMES);
+    if (c.jitterus) {
+      us += (int)(rng() % (2*c.jitterus + 1)) - (int)c.jitterus;
+    }
+    bool bad = c.badevery && i % c.badevery == c.badevery/2;
+    if (bad) {
+      static const int off[] = { 700, 2500, 600 };
+      us = (i/c.badevery) % 3 == 2 ? (us < PWM_NEUTRAL ? us + 600 : us - 600)
+                                   : off[(i/c.badevery) % 3];
+      glitches++;
+    } else {
+      sent++;
+    }
+    Pulse p = { t, t + (uint64_t)(us*SIM_CYCLES_PER_US + 0.5), bad };
+    sendPulse(DECODE_PIN, p.rise, p.fall);
+    pulses.push_back(p);
+
+    // A spike in the gap, far from either pulse
+    if (c.spikeevery && i % c.spikeevery == c.spikeevery/2) {
+      uint64_t at = t + frame/2 + (rng() % 2000)*SIM_CYCLES_PER_US;
+      Pulse s = { at, at + (5 + rng() % 40)*SIM_CYCLES_PER_US, true };
+      sendPulse(DECODE_PIN, s.rise, s.fall);
+      pulses.push_back(s);
+      glitches++;
+    }
+    t += frame;
+  }
+  uint64_t until = t + 2*RC_TIMEOUT*SIM_CYCLES_PER_MS;
+
+  uint32_t taken = 0, judged = 0, wrong = 0, losses = 0;
+  double   errsum = 0, errmax = 0, lostms = -1;
+  bool     lost = false;
+  size_t   k = 0;
+  while (simNow() < until) {
+    uint8_t fresh = readRCInput();
+    while (k < pulses.size() && pulses[k].fall <= simNow()) {
+      k++;
+    }
+    // The width taken is the latest pulse's. Judged once the receiver has
+    // surely been seen and rcInputWidth() gives it out.
+    if ((fresh & (1 << DECODE_PIN)) && ++taken > DECODE_SETTLE) {
+      const Pulse& p = pulses[k - 1];
+      double err = fabs(rcInputWidth(DECODE_PIN)
+                        - (double)(p.fall - p.rise)/SIM_CYCLES_PER_US);
+      if (p.glitch || err > DECODE_TOLERANCE) {
+        wrong++;
+      } else {
+        judged++;
+        errsum += err;
+        if (err > errmax) {
+          errmax = err;
+        }
+      }
+    }
+    bool now = rcInputLost();
+    if (now && !lost) {
+      losses++;
+      if (silencestart && lostms < 0) {
+        // From the end of the last pulse before the silence
+        uint64_t last = 0;
+        for (size_t i = 0; i < pulses.size(); i++) {
+          if (!pulses[i].glitch && pulses[i].fall <= silencestart) {
+            last = pulses[i].fall;
+          }
+        }
+        lostms = (double)(simNow() - last)/SIM_CYCLES_PER_MS;
+      }
+    }
+    lost = now;
+    simAdvance((rng() % 20 == 0) ? 900*SIM_CYCLES_PER_US
+                                 : 20*SIM_CYCLES_PER_US);
+  }
+
+  // Going quiet after the last frame is no loss mid-run
+  printf("  %-20s %6u %6u %6u %6u %6u %8.2f %8.2f %6u %8.1f\n", c.name,
+         sent, glitches, taken, sent - (taken - wrong), wrong,
+         judged ? errsum/judged : 0, errmax,
+         losses - 1, lostms);
+}
+
+// The whole firmware with a receiver on L and R, sending frameus frames
+void firmwareRun(const void *arg, void *) {
+  uint32_t frameus = *(const uint32_t*)arg;
+  std::mt19937 rng(24);
+  LoopStats stats;
+  std::vector<uint64_t> stepcycles;
+
+  // The receiver holds its pins low until it starts sending
+  scriptAnalog(0, INPUT_L, 0);
+  scriptAnalog(0, INPUT_R, 0);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  bootFirmware(&stats);
+
+  // R's pulse, then L's: the end of L's is the end of the frame
+  int      held  = PWM_NEUTRAL;
+  uint64_t last  = 0;
+  for (uint64_t us = FW_START_MS*1000ull; us < FW_STOP_MS*1000ull;
+       us += frameus) {
+    int stick = ((us/1000 - FW_START_MS)/FW_STEP_MS) % 2 ? FW_STEP_US
+                                                          : PWM_NEUTRAL;
+    uint64_t t = us*SIM_CYCLES_PER_US;
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      int width = stick + (int)(rng() % (2*FW_JITTER_US + 1)) - FW_JITTER_US;
+      uint64_t fall = t + (uint64_t)width*SIM_CYCLES_PER_US;
+      sendPulse(ch ? INPUT_L : INPUT_R, t, fall);
+      t = fall + FW_GAP_US*SIM_CYCLES_PER_US;
+      last = fall;
+    }
+    if (stick != held) {
+      stepcycles.push_back(last);
+      held = stick;
+    }
+  }
+
+  runFirmware(FW_RUN_MS, &stats);
+
+  // Stick moves to pulses out
+  double lmin = 1e30, lmax = 0, lsum = 0;
+  uint32_t n = 0;
+  for (size_t i = 0; i < stepcycles.size(); i++) {
+    for (uint8_t pin = PWM_L; pin <= PWM_R; pin++) {
+      StepLatency s = measureStep(stepcycles[i], pin);
+      if (s.pulseus < 0) {
+        continue;
+      }
+      double ms = s.pulseus/1000;
+      lmin = (ms < lmin) ? ms : lmin;
+      lmax = (ms > lmax) ? ms : lmax;
+      lsum += ms;
+      n++;
+    }
+  }
+
+  // Frames while the receiver sends, outputs held at neutral until the
+  // first stick move, and the time back to neutral once it goes quiet
+  uint64_t first = stepcycles.empty() ? 0 : stepcycles[0];
+  uint64_t lastframe = 0;
+  double   shortest = 1e30, timeoutms = -1, neutralms = -1;
+  bool     still = true;
+  int32_t  out = -1;
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind == EVENT_FRAME) {
+      if (lastframe && e.cycle > FW_START_MS*(uint64_t)SIM_CYCLES_PER_MS
+          && e.cycle < last) {
+        double ms = (double)(e.cycle - lastframe)/SIM_CYCLES_PER_MS;
+        shortest = (ms < shortest) ? ms : shortest;
+      }
+      lastframe = e.cycle;
+    }
+    if (e.kind != EVENT_PULSE_A && e.kind != EVENT_PULSE_B) {
+      continue;
+    }
+    if (e.cycle < first
+        && abs(e.value - PWM_NEUTRAL*1000) > DEADZONE*1000) {
+      still = false;
+    }
+    if (e.kind != EVENT_PULSE_A || e.cycle < last) {
+      continue;
+    }
+    double ms = (double)(e.cycle - last)/SIM_CYCLES_PER_MS;
+    if (out < 0) {
+      out = e.value;
+    } else if (e.value != out && timeoutms < 0) {
+      timeoutms = ms;
+    }
+    if (e.value == PWM_NEUTRAL*1000 && neutralms < 0) {
+      neutralms = ms;
+    }
+  }
+
+  printf("  %-8.1f %6u %8.2f %8.2f %8.2f %10.1f %8s %9.1f %9.1f\n",
+         frameus/1000.0, n, n ? lmin : -1, n ? lsum/n : -1, n ? lmax : -1,
+         shortest < 1e30 ? shortest : -1, verdict(still), timeoutms,
+         neutralms);
+}
+
+#endif
+
+} // namespace
+
+void benchRC() {
+#if RC_INPUT
+  printf("\nRC: decoder on pin %u, %u frames per case, stick sweeping end "
+         "to end\n", DECODE_PIN, DECODE_FRAMES);
+  printf("  %-20s %6s %6s %6s %6s %6s %8s %8s %6s %8s\n", "case", "sent",
+         "bad", "taken", "missed", "wrong", "mean us", "max us", "lost",
+         "lost ms");
+  for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+    decodeCase(cases[i]);
+  }
+  printf("  (missed: good pulses not taken, the first can lack a frame "
+         "before it;\n   wrong: glitches taken, or widths over %.0f us off; "
+         "lost: times the receiver\n   counted as lost mid-run; lost ms: "
+         "silence to lost)\n", DECODE_TOLERANCE);
+
+#if PWM_PROTOCOL > PROTOCOL_PWM400 || PWM_SCHEDULED
+  printf("\nRC: firmware runs skipped, they read 1000-2000 us pulses on "
+         "OC1A/OC1B\n");
+  return;
+#endif
+  printf("\nRC: firmware with a receiver on L and R, sticks moving every %u "
+         "ms, quiet from %u ms\n", FW_STEP_MS, FW_STOP_MS);
+  printf("  %-8s %6s %8s %8s %8s %10s %8s %9s %9s\n", "frame ms", "steps",
+         "min ms", "mean ms", "max ms", "shortest", "neutral", "timeout",
+         "to 1500");
+  // The firmware's globals only start out fresh once per process, so each
+  // receiver runs in a child of its own
+  static const uint32_t frames[] = { 14000, 18000, 22000 };
+  for (size_t i = 0; i < sizeof(frames)/sizeof(frames[0]); i++) {
+    if (!runInChild(firmwareRun, &frames[i], 0, 0)) {
+      return;
+    }
+  }
+  printf("  (stick move to the first pulse out; shortest PWM frame while the "
+         "receiver sends;\n   neutral: outputs within DEADZONE of it until "
+         "the first stick move, the receiver\n   silent at first; timeout "
+         "and to 1500: ms from the last pulse)\n");
+#else
+  printf("\nRC: skipped, build with OPTIONS=\"-DRC_INPUT=1\"\n");
+#endif
+}
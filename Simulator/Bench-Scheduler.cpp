@@ -0,0 +1,314 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Scheduler Benchmark
+
+Description: Drives the PWM scheduler with random pulse widths on every
+channel, written at random times across thousands of frames while the ADC
+interrupt keeps running, and rebuilds each pulse from the pin edges. Every
+pulse must carry a whole width that was written before its frame started,
+never part of one update and part of another. Reports how late the outputs
+rise after the frame starts and how far each width is off. Then runs the
+firmware on four channels, with the extra pair following L and R, and has
+loop() hang to see the failsafe bring every channel to neutral.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Servo-Driver.h"
+#include "ADC-Sampler.h"
+
+
+#define SCHEDULER_FRAMES    2000      // driver run
+#define SCHEDULER_WRITES    4         // random writes per frame, on average
+#define SCHEDULER_CLOSE     20        // us, near another channel's width
+#define SCHEDULER_MATCH     1.5       // us, width taken as the one written
+#define SCHEDULER_POT_L     900
+#define SCHEDULER_POT_R     200
+#define SCHEDULER_STEADY_MS 2000      // outputs have settled by then
+#define SCHEDULER_FAULT_MS  3000      // loop() hangs
+#define SCHEDULER_RUN_MS    3200
+#define SCHEDULER_BOUND_MS  (FRAME_SYNC ? 40 : 2*UPDATE_DT)
+
+namespace {
+
+#if PWM_CHANNELS > 2
+
+const uint8_t pins[4]  = { PWM_L, PWM_R, PWM_3, PWM_4 };
+const char   *names[4] = { "PWM_L", "PWM_R", "PWM_3", "PWM_4" };
+
+struct Write {
+  uint64_t start;       // writePWM() called
+  uint64_t end;         // and returned
+  int      us;
+};
+
+struct Spread {
+  double   min, max, sum;
+  uint32_t n;
+};
+
+void resetSpread(Spread *s) {
+  s->min = 1e30;
+  s->max = -1e30;
+  s->sum = 0;
+  s->n   = 0;
+}
+
+void track(Spread *s, double v) {
+  if (v < s->min) s->min = v;
+  if (v > s->max) s->max = v;
+  s->sum += v;
+  s->n++;
+}
+
+void printSpread(const char *name, const Spread& s) {
+  if (s.n == 0) {
+    printf("  %-24s %10s\n", name, "-");
+    return;
+  }
+  printf("  %-24s %10.3f %10.3f %10.3f\n", name, s.min, s.sum/s.n, s.max);
+}
+
+double cyclesToUs(uint64_t cycles) {
+  return (double)cycles/SIM_CYCLES_PER_US;
+}
+
+uint32_t countFrames(uint64_t from, uint64_t to) {
+  uint32_t n = 0;
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    n += e.kind == EVENT_FRAME && e.cycle >= from && e.cycle < to;
+  }
+  return n;
+}
+
+///////////////////////
+// Driver, Randomly  //
+///////////////////////
+
+// Widths a pulse may carry: the last write that returned before its frame
+// started, or one that was still going on between then and the rise. The
+// one closest to the measured width, with how far off it is. Neutral until
+// the first write.
+double widthError(const std::vector<Write>& writes, const TracePulse& p) {
+  double width = cyclesToUs(p.fall - p.rise);
+  bool   fresh = writes.empty() || writes[0].end > p.frame;
+  double best  = fresh ? width - PWM_NEUTRAL : 1e30;
+
+  for (size_t i = 0; i < writes.size(); i++) {
+    const Write& w = writes[i];
+    if (w.start > p.rise) {
+      break;
+    }
+    bool before = w.end <= p.frame
+                  && (i + 1 == writes.size() || writes[i + 1].end > p.frame);
+    if (before || w.end > p.frame) {
+      double err = width - w.us;
+      if (fabs(err) < fabs(best)) {
+        best = err;
+      }
+    }
+  }
+  return best;
+}
+
+void driverRun() {
+  std::vector<Write> writes[PWM_CHANNELS];
+  int      last[PWM_CHANNELS];
+  uint32_t close = 0;
+
+  simPowerOn();
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    pinMode(pins[c], OUTPUT);
+    last[c] = PWM_NEUTRAL;
+  }
+  initializePWMController(PWM_PROTOCOL);
+
+  // ADC and Timer0 interrupts hold up the compare interrupt now and then
+  initializeADCSampler();
+
+  srand(1);
+  uint32_t frame = simTimer1FrameCycles();
+  uint64_t until = (uint64_t)SCHEDULER_FRAMES*frame;
+  while (simNow() < until) {
+    simAdvance(rand() % (2*frame/SCHEDULER_WRITES));
+
+    // Half the writes land near another channel's width, so edges come
+    // closer than the interrupt can come back for
+    uint8_t c  = rand() % PWM_CHANNELS;
+    int     us = PWM_MIN + rand() % (PWM_MAX - PWM_MIN + 1);
+    if (rand() % 2) {
+      us = last[rand() % PWM_CHANNELS]
+           + rand() % (2*SCHEDULER_CLOSE + 1) - SCHEDULER_CLOSE;
+      us = constrain(us, PWM_MIN, PWM_MAX);
+      close++;
+    }
+    Write w = { simNow(), 0, us };
+    writePWM(pins[c], us);
+    w.end   = simNow();
+    last[c] = us;
+    writes[c].push_back(w);
+  }
+
+  // Frames started before the last one, whose pulses may not have ended
+  uint64_t end    = until - frame;
+  uint32_t frames = countFrames(0, end);
+  uint32_t total  = 0;
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    total += writes[c].size();
+  }
+  printf("\nScheduler: %u channels, %u frames, %u random writes (%u near "
+         "another channel's width)\n", PWM_CHANNELS, frames, total, close);
+  printf("  %-24s %10s %10s %10s\n", "", "min us", "mean us", "max us");
+
+  Spread   rise, error;
+  uint32_t torn = 0, missing = 0, pulsecount = 0;
+  resetSpread(&rise);
+  resetSpread(&error);
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    std::vector<TracePulse> pulses = findPulses(pins[c]);
+    uint32_t                count  = 0;
+    for (size_t i = 0; i < pulses.size() && pulses[i].frame < end; i++) {
+      double err = widthError(writes[c], pulses[i]);
+      track(&rise, cyclesToUs(pulses[i].rise - pulses[i].frame));
+      if (fabs(err) > SCHEDULER_MATCH) {
+        torn++;
+      } else {
+        track(&error, err);
+      }
+      count++;
+    }
+    pulsecount += count;
+    missing    += frames - count;
+  }
+  printSpread("frame start -> rise", rise);
+  printSpread("width - written", error);
+  printf("  pulses %u, missing %u, not a written width %u: %s\n",
+         pulsecount, missing, torn, verdict(torn == 0 && missing == 0));
+}
+
+/////////////////////////
+// Firmware, 4 Outputs //
+/////////////////////////
+
+void firmwareRun(const void *, void *) {
+  LoopStats stats;
+
+  scriptAnalog(0, INPUT_L, SCHEDULER_POT_L);
+  scriptAnalog(0, INPUT_R, SCHEDULER_POT_R);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  injectHang(SCHEDULER_FAULT_MS, true);
+
+  bootFirmware(&stats);
+  bool ran = runFirmware(SCHEDULER_RUN_MS, &stats);
+
+  uint64_t steady = (uint64_t)SCHEDULER_STEADY_MS*SIM_CYCLES_PER_MS;
+  uint64_t fault  = (uint64_t)SCHEDULER_FAULT_MS*SIM_CYCLES_PER_MS;
+  uint32_t frames = countFrames(steady, fault);
+  std::vector<TracePulse> pulses[PWM_CHANNELS];
+
+  printf("\nScheduler: firmware with pots at %d and %d, %s follows PWM_L"
+         "%s; loop() hangs at %u ms\n", SCHEDULER_POT_L, SCHEDULER_POT_R,
+         names[2], PWM_CHANNELS > 3 ? ", PWM_4 follows PWM_R" : "",
+         SCHEDULER_FAULT_MS);
+  printf("  %-8s %8s %8s %10s %10s %10s %10s %10s\n", "output", "frames",
+         "pulses", "min us", "max us", "rise min", "rise max", "neutral");
+
+  double   worst    = 0;
+  bool     neutral  = true;
+  uint32_t mismatch = 0;
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    Spread   width, rise;
+    uint32_t count = 0;
+    double   tons  = -1;
+    resetSpread(&width);
+    resetSpread(&rise);
+    pulses[c] = findPulses(pins[c]);
+    for (size_t i = 0; i < pulses[c].size(); i++) {
+      const TracePulse& p = pulses[c][i];
+      double us = cyclesToUs(p.fall - p.rise);
+      if (p.frame >= steady && p.frame < fault) {
+        count++;
+        track(&width, us);
+        track(&rise, cyclesToUs(p.rise - p.frame));
+      }
+      if (p.frame >= fault && tons < 0
+          && fabs(us - PWM_NEUTRAL) <= SCHEDULER_MATCH) {
+        tons = (double)(p.rise - fault)/SIM_CYCLES_PER_MS;
+      }
+    }
+    printf("  %-8s %8u %8u %10.3f %10.3f %10.3f %10.3f %10.1f\n", names[c],
+           frames, count, width.min, width.max, rise.min, rise.max, tons);
+    if (tons < 0) {
+      neutral = false;
+    } else if (tons > worst) {
+      worst = tons;
+    }
+  }
+
+  // The extra pair carries the same width as L and R in every frame
+  for (uint8_t c = 2; c < PWM_CHANNELS; c++) {
+    const std::vector<TracePulse>& a = pulses[c - 2];
+    const std::vector<TracePulse>& b = pulses[c];
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size(); ) {
+      if (a[i].frame < b[j].frame) {
+        i++;
+      } else if (b[j].frame < a[i].frame) {
+        j++;
+      } else {
+        double diff = cyclesToUs(a[i].fall - a[i].rise)
+                      - cyclesToUs(b[j].fall - b[j].rise);
+        mismatch += fabs(diff) > SCHEDULER_MATCH;
+        i++;
+        j++;
+      }
+    }
+  }
+  printf("  frames where a pair differs %u; %s\n", mismatch,
+         ran ? "no reset" : "reset after the hang");
+#if FAILSAFE
+  printf("Scheduler: every output neutral within %u ms of the hang: %s\n",
+         SCHEDULER_BOUND_MS,
+         verdict(neutral && worst <= SCHEDULER_BOUND_MS));
+#endif
+}
+
+#endif
+
+} // namespace
+
+void benchScheduler() {
+#if PWM_CHANNELS > 2
+  driverRun();
+
+  // In a child, so the hang and the firmware's globals stay there
+  runInChild(firmwareRun, 0, 0, 0);
+#else
+  printf("\nScheduler: skipped, build with OPTIONS=\"-DPWM_CHANNELS=4\"\n");
+#endif
+}
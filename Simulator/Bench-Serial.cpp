@@ -0,0 +1,341 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Serial Command Benchmark
+
+Description: A stand-in companion computer sends command frames into
+SERIAL_RX bit by bit. Reports parser throughput, what the link delivers
+with clock error and corrupted bytes, how long a command takes to reach the
+thruster pulses and the command timeout. Needs a SERIAL_COMMAND build.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+// Standard headers first: the Arduino abs() macro breaks <random>
+#include <random>
+#include <time.h>
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Serial-Command.h"
+
+#define LINK_FRAMES       2000
+#define FIRMWARE_RUN_MS   20000
+#define FIRMWARE_RATE_MS  23        // companion computer command period,
+                                    // drifts against the PWM frame
+#define FIRMWARE_STEP_MS  1337
+
+#if SERIAL_COMMAND
+
+namespace {
+
+/////////////////////////////
+// Stand-in Companion Side //
+/////////////////////////////
+
+// The companion computer drives the line, so the ADC sees its level too
+void setRx(void *level) {
+  simSetAnalog(SERIAL_RX, level ? 1023 : 0);
+}
+
+// CRC-8, polynomial 0x07, written from the spec rather than shared with the
+// firmware
+uint8_t crc8(const uint8_t *data, uint8_t length) {
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (uint8_t)((crc << 1) ^ ((crc & 0x80) ? 0x07 : 0));
+    }
+  }
+  return crc;
+}
+
+void buildFrame(uint8_t *out, uint8_t sequence, bool armed, int left,
+                int right) {
+  out[0] = 0xA5;
+  out[1] = sequence;
+  out[2] = armed ? 1 : 0;
+  out[3] = left & 0xFF;
+  out[4] = left >> 8;
+  out[5] = right & 0xFF;
+  out[6] = right >> 8;
+  out[7] = crc8(out, 7);
+}
+
+// Schedule 8N1 bytes on SERIAL_RX from the given cycle with the given bit
+// length, returns the cycle the last stop bit ends
+uint64_t sendBytes(uint64_t cycle, const uint8_t *data, uint8_t length,
+                   double bitcycles) {
+  double t = (double)cycle;
+  for (uint8_t i = 0; i < length; i++) {
+    uint16_t bits = (uint16_t)((data[i] << 1) | 0x200);   // start, data, stop
+    bool     level = true;
+    for (uint8_t b = 0; b < 10; b++) {
+      bool bit = (bits >> b) & 1;
+      if (bit != level) {
+        simSchedule((uint64_t)t, setRx, (void*)(intptr_t)bit);
+        level = bit;
+      }
+      t += bitcycles;
+    }
+  }
+  return (uint64_t)t;
+}
+
+/////////////////
+// Measurement //
+/////////////////
+
+struct Stats {
+  double   min, max, sum;
+  uint32_t n;
+};
+
+void resetStats(Stats *s) {
+  s->min = 1e30;
+  s->max = s->sum = 0;
+  s->n   = 0;
+}
+
+void addStat(Stats *s, double v) {
+  if (v < s->min) s->min = v;
+  if (v > s->max) s->max = v;
+  s->sum += v;
+  s->n++;
+}
+
+// Host cost of the parser on a stream of good and damaged frames
+void parserThroughput() {
+  std::mt19937   rng(8);
+  std::vector<uint8_t> stream;
+  uint32_t       sent = 0, damaged = 0;
+
+  for (uint32_t i = 0; i < 200000; i++) {
+    uint8_t f[COMMAND_LENGTH];
+    buildFrame(f, (uint8_t)i, true, PWM_MIN + rng() % 1001,
+               PWM_MIN + rng() % 1001);
+    if (rng() % 10 == 0) {
+      f[rng() % COMMAND_LENGTH] ^= (uint8_t)(1 << (rng() % 8));
+      damaged++;
+    }
+    stream.insert(stream.end(), f, f + COMMAND_LENGTH);
+    sent++;
+  }
+
+  SerialCommand command;
+  uint32_t accepted = 0;
+  timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < stream.size(); i++) {
+    accepted += parseSerialByte(stream[i], &command);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double ns = (end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec);
+
+  const uint8_t check[] = "123456789";
+  printf("\nSerial: parser\n");
+  printf("  CRC-8 check value 0x%02X (spec 0xF4)\n", commandCRC(check, 9));
+  printf("  frames %u, damaged %u, accepted %u, undamaged %u\n", sent,
+         damaged, accepted, sent - damaged);
+  printf("  host %.1f ns/byte, %.1f Mbyte/s\n", ns/stream.size(),
+         stream.size()*1e3/ns);
+}
+
+// Frames through the pin change interrupt and ring buffer with a polling
+// main loop that is sometimes busy for a control pass
+void linkTest(const char *name, double clockerror, uint32_t damageevery) {
+  std::mt19937 rng(9);
+  double   bitcycles = (double)F_CPU/SERIAL_BAUD*(1 + clockerror);
+  std::vector<uint64_t> frameend;
+  std::vector<uint8_t>  damaged;
+
+  simPowerOn();
+  initializeSerialCommand();
+
+  uint64_t t = 1000*SIM_CYCLES_PER_US;
+  for (uint32_t i = 0; i < LINK_FRAMES; i++) {
+    uint8_t f[COMMAND_LENGTH];
+    buildFrame(f, (uint8_t)i, true, PWM_MIN + i % 1001, PWM_MAX - i % 1001);
+    bool bad = damageevery && (i % damageevery == damageevery - 1);
+    if (bad) {
+      f[1 + rng() % (COMMAND_LENGTH - 1)] ^= 0x10;
+    }
+    t = sendBytes(t, f, COMMAND_LENGTH, bitcycles);
+    // Latency counts from the middle of the last stop bit
+    frameend.push_back(t - (uint64_t)(bitcycles/2));
+    damaged.push_back(bad);
+    // Mostly back to back, sometimes a pause
+    if (rng() % 4 == 0) {
+      t += (rng() % 3000)*SIM_CYCLES_PER_US;
+    }
+  }
+  uint64_t until = t + 5*SIM_CYCLES_PER_MS;
+
+  SerialCommand command;
+  Stats    latency;
+  uint32_t received = 0, wrong = 0;
+  size_t   next = 0;
+  uint32_t isrbefore = simOps[OP_ISR];
+  resetStats(&latency);
+  while (simNow() < until) {
+    if (readSerialCommand(&command)) {
+      // Frames arrive in order, skip those lost on the way
+      size_t k = next;
+      while (k < frameend.size() && (k & 0xFF) != command.sequence) {
+        k++;
+      }
+      next = k + 1;
+      received++;
+      if (k == frameend.size() || damaged[k]
+          || command.left != PWM_MIN + (int)(k % 1001)) {
+        wrong++;
+      } else {
+        addStat(&latency, (double)(simNow() - frameend[k])/SIM_CYCLES_PER_US);
+      }
+    }
+    simAdvance((rng() % 20 == 0) ? 900*SIM_CYCLES_PER_US
+                                 : 20*SIM_CYCLES_PER_US);
+  }
+
+  uint32_t good = 0;
+  for (size_t i = 0; i < damaged.size(); i++) {
+    good += !damaged[i];
+  }
+  double seconds = (double)(t - 1000*SIM_CYCLES_PER_US)/F_CPU;
+  printf("  %-18s %6u %6u %6u %6u %8.0f %8.0f %8.0f %8.1f %7.2f\n", name,
+         LINK_FRAMES, good, received, wrong, latency.min,
+         latency.n ? latency.sum/latency.n : 0, latency.max,
+         received/seconds,
+         (double)(simOps[OP_ISR] - isrbefore)/(LINK_FRAMES*COMMAND_LENGTH));
+}
+
+// The firmware driven by serial commands: latency to the pulses and the
+// timeout back to neutral
+void firmwareTest() {
+  LoopStats stats;
+  std::vector<uint64_t> stepcycles;
+  double   bitcycles = (double)F_CPU/SERIAL_BAUD;
+  uint64_t lastframe = 0;
+  int      cmd = PWM_NEUTRAL;
+  uint8_t  sequence = 0;
+
+  // The SPD pot at neutral and the line idling high on the STR pin until
+  // the first frame, which must not read as full steering
+  scriptAnalog(0, INPUT_SPD, 512);
+  scriptDisconnect(0, INPUT_R);
+  scriptAnalog(0, INPUT_STR, 1023);
+  scriptSwitch(0, true);
+  bootFirmware(&stats);
+
+  // Frames go on the event queue after power-on
+  for (uint32_t ms = 500; ms < FIRMWARE_RUN_MS/2; ms += FIRMWARE_RATE_MS) {
+    uint8_t f[COMMAND_LENGTH];
+    int next = ((ms/FIRMWARE_STEP_MS) % 2) ? 1800 : PWM_NEUTRAL;
+    buildFrame(f, sequence++, true, next, next);
+    lastframe = sendBytes((uint64_t)ms*SIM_CYCLES_PER_MS, f, COMMAND_LENGTH,
+                          bitcycles);
+    if (next != cmd) {
+      stepcycles.push_back(lastframe);
+      cmd = next;
+    }
+  }
+
+  runFirmware(FIRMWARE_RUN_MS, &stats);
+
+  uint32_t idlepulses = 0, steered = 0;
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.cycle >= 500ull*SIM_CYCLES_PER_MS
+        || (e.kind != EVENT_PULSE_A && e.kind != EVENT_PULSE_B)) {
+      continue;
+    }
+    idlepulses++;
+    if (abs(e.value - PWM_NEUTRAL*1000) > DEADZONE*1000) {
+      steered++;
+    }
+  }
+  printf("\nSerial: line idle before the first frame, %u of %u pulses off "
+         "neutral: %s\n", steered, idlepulses, verdict(!steered));
+
+  std::vector<StepLatency> steps;
+  for (size_t i = 0; i < stepcycles.size(); i++) {
+    steps.push_back(measureStep(stepcycles[i], PWM_L));
+    steps.push_back(measureStep(stepcycles[i], PWM_R));
+  }
+  printLatencies("Serial: end of frame to output latency", steps);
+
+  // Time from the last frame until the pulses start back toward neutral
+  // (the timeout) and until they get there (the limiter's ramp)
+  double timeoutms = -1, neutralms = -1;
+  int32_t held = -1;
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.cycle < lastframe || e.kind != EVENT_PULSE_A) {
+      continue;
+    }
+    double ms = (double)(e.cycle - lastframe)/SIM_CYCLES_PER_MS;
+    if (held < 0) {
+      held = e.value;
+    } else if (e.value != held && timeoutms < 0) {
+      timeoutms = ms;
+    }
+    if (e.value == PWM_NEUTRAL*1000 && neutralms < 0) {
+      neutralms = ms;
+    }
+  }
+  printf("  last frame (%d us) to timeout %.1f ms, to neutral %.1f ms "
+         "(SERIAL_TIMEOUT %u ms)\n", cmd, timeoutms, neutralms,
+         SERIAL_TIMEOUT);
+
+  if (traceFile) {
+    writeTrace(traceFile);
+  }
+}
+
+} // namespace
+
+void benchSerial() {
+  parserThroughput();
+
+  printf("\nSerial: link at %u baud, %u frames per case\n", SERIAL_BAUD,
+         LINK_FRAMES);
+  printf("  %-18s %6s %6s %6s %6s %8s %8s %8s %8s %7s\n", "case", "sent",
+         "good", "recvd", "wrong", "min us", "mean us", "max us", "frame/s",
+         "isr/B");
+  linkTest("exact clock", 0, 0);
+  linkTest("sender +2%", 0.02, 0);
+  linkTest("sender -2%", -0.02, 0);
+  linkTest("1 in 10 damaged", 0, 10);
+
+  firmwareTest();
+}
+
+#else
+
+void benchSerial() {
+  printf("\nSerial: skipped, build with OPTIONS=\"-DSERIAL_COMMAND=1\"\n");
+}
+
+#endif
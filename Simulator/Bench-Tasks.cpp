@@ -0,0 +1,221 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Task Scheduler Benchmark
+
+Description: Checks the firmware's task table. Lays the periodic releases of
+every task over one hyperperiod and looks for two whose budget windows
+overlap, then bounds how long each task can wait for the CPU once released.
+Runs the firmware through pots moving and the switch going off and on again
+and prints what the scheduler counted for each task: runs, releases deferred
+behind an earlier row, releases missed, runs over budget, the longest run
+and the latest start.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Task-Scheduler.h"
+#include "Black-Box.h"
+#include "Sketch-Prototypes.h"
+
+#define TASKS_STEP_MS     1337
+#define TASKS_OFF_MS      8000      // switch off, outputs ramp to neutral
+#define TASKS_ON_MS       9000      // and on again
+#define TASKS_RUN_MS      10000
+#define TASKS_LATE        2         // ticks; millis() steps 2 ms at a time,
+                                    //   now and then 3
+
+namespace {
+
+const char *taskName(const Task& task) {
+  if (task.run == updateOutputs) {
+    return "update";
+  }
+  if (task.run == detect) {
+    return "detect";
+  }
+  if (task.run == refreshIndicator) {
+    return "indicator";
+  }
+#if BLACK_BOX
+  if (task.run == flushBlackBox) {
+    return "black box";
+  }
+#endif
+  return "?";
+}
+
+uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// Static check of the table. Each periodic release holds the CPU from its
+// tick for up to its budget; no two of these windows may overlap. The
+// frame-synced update has no tick, so it counts once against every task.
+bool checkTable() {
+  uint8_t  count = taskCount();
+  uint32_t hyper = 1;
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t period = taskEntry(i).period;
+    if (period) {
+      hyper = hyper/gcd(hyper, period)*period;
+    }
+  }
+
+  bool     collide[TASK_MAX][TASK_MAX] = {};
+  uint32_t releases[TASK_MAX]          = {};
+  uint32_t overlaps                    = 0;
+  uint32_t total                       = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const Task& a = taskEntry(i);
+    if (!a.period) {
+      continue;
+    }
+    for (uint32_t ta = a.phase; ta < a.phase + hyper; ta += a.period) {
+      releases[i]++;
+      total++;
+      for (uint8_t j = i + 1; j < count; j++) {
+        const Task& b = taskEntry(j);
+        if (!b.period) {
+          continue;
+        }
+        for (uint32_t tb = b.phase; tb < b.phase + hyper; tb += b.period) {
+          // Both sequences repeat every hyperperiod, so compare modulo it
+          int64_t  gap   = (int64_t)(tb % hyper)*1000 - (ta % hyper)*1000;
+          uint32_t first = gap >= 0 ? a.budget : b.budget;
+          if ((gap >= 0 ? gap : -gap) < first) {
+            collide[i][j] = collide[j][i] = true;
+            overlaps++;
+          }
+        }
+      }
+    }
+  }
+
+  printf("\nTasks: table of %u rows (at most %u), hyperperiod %u ms\n",
+         count, TASK_MAX, hyper);
+  printf("  %-10s %7s %6s %8s %9s %13s\n", "task", "period", "phase",
+         "budget", "releases", "worst wait us");
+  for (uint8_t i = 0; i < count; i++) {
+    const Task& task = taskEntry(i);
+
+    // Without preemption a release waits for a later row that has just
+    // started, and for each earlier row that can be due at the same time
+    uint32_t wait = 0;
+    for (uint8_t j = i + 1; j < count; j++) {
+      if (taskEntry(j).budget > wait) {
+        wait = taskEntry(j).budget;
+      }
+    }
+    for (uint8_t j = 0; j < i; j++) {
+      if (!taskEntry(j).period || collide[i][j]) {
+        wait += taskEntry(j).budget;
+      }
+    }
+
+    if (task.period) {
+      printf("  %-10s %7u %6u %8u %9u %13u\n", taskName(task), task.period,
+             task.phase, task.budget, releases[i], wait);
+    } else {
+      printf("  %-10s %7s %6s %8u %9s %13u\n", taskName(task), "frame", "-",
+             task.budget, "-", wait);
+    }
+  }
+  printf("Tasks: %u periodic releases per hyperperiod, %u overlapping: %s\n",
+         total, overlaps, verdict(overlaps == 0));
+  return overlaps == 0;
+}
+
+void printCounts(const char *title) {
+  printf("\n%s\n", title);
+  printf("  %-10s %8s %9s %8s %9s %9s %12s\n", "task", "runs", "deferred",
+         "missed", "overruns", "max us", "max late ms");
+  for (uint8_t i = 0; i < taskCount(); i++) {
+    const TaskStats& s = taskStats(i);
+    printf("  %-10s %8u %9u %8u %9u %9u %12u\n", taskName(taskEntry(i)),
+           s.runs, s.deferred, s.missed, s.overruns, s.maxrun, s.maxlate);
+  }
+}
+
+// What the scheduler itself counted over a session. Turning the switch off
+// writes the reset log to EEPROM from the update, milliseconds the other
+// tasks wait out, so only the counts from before then are judged.
+bool firmwareRun() {
+  LoopStats stats;
+
+  // L and R pots moving, the switch off and on again near the end
+  scriptAnalog(0, INPUT_L, 512);
+  scriptAnalog(0, INPUT_R, 512);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  bool ahead = false;
+  for (uint32_t ms = 1000; ms < TASKS_OFF_MS; ms += TASKS_STEP_MS) {
+    ahead = !ahead;
+    scriptAnalog(ms, INPUT_L, ahead ? 900 : 512);
+    scriptAnalog(ms, INPUT_R, ahead ? 100 : 512);
+  }
+  scriptSwitch(TASKS_OFF_MS, false);
+  scriptSwitch(TASKS_ON_MS, true);
+
+  bootFirmware(&stats);
+  runFirmware(TASKS_OFF_MS, &stats);
+
+  char title[96];
+  snprintf(title, sizeof(title), "Tasks: firmware run to %u ms, pots moving",
+           TASKS_OFF_MS);
+  printCounts(title);
+  bool ok = true;
+  for (uint8_t i = 0; i < taskCount(); i++) {
+    const TaskStats& s = taskStats(i);
+    if (s.runs == 0 || s.missed || s.overruns || s.maxlate > TASKS_LATE) {
+      ok = false;
+    }
+  }
+  printf("Tasks: every task ran, none missed a release or ran over budget, "
+         "none started over %u ms late: %s\n", TASKS_LATE, verdict(ok));
+
+  runFirmware(TASKS_RUN_MS, &stats);
+  snprintf(title, sizeof(title), "Tasks: on to %u ms, switch off at %u ms "
+           "and on at %u ms", TASKS_RUN_MS, TASKS_OFF_MS, TASKS_ON_MS);
+  printCounts(title);
+  return ok;
+}
+
+} // namespace
+
+void benchTasks() {
+  // The table is handed to the scheduler in setup()
+  LoopStats stats;
+  bootFirmware(&stats);
+
+  checkTable();
+  firmwareRun();
+}
@@ -0,0 +1,175 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Timing Statistics Benchmark
+
+Description: Decodes the timing counters the firmware saves to EEPROM. In a
+TIMING_STATS build it runs the firmware through a session that ends with the
+switch turned off, then reads the snapshot back out of the simulated EEPROM
+and sets it beside the simulator's own loop() timing. It can also decode an
+EEPROM image read from a real board.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+#include "Timing-Stats.h"
+
+#define TIMING_RUN_MS     24000
+#define TIMING_STEP_MS    1337
+#define TIMING_OFF_MS     20000     // switch off, outputs ramp to neutral
+
+namespace {
+
+const char *probeNames[TIMING_PROBES] = { "update", "detect", "indicator",
+                                          "latency" };
+
+void printSnapshot(const char *title, const TimingSnapshot& snapshot) {
+  printf("\n%s\n", title);
+  if (snapshot.magic != TIMING_MAGIC || snapshot.probes != TIMING_PROBES) {
+    printf("  no timing snapshot (magic 0x%02x, %u probes)\n", snapshot.magic,
+           snapshot.probes);
+    return;
+  }
+
+  double us = snapshot.tickns/1000.0;
+  printf("  Timer1 tick %u ns, histogram buckets in ticks\n",
+         snapshot.tickns);
+  printf("  %-10s %8s %9s %9s %9s %9s", "probe", "count", "min us", "mean us",
+         "max us", "last us");
+  for (uint8_t b = 0; b < TIMING_BUCKETS; b++) {
+    char label[16];
+    snprintf(label, sizeof(label), "<%u", 4u << (2*b));
+    printf(" %7s", b == TIMING_BUCKETS - 1 ? "more" : label);
+  }
+  printf("\n");
+
+  for (uint8_t p = 0; p < TIMING_PROBES; p++) {
+    const TimingStat& s = snapshot.stat[p];
+    if (s.count == 0) {
+      printf("  %-10s %8u\n", probeNames[p], 0);
+      continue;
+    }
+    printf("  %-10s %8u %9.1f %9.1f %9.1f %9.1f", probeNames[p], s.count,
+           s.min*us, (double)s.sum/s.count*us, s.max*us, s.last*us);
+    for (uint8_t b = 0; b < TIMING_BUCKETS; b++) {
+      printf(" %7u", s.histogram[b]);
+    }
+    printf("\n");
+  }
+}
+
+void decodeFile(const char *path) {
+  TimingSnapshot snapshot;
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  memset(&snapshot, 0, sizeof(snapshot));
+  if (fseek(f, TIMING_EEPROM, SEEK_SET) != 0
+      || fread(&snapshot, sizeof(snapshot), 1, f) != 1) {
+    printf("\nTiming: %s is too short for a snapshot\n", path);
+  } else {
+    printSnapshot("Timing: snapshot from EEPROM image", snapshot);
+  }
+  fclose(f);
+}
+
+void firmwareRun() {
+  LoopStats stats;
+
+  // L and R pots, switch enabled, then off near the end to save the counters
+  scriptAnalog(0, INPUT_L, 512);
+  scriptAnalog(0, INPUT_R, 512);
+  scriptDisconnect(0, INPUT_STR);
+  scriptSwitch(0, true);
+  bool ahead = false;
+  for (uint32_t ms = 1000; ms < TIMING_OFF_MS; ms += TIMING_STEP_MS) {
+    ahead = !ahead;
+    scriptAnalog(ms, INPUT_L, ahead ? 900 : 512);
+    scriptAnalog(ms, INPUT_R, ahead ? 100 : 512);
+  }
+  scriptSwitch(TIMING_OFF_MS, false);
+
+  simEraseEEPROM();
+  bootFirmware(&stats);
+  runFirmware(TIMING_RUN_MS, &stats);
+
+  TimingSnapshot snapshot;
+  memcpy(&snapshot, simEEPROM + TIMING_EEPROM, sizeof(snapshot));
+  printSnapshot("Timing: firmware counters saved to EEPROM at switch off",
+                snapshot);
+  printLoopStats("Timing: simulator's own view (virtual time, ops/call)",
+                 stats);
+}
+
+#if TIMING_STATS
+// A probe run more than 65535 times, as the indicator's is in about 134 s,
+// still catches a longer run after its count has stopped
+void saturationCheck() {
+  TimingSnapshot snapshot;
+
+  simPowerOn();
+  initializeTimingStats();
+  TCNT1 = 100;
+  for (uint32_t i = 0; i < 70000; i++) {
+    recordTiming(TIMING_INDICATOR, 0);
+  }
+  TCNT1 = 5000;
+  recordTiming(TIMING_INDICATOR, 0);
+  TCNT1 = 10;
+  recordTiming(TIMING_INDICATOR, 0);
+  readTimingStats(&snapshot);
+
+  const TimingStat& s = snapshot.stat[TIMING_INDICATOR];
+  bool ok = s.count == 0xffff && s.sum == 0xfffful*100 && s.max == 5000
+            && s.min == 10 && s.histogram[3] == 0xffff
+            && s.histogram[6] == 1 && s.histogram[1] == 1;
+  printf("\nTiming: 70002 runs of one probe, count %u, min %u, max %u ticks, "
+         "the longest and shortest after the count stopped: %s\n", s.count,
+         s.min, s.max, verdict(ok));
+}
+#endif
+
+} // namespace
+
+void benchTiming() {
+  printf("\nTiming: snapshot is %u bytes at EEPROM address %u\n",
+         (uint32_t)sizeof(TimingSnapshot), TIMING_EEPROM);
+
+  if (eepromFile) {
+    decodeFile(eepromFile);
+  } else if (TIMING_STATS) {
+    firmwareRun();
+#if TIMING_STATS
+    saturationCheck();
+#endif
+  } else {
+    printf("\nTiming: firmware run skipped, build with "
+           "OPTIONS=\"-DTIMING_STATS=1\"\n");
+  }
+}
@@ -0,0 +1,424 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Harness
+
+Description: Helpers shared by the host benchmarks: scripted pot and switch
+inputs, a main() stand-in that calls loop() against the virtual clock, and
+per-call accounting of the Arduino core operations each loop() pass uses.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+#include "Thruster-Commander.h"
+
+#include <deque>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+enum ActionKind {
+  ACTION_ANALOG,
+  ACTION_DISCONNECT,
+  ACTION_SWITCH,
+  ACTION_ADC_FAULT
+};
+
+struct Action {
+  uint8_t kind;
+  uint8_t channel;
+  int     value;
+};
+
+// Actions must stay put once scheduled, so keep them in a deque
+std::deque<Action> actions;
+std::vector<std::pair<uint64_t, Action*> > pending;
+
+// Firmware faults, checked between loop() passes
+uint64_t hangcycle  = UINT64_MAX;
+bool     hangints;
+uint64_t stallcycle = UINT64_MAX;
+uint32_t stallcycles;
+uint8_t  lastreset;
+
+// Set by the first check that fails
+bool     failed;
+
+void applyAction(void *arg) {
+  Action *a = (Action*)arg;
+  switch (a->kind) {
+  case ACTION_ANALOG:
+    simSetAnalog(a->channel, a->value);
+    break;
+  case ACTION_DISCONNECT:
+    simDisconnectAnalog(a->channel);
+    break;
+  case ACTION_SWITCH:
+    simGroundPin(SWITCH, a->value);
+    break;
+  case ACTION_ADC_FAULT:
+    simSetADCFault(a->value);
+    break;
+  }
+}
+
+void addAction(uint32_t ms, uint8_t kind, uint8_t channel, int value) {
+  Action a = { kind, channel, value };
+  actions.push_back(a);
+  pending.push_back(std::make_pair((uint64_t)ms*SIM_CYCLES_PER_MS,
+                                   &actions.back()));
+}
+
+void accountPass(LoopStats *stats, uint64_t start, size_t tracestart,
+                 const uint32_t *opsbefore) {
+  PassKind kind = PASS_IDLE;
+  for (size_t i = tracestart; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind == EVENT_OCR1A || e.kind == EVENT_OCR1B) {
+      kind = PASS_CONTROL;
+      break;
+    }
+    if (e.kind == EVENT_PIN && e.channel == DETECT) {
+      kind = PASS_DETECT;
+    }
+  }
+  if (kind == PASS_IDLE
+      && simOps[OP_ANALOGREAD] != opsbefore[OP_ANALOGREAD]) {
+    kind = PASS_DETECT;
+  }
+  PassStats& p   = stats->pass[kind];
+  uint32_t cycles = (uint32_t)(simNow() - start);
+  p.calls++;
+  p.cycles += cycles;
+  if (cycles > p.maxcycles) {
+    p.maxcycles = cycles;
+  }
+  for (uint8_t i = 0; i < OP_COUNT; i++) {
+    p.ops[i] += simOps[i] - opsbefore[i];
+  }
+}
+
+} // namespace
+
+///////////////////
+// Input Scripts //
+///////////////////
+
+void scriptAnalog(uint32_t ms, uint8_t channel, int value) {
+  addAction(ms, ACTION_ANALOG, channel, value);
+}
+
+void scriptDisconnect(uint32_t ms, uint8_t channel) {
+  addAction(ms, ACTION_DISCONNECT, channel, 0);
+}
+
+void scriptSwitch(uint32_t ms, bool enabled) {
+  addAction(ms, ACTION_SWITCH, 0, enabled);
+}
+
+void scriptADCFault(uint32_t ms, uint8_t fault) {
+  addAction(ms, ACTION_ADC_FAULT, 0, fault);
+}
+
+void injectHang(uint32_t ms, bool interrupts) {
+  hangcycle = (uint64_t)ms*SIM_CYCLES_PER_MS;
+  hangints  = interrupts;
+}
+
+void injectStall(uint32_t ms, uint32_t duration) {
+  stallcycle  = (uint64_t)ms*SIM_CYCLES_PER_MS;
+  stallcycles = duration*SIM_CYCLES_PER_MS;
+}
+
+///////////////////////
+// Running Firmware  //
+///////////////////////
+
+bool bootFirmware(LoopStats *stats) {
+  simPowerOn();
+  memset(stats, 0, sizeof(*stats));
+
+  // Inputs at 0 ms are the power-on state, the rest go on the event queue
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (pending[i].first == 0) {
+      applyAction(pending[i].second);
+    } else {
+      simSchedule(pending[i].first, applyAction, pending[i].second);
+    }
+  }
+  pending.clear();
+
+  try {
+    setup();
+  } catch (const SimReset& r) {
+    lastreset = r.flags;
+    return false;
+  }
+  stats->setupcycles = (uint32_t)simNow();
+  return true;
+}
+
+bool runFirmware(uint32_t ms, LoopStats *stats) {
+  uint64_t until = (uint64_t)ms*SIM_CYCLES_PER_MS;
+  uint32_t opsbefore[OP_COUNT];
+
+  try {
+    while (simNow() < until) {
+      uint64_t start      = simNow();
+      size_t   tracestart = simTrace.size();
+      memcpy(opsbefore, simOps, sizeof(opsbefore));
+
+      if (simNow() >= stallcycle) {
+        stallcycle = UINT64_MAX;
+        simAdvance(stallcycles);
+      }
+      if (simNow() >= hangcycle) {
+        // Interrupts keep running, loop() never gets called again
+        if (!hangints) {
+          cli();
+        }
+        while (simNow() < until) {
+          simAdvance(SIM_CYCLES_PER_MS);
+        }
+        break;
+      }
+      loop();
+      simAdvance(COST_LOOP);
+
+      if (stats) {
+        accountPass(stats, start, tracestart, opsbefore);
+      }
+    }
+  } catch (const SimReset& r) {
+    lastreset = r.flags;
+    return false;
+  }
+  return true;
+}
+
+uint8_t resetFlags() {
+  return lastreset;
+}
+
+bool runInChild(void (*fn)(const void *arg, void *result), const void *arg,
+                void *result, size_t size) {
+  int fds[2];
+
+  fflush(stdout);
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    return false;
+  }
+  pid_t child = fork();
+  if (child == 0) {
+    close(fds[0]);
+    fn(arg, result);
+    const char *p = (const char*)result;
+    size_t left   = size;
+    while (left) {
+      ssize_t n = write(fds[1], p, left);
+      if (n <= 0) {
+        perror("write");
+        break;
+      }
+      p    += n;
+      left -= n;
+    }
+    fflush(stdout);
+    _exit(checksFailed() ? 1 : 0);
+  }
+  close(fds[1]);
+  size_t got = 0;
+  if (child < 0) {
+    perror("fork");
+    failed = true;
+  } else {
+    ssize_t n;
+    while (got < size
+           && (n = read(fds[0], (char*)result + got, size - got)) > 0) {
+      got += n;
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (got != size || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = true;
+    }
+  }
+  close(fds[0]);
+  return child > 0 && got == size;
+}
+
+////////////////
+// Reporting  //
+////////////////
+
+StepLatency measureStep(uint64_t cycle, uint8_t channel) {
+  uint8_t writekind = (channel == 6) ? EVENT_OCR1A : EVENT_OCR1B;
+  uint8_t pulsekind = (channel == 6) ? EVENT_PULSE_A : EVENT_PULSE_B;
+  int32_t lastwrite = -1, lastpulse = -1;
+  StepLatency step  = { cycle, -1, -1 };
+
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind != writekind && e.kind != pulsekind) {
+      continue;
+    }
+    int32_t& last = (e.kind == writekind) ? lastwrite : lastpulse;
+    double&  out  = (e.kind == writekind) ? step.writeus : step.pulseus;
+    if (e.cycle < cycle) {
+      last = e.value;
+    } else if (out < 0 && e.value != last) {
+      out = (double)(e.cycle - cycle)/SIM_CYCLES_PER_US;
+    }
+  }
+  return step;
+}
+
+std::vector<TracePulse> findPulses(uint8_t pin) {
+  std::vector<TracePulse> pulses;
+  TracePulse p     = { 0, 0, 0 };
+  uint64_t   frame = 0;
+  bool       high  = false;
+
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    if (e.kind == EVENT_FRAME) {
+      frame = e.cycle;
+    } else if (e.kind == EVENT_PIN && e.channel == pin) {
+      if (e.value) {
+        p.frame = frame;
+        p.rise  = e.cycle;
+        high    = true;
+      } else if (high) {
+        p.fall  = e.cycle;
+        high    = false;
+        pulses.push_back(p);
+      }
+    }
+  }
+  return pulses;
+}
+
+const char *verdict(bool ok) {
+  if (!ok) {
+    failed = true;
+  }
+  return ok ? "ok" : "NO";
+}
+
+bool checksFailed() {
+  return failed;
+}
+
+const char *policyName(uint8_t policy) {
+  static const char *names[] = { "clip", "steering first", "throttle first",
+                                 "proportional" };
+  return names[policy];
+}
+
+void printLoopStats(const char *title, const LoopStats& stats) {
+  static const char *names[PASS_KINDS] = { "control", "detect", "idle" };
+
+  printf("\n%s\n", title);
+  printf("  setup(): %.1f us\n", stats.setupcycles/(double)SIM_CYCLES_PER_US);
+  printf("  %-8s %9s %10s %10s", "pass", "calls", "mean us", "max us");
+  for (uint8_t op = 0; op < OP_COUNT; op++) {
+    if (op != OP_REGREAD && op != OP_REGWRITE) {
+      printf(" %8.8s", simOpNames[op]);
+    }
+  }
+  printf("\n");
+  for (uint8_t k = 0; k < PASS_KINDS; k++) {
+    const PassStats& p = stats.pass[k];
+    if (p.calls == 0) {
+      continue;
+    }
+    printf("  %-8s %9u %10.1f %10.1f", names[k], p.calls,
+           p.cycles/(double)p.calls/SIM_CYCLES_PER_US,
+           p.maxcycles/(double)SIM_CYCLES_PER_US);
+    for (uint8_t op = 0; op < OP_COUNT; op++) {
+      if (op != OP_REGREAD && op != OP_REGWRITE) {
+        printf(" %8.2f", p.ops[op]/(double)p.calls);
+      }
+    }
+    printf("\n");
+  }
+}
+
+void printLatencies(const char *title, const std::vector<StepLatency>& steps) {
+  double wmin = 1e30, wmax = 0, wsum = 0;
+  double pmin = 1e30, pmax = 0, psum = 0;
+  double lmin = 1e30, lmax = 0, lsum = 0;
+  uint32_t n = 0;
+
+  for (size_t i = 0; i < steps.size(); i++) {
+    if (steps[i].writeus < 0 || steps[i].pulseus < 0) {
+      continue;
+    }
+    n++;
+    wsum += steps[i].writeus;
+    psum += steps[i].pulseus;
+    if (steps[i].writeus < wmin) wmin = steps[i].writeus;
+    if (steps[i].writeus > wmax) wmax = steps[i].writeus;
+    if (steps[i].pulseus < pmin) pmin = steps[i].pulseus;
+    if (steps[i].pulseus > pmax) pmax = steps[i].pulseus;
+
+    // How long the new compare value waited for its pulse
+    double lead = steps[i].pulseus - steps[i].writeus;
+    lsum += lead;
+    if (lead < lmin) lmin = lead;
+    if (lead > lmax) lmax = lead;
+  }
+
+  printf("\n%s (%u of %u steps)\n", title, n, (uint32_t)steps.size());
+  if (n == 0) {
+    return;
+  }
+  printf("  %-22s %10s %10s %10s\n", "", "min ms", "mean ms", "max ms");
+  printf("  %-22s %10.3f %10.3f %10.3f\n", "input -> writePWM",
+         wmin/1000, wsum/n/1000, wmax/1000);
+  printf("  %-22s %10.3f %10.3f %10.3f\n", "input -> pulse",
+         pmin/1000, psum/n/1000, pmax/1000);
+  printf("  %-22s %10.3f %10.3f %10.3f\n", "writePWM -> pulse",
+         lmin/1000, lsum/n/1000, lmax/1000);
+}
+
+void writeTrace(const char *path) {
+  static const char *names[] = { "OCR1A", "OCR1B", "OCR0A", "OCR0B",
+                                 "PULSE_A", "PULSE_B", "PIN", "FRAME" };
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "time_us,event,channel,value\n");
+  for (size_t i = 0; i < simTrace.size(); i++) {
+    const SimEvent& e = simTrace[i];
+    fprintf(f, "%.3f,%s,%u,%d\n", (double)e.cycle/SIM_CYCLES_PER_US,
+            names[e.kind], e.channel, e.value);
+  }
+  fclose(f);
+}
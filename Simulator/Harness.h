@@ -0,0 +1,161 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Harness
+
+Description: Helpers shared by the host benchmarks: scripted pot and switch
+inputs, a main() stand-in that calls loop() against the virtual clock, and
+per-call accounting of the Arduino core operations each loop() pass uses.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef HARNESS
+#define HARNESS
+
+#include <Arduino.h>
+
+#include <stdio.h>
+
+// Kinds of loop() pass, classified by what they did to the outputs
+enum PassKind {
+  PASS_CONTROL,     // wrote OCR1A/OCR1B
+  PASS_DETECT,      // toggled DETECT or sampled inputs without output
+  PASS_IDLE,        // neither
+  PASS_KINDS
+};
+
+struct PassStats {
+  uint32_t calls;
+  uint64_t cycles;
+  uint32_t maxcycles;
+  uint64_t ops[OP_COUNT];
+};
+
+struct LoopStats {
+  PassStats pass[PASS_KINDS];
+  uint32_t  setupcycles;
+};
+
+// A pulse on an output pin, from the trace
+struct TracePulse {
+  uint64_t frame;         // timer1 BOTTOM before its rising edge
+  uint64_t rise;
+  uint64_t fall;
+};
+
+// An input step and when each output reacted to it
+struct StepLatency {
+  uint64_t cycle;         // when the input changed
+  double   writeus;       // until writePWM() changed the compare register
+  double   pulseus;       // until the first pulse with the new width began
+};
+
+///////////////////
+// Input Scripts //
+///////////////////
+
+void scriptAnalog(uint32_t ms, uint8_t channel, int value);
+void scriptDisconnect(uint32_t ms, uint8_t channel);
+void scriptSwitch(uint32_t ms, bool enabled);
+void scriptADCFault(uint32_t ms, uint8_t fault);
+
+// Faults in the firmware itself. From the given time on loop() hangs,
+// optionally with interrupts off; or a single loop() pass takes longer.
+void injectHang(uint32_t ms, bool interrupts);
+void injectStall(uint32_t ms, uint32_t duration);
+
+///////////////////////
+// Running Firmware  //
+///////////////////////
+
+// Power on, apply the initial inputs already scripted at 0 ms, call setup().
+// False if the part reset before setup() returned.
+bool bootFirmware(LoopStats *stats);
+
+// Call loop() until the virtual clock passes the given time. False if the
+// part reset first, resetFlags() has its MCUSR.
+bool runFirmware(uint32_t ms, LoopStats *stats);
+uint8_t resetFlags();
+
+// Call fn(arg, result) in a child process, since the firmware's globals only
+// start out fresh once per process, and a hang stays in the child. The size
+// bytes it leaves at result are copied back. False if the child could not
+// be started or did not report them. A check failed in the child, or a child
+// that exits abnormally, counts as a failed check here.
+bool runInChild(void (*fn)(const void *arg, void *result), const void *arg,
+                void *result, size_t size);
+
+////////////////
+// Reporting  //
+////////////////
+
+// Latency from an input change to the first writePWM() and the first pulse
+// on the given channel (6: PWM_R/OC1A, 5: PWM_L/OC1B) that differ from the
+// values before the change
+StepLatency measureStep(uint64_t cycle, uint8_t channel);
+
+// Every complete pulse on an output pin in the trace, in order
+std::vector<TracePulse> findPulses(uint8_t pin);
+
+// "ok" or "NO" for the outcome of a check. Print every verdict through
+// this: a NO makes the simulator exit non-zero, also from a child of
+// runInChild(), so a regression fails the make target that ran it.
+const char *verdict(bool ok);
+bool checksFailed();
+
+// Name of a DESAT_ policy of the mixer
+const char *policyName(uint8_t policy);
+
+void printLoopStats(const char *title, const LoopStats& stats);
+void printLatencies(const char *title, const std::vector<StepLatency>& steps);
+void writeTrace(const char *path);
+
+////////////////
+// Benchmarks //
+////////////////
+
+// Options shared by the benchmarks, set from the command line
+extern const char *traceFile;
+extern const char *eepromFile;   // EEPROM image to decode
+
+void benchBaseline();
+void benchLimiter();
+void benchDShot();
+void benchSerial();
+void benchMapping();
+void benchTiming();
+void benchPower();
+void benchBoot();
+void benchFailsafe();
+void benchScheduler();
+void benchBus();
+void benchTasks();
+void benchPlant();
+void benchMixer();
+void benchRC();
+void benchBlackBox();
+void benchIndicator();
+
+#endif
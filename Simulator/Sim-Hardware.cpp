@@ -0,0 +1,1523 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Hardware
+
+Description: This code builds the Thruster Commander firmware natively on a
+Linux host. It replaces the ATtiny84 registers and the parts of the Arduino
+core used by the firmware with a mock layer driven by a virtual clock, so the
+control path can be profiled and replayed without a boat.
+
+The simulated part runs at 8 MHz. All virtual time is kept in CPU cycles.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+#include <deque>
+#include <queue>
+
+//////////////////////
+// Register Storage //
+//////////////////////
+
+SimReg8  TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0;
+SimReg8  TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+SimReg16 TCNT1, OCR1A, OCR1B, ICR1;
+SimReg8  PORTA, DDRA, PINA, PORTB, DDRB, PINB;
+SimReg8  ADMUX, ADCSRA, ADCSRB, DIDR0;
+SimReg16 ADC;
+SimReg8  GIMSK, GIFR, PCMSK0, PCMSK1;
+SimReg8  SREG;
+SimReg8  MCUCR, PRR;
+SimReg8  WDTCSR, MCUSR;
+SimReg8  USICR, USISR, USIDR, USIBR;
+
+const char *simOpNames[OP_COUNT] = {
+  "analogRead", "digitalRead", "digitalWrite", "pinMode", "millis", "micros",
+  "delay", "map", "eeprom", "cli", "sei", "sleep", "reg read", "reg write",
+  "isr"
+};
+const char *simWakeNames[WAKE_SOURCES] = {
+  "PCINT0", "WDT", "TIM1_COMPA", "TIM1_COMPB", "TIM1_OVF", "TIM0_COMPA", "TIM0_OVF",
+  "ADC", "USI_STR", "USI_OVF"
+};
+uint32_t simOps[OP_COUNT];
+
+uint8_t simEEPROM[SIM_EEPROM_SIZE] = { 0 };
+uint32_t simEEPROMWrites[SIM_EEPROM_SIZE] = { 0 };
+
+std::vector<SimEvent> simTrace;
+bool                  simTraceEnabled = true;
+
+namespace {
+
+///////////
+// State //
+///////////
+
+uint64_t  now;
+bool      ienabled;
+bool      costing = true;
+
+// The EEPROM byte being written is done at this cycle
+uint64_t  eeprombusy;
+
+// Sleep and power accounting
+bool          sleeping;
+SimPowerStats power;
+
+// Scheduled outside-world callbacks
+struct Scheduled {
+  uint64_t    cycle;
+  uint64_t    seq;
+  SimCallback fn;
+  void       *arg;
+  bool operator>(const Scheduled& o) const {
+    return (cycle != o.cycle) ? (cycle > o.cycle) : (seq > o.seq);
+  }
+};
+std::priority_queue<Scheduled, std::vector<Scheduled>,
+                    std::greater<Scheduled> > scheduled;
+uint64_t  scheduledseq;
+
+// Timer0 is owned by the Arduino core: prescaler 64, overflow every 2.048 ms
+#define T0_PRESCALE     64
+#define T0_PERIOD       (256ul*T0_PRESCALE)
+uint64_t  t0start;
+uint8_t   t0flags;
+bool      t0compadone;
+uint32_t  timer0millis;
+uint8_t   timer0fract;
+uint32_t  timer0overflows;
+
+// Timer1
+uint64_t  t1base;
+uint32_t  t1countbase;
+uint16_t  t1prescale;
+uint16_t  t1ocra, t1ocrb;           // active (latched) compare values
+uint8_t   t1flags;
+bool      t1topdone, t1compadone, t1compbdone;
+
+// Watchdog
+uint32_t  wdtfreq = SIM_WDT_FREQ;
+uint8_t   wdtcsr, mcusr;
+uint64_t  wdtstart;                   // last WDR or start
+bool      wdtchange;                  // WDCE set, next write may change it
+uint8_t   resetflags = _BV(PORF);     // MCUSR after the next power-on
+
+// ADC
+uint8_t   adcfault;
+bool      adcbusy;
+bool      adcflag;
+bool      adcstarted;                 // first conversion after ADEN is longer
+uint64_t  adcdone;
+int       adcsample;
+
+// Outside world
+bool      extlevel[11];
+bool      grounded[11];
+int       analogvalue[8];
+bool      analogconnected[8];
+int       analognoise;
+uint32_t  noiseseed = 12345;
+bool      detectlevel;
+uint64_t  detectchange;
+double    detectfrom;
+uint8_t   lastporta, lastportb;
+
+// Pin change interrupts
+uint8_t   pinlevelsa, pinlevelsb;     // last seen PINA/PINB
+uint8_t   gflags;                     // GIFR
+
+// USI in two-wire mode
+#define USI_SCL   4                   // pins, PA4 and PA6
+#define USI_SDA   6
+uint8_t   usiflags;                   // USISIF, USIOIF and USIPF
+uint8_t   usicount;                   // 4-bit counter
+bool      usistarthold;               // holding SCL low after a start
+bool      usilatch;                   // SDA output latch, USIDR bit 7
+bool      usiscl, usisda;             // line levels last seen
+
+// I2C master
+enum I2COpKind { I2C_SDA, I2C_SCL_LOW, I2C_SCL_RELEASE, I2C_WAIT, I2C_ACK,
+                 I2C_READ, I2C_LET_GO, I2C_BUS_FREE };
+struct I2COp {
+  uint8_t kind;
+  uint8_t arg;                        // SDA level, or byte read into
+};
+std::deque<SimI2CTransfer*> i2cqueue;
+SimI2CTransfer             *i2ccurrent;
+std::vector<I2COp>          i2cops;
+size_t                      i2cnext;
+
+void trace(uint8_t kind, uint8_t channel, int32_t value) {
+  if (simTraceEnabled) {
+    SimEvent e = { now, kind, channel, value };
+    simTrace.push_back(e);
+  }
+}
+
+////////////
+// Timer1 //
+////////////
+
+uint8_t t1Mode() {
+  return ((TCCR1B.value >> WGM12) & 0x3) << 2 | (TCCR1A.value & 0x3);
+}
+
+bool t1Buffered() {
+  uint8_t mode = t1Mode();
+  return mode == 14 || mode == 15 || mode == 5 || mode == 6 || mode == 7;
+}
+
+uint16_t t1Top() {
+  switch (t1Mode()) {
+  case 12:
+  case 14: return ICR1.value;
+  case 4:
+  case 15: return t1ocra;
+  case 5:  return 0xFF;
+  case 6:  return 0x1FF;
+  case 7:  return 0x3FF;
+  default: return 0xFFFF;
+  }
+}
+
+uint16_t prescaleFromBits(uint8_t cs) {
+  static const uint16_t table[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+  return table[cs & 0x7];
+}
+
+// The counter wraps after TOP, unless it was already past TOP (TOP lowered
+// or TCNT1 written above it), in which case it runs out to 0xFFFF first
+uint32_t t1WrapCount() {
+  uint32_t top = t1Top();
+  return (t1countbase > top) ? 0x10000ul : top + 1;
+}
+
+uint32_t t1CountAt(uint64_t cycle) {
+  if (t1prescale == 0) {
+    return t1countbase;
+  }
+  return t1countbase + (uint32_t)((cycle - t1base)/t1prescale);
+}
+
+uint64_t t1CycleAt(uint32_t count) {
+  return t1base + (uint64_t)(count - t1countbase)*t1prescale;
+}
+
+void t1Rebase() {
+  uint32_t count = t1CountAt(now);
+  t1base      = now;
+  t1countbase = count;
+}
+
+void t1Restart(uint32_t count) {
+  t1base      = now;
+  t1countbase = count;
+  t1topdone   = false;
+  t1compadone = false;
+  t1compbdone = false;
+}
+
+uint64_t t1NextEvent() {
+  if (t1prescale == 0) {
+    return UINT64_MAX;
+  }
+  uint32_t top  = t1Top();
+  uint64_t next = t1CycleAt(t1WrapCount());
+  if (!t1topdone && top >= t1countbase) {
+    uint64_t c = t1CycleAt(top);
+    if (c < next) next = c;
+  }
+  if (!t1compadone && t1ocra >= t1countbase && t1ocra <= top) {
+    uint64_t c = t1CycleAt(t1ocra + 1);
+    if (c < next) next = c;
+  }
+  if (!t1compbdone && t1ocrb >= t1countbase && t1ocrb <= top) {
+    uint64_t c = t1CycleAt(t1ocrb + 1);
+    if (c < next) next = c;
+  }
+  return next;
+}
+
+// Widths go in the trace in ns, timer1 can run faster than 1 count per us
+int32_t t1CountsToNs(uint32_t counts) {
+  uint16_t prescale = t1prescale ? t1prescale : 8;
+  return (int32_t)(((uint64_t)counts*prescale*1000)/SIM_CYCLES_PER_US);
+}
+
+void t1Process() {
+  if (t1prescale == 0) {
+    return;
+  }
+  uint32_t top = t1Top();
+
+  if (!t1compadone && t1ocra >= t1countbase && t1ocra <= top
+      && t1CycleAt(t1ocra + 1) <= now) {
+    t1compadone = true;
+    t1flags |= _BV(OCF1A);
+  }
+  if (!t1compbdone && t1ocrb >= t1countbase && t1ocrb <= top
+      && t1CycleAt(t1ocrb + 1) <= now) {
+    t1compbdone = true;
+    t1flags |= _BV(OCF1B);
+  }
+  if (!t1topdone && top >= t1countbase && t1CycleAt(top) <= now) {
+    t1topdone = true;
+    uint8_t mode = t1Mode();
+    if (mode == 14 || mode == 15 || mode == 0 || mode == 5 || mode == 6
+        || mode == 7) {
+      t1flags |= _BV(TOV1);
+    }
+    if (mode == 12) {
+      t1flags |= _BV(ICF1);
+    }
+    if (mode == 4) {
+      t1flags |= _BV(OCF1A);
+    }
+  }
+  if (t1CycleAt(t1WrapCount()) <= now) {
+    // BOTTOM: start a new frame, latch double-buffered compare registers
+    t1base      = t1CycleAt(t1WrapCount());
+    t1countbase = 0;
+    t1topdone   = false;
+    t1compadone = false;
+    t1compbdone = false;
+    if (t1Buffered()) {
+      t1ocra = OCR1A.value;
+      t1ocrb = OCR1B.value;
+    }
+    trace(EVENT_FRAME, 0, 0);
+    uint16_t newtop = t1Top();
+    if ((TCCR1A.value & _BV(COM1A1)) && (DDRA.value & _BV(PA6))) {
+      trace(EVENT_PULSE_A, 6, t1CountsToNs(t1ocra >= newtop ? newtop + 1
+                                                             : t1ocra + 1));
+    }
+    if ((TCCR1A.value & _BV(COM1B1)) && (DDRA.value & _BV(PA5))) {
+      trace(EVENT_PULSE_B, 5, t1CountsToNs(t1ocrb >= newtop ? newtop + 1
+                                                             : t1ocrb + 1));
+    }
+  }
+}
+
+void onTCCR1(uint8_t) {
+  // Keep the count continuous across mode or prescaler changes
+  t1Rebase();
+  t1prescale = prescaleFromBits(TCCR1B.value);
+  if (!t1Buffered()) {
+    t1ocra = OCR1A.value;
+    t1ocrb = OCR1B.value;
+  }
+}
+
+uint16_t readTCNT1(uint16_t) {
+  return (uint16_t)t1CountAt(now);
+}
+
+void writeTCNT1(uint16_t v) {
+  t1Restart(v);
+}
+
+// Without double buffering a new compare value takes effect at once: it
+// still matches in this frame if the count has not passed it yet. Only a
+// compare value that drives its pin is a pulse width worth tracing, the
+// rest just time interrupts.
+void writeOCR1A(uint16_t v) {
+  if (!t1Buffered()) {
+    t1ocra      = v;
+    t1compadone = v < t1CountAt(now);
+  }
+  if (TCCR1A.value & _BV(COM1A1)) {
+    trace(EVENT_OCR1A, 6, t1CountsToNs((uint32_t)v + 1));
+  }
+}
+
+void writeOCR1B(uint16_t v) {
+  if (!t1Buffered()) {
+    t1ocrb      = v;
+    t1compbdone = v < t1CountAt(now);
+  }
+  if (TCCR1A.value & _BV(COM1B1)) {
+    trace(EVENT_OCR1B, 5, t1CountsToNs((uint32_t)v + 1));
+  }
+}
+
+uint8_t readTIFR1(uint8_t) {
+  return t1flags;
+}
+
+void writeTIFR1(uint8_t v) {
+  // Flags are cleared by writing a logical one
+  t1flags &= ~v;
+}
+
+////////////
+// Timer0 //
+////////////
+
+// The compare match only needs an event of its own when it interrupts; a
+// read of TIFR0 catches the flag up otherwise
+uint64_t t0NextEvent() {
+  uint64_t next = t0start + T0_PERIOD;
+  if (!t0compadone && (TIMSK0.value & _BV(OCIE0A))) {
+    uint64_t c = t0start + ((uint64_t)OCR0A.value + 1)*T0_PRESCALE;
+    if (c < next) next = c;
+  }
+  return next;
+}
+
+void t0Process() {
+  if (!t0compadone
+      && t0start + ((uint64_t)OCR0A.value + 1)*T0_PRESCALE <= now) {
+    t0compadone = true;
+    t0flags |= _BV(OCF0A);
+  }
+  if (t0start + T0_PERIOD <= now) {
+    t0start    += T0_PERIOD;
+    t0compadone = false;
+    t0flags    |= _BV(TOV0);
+  }
+}
+
+uint8_t readTCNT0(uint8_t) {
+  return (uint8_t)((now - t0start)/T0_PRESCALE);
+}
+
+uint8_t readTIFR0(uint8_t) {
+  t0Process();
+  return t0flags;
+}
+
+void writeTIFR0(uint8_t v) {
+  t0flags &= ~v;
+}
+
+void writeOCR0A(uint8_t v) {
+  trace(EVENT_OCR0A, 8, v);
+}
+
+void writeOCR0B(uint8_t v) {
+  trace(EVENT_OCR0B, 7, v);
+}
+
+// The Arduino core's TIMER0_OVF handler behind millis(). At 8 MHz each
+// overflow is 2.048 ms: MILLIS_INC = 2, FRACT_INC = 6, FRACT_MAX = 125.
+void coreTimer0Overflow() {
+  timer0millis += 2;
+  timer0fract  += 6;
+  if (timer0fract >= 125) {
+    timer0fract -= 125;
+    timer0millis++;
+  }
+  timer0overflows++;
+}
+
+///////////
+// Ports //
+///////////
+
+bool outputLevel(uint8_t pin) {
+  if (pin < 8) {
+    return PORTA.value & _BV(pin);
+  }
+  return PORTB.value & _BV(10 - pin);
+}
+
+bool isOutput(uint8_t pin) {
+  if (pin < 8) {
+    return DDRA.value & _BV(pin);
+  }
+  return DDRB.value & _BV(10 - pin);
+}
+
+// A floating input follows DETECT through its 100k resistor
+double floatingLevel() {
+  double target = detectlevel ? 1023.0 : 0.0;
+  double t      = (double)(now - detectchange)/SIM_CYCLES_PER_US;
+  return target + (detectfrom - target)*exp(-t/SIM_DETECT_TAU_US);
+}
+
+double analogTarget(uint8_t channel) {
+  return analogconnected[channel] ? analogvalue[channel] : floatingLevel();
+}
+
+void pinsChanged();
+void usiLinesChanged();
+
+void portChanged() {
+  bool level = outputLevel(0) && isOutput(0);
+  if (level != detectlevel) {
+    detectfrom   = floatingLevel();
+    detectlevel  = level;
+    detectchange = now;
+  }
+  uint8_t a = PORTA.value & DDRA.value;
+  uint8_t b = PORTB.value & DDRB.value;
+  for (uint8_t i = 0; i < 8; i++) {
+    if ((a ^ lastporta) & _BV(i)) {
+      trace(EVENT_PIN, i, (a >> i) & 1);
+    }
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    if ((b ^ lastportb) & _BV(i)) {
+      trace(EVENT_PIN, 10 - i, (b >> i) & 1);
+    }
+  }
+  lastporta = a;
+  lastportb = b;
+  usiLinesChanged();
+  pinsChanged();
+}
+
+void writePort(uint8_t) {
+  portChanged();
+}
+
+uint8_t inputLevels(uint8_t first, uint8_t count) {
+  uint8_t levels = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (simPinLevel(first + i)) {
+      levels |= _BV(i);
+    }
+  }
+  return levels;
+}
+
+uint8_t readPINA(uint8_t) {
+  return inputLevels(0, 8);
+}
+
+uint8_t readPINB(uint8_t) {
+  uint8_t levels = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    if (simPinLevel(10 - i)) {
+      levels |= _BV(i);
+    }
+  }
+  return levels;
+}
+
+// Raise the pin change flags for any enabled pin whose level changed
+void pinsChanged() {
+  uint8_t a = inputLevels(0, 8);
+  uint8_t b = readPINB(0);
+  if ((a ^ pinlevelsa) & PCMSK0.value) {
+    gflags |= _BV(PCIF0);
+  }
+  if ((b ^ pinlevelsb) & PCMSK1.value) {
+    gflags |= _BV(PCIF1);
+  }
+  pinlevelsa = a;
+  pinlevelsb = b;
+}
+
+// Only the I bit of SREG is modelled
+uint8_t readSREG(uint8_t) {
+  return ienabled ? _BV(SREG_I) : 0;
+}
+
+void writeSREG(uint8_t v) {
+  simSetInterrupts(v & _BV(SREG_I));
+}
+
+uint8_t readGIFR(uint8_t) {
+  return gflags;
+}
+
+void writeGIFR(uint8_t v) {
+  // Flags are cleared by writing a logical one
+  gflags &= ~v;
+}
+
+void writePINA(uint8_t v) {
+  // Writing a one to PINx toggles PORTx
+  PORTA.value ^= v;
+  PINA.value   = 0;
+  portChanged();
+}
+
+void writePINB(uint8_t v) {
+  PORTB.value ^= v;
+  PINB.value   = 0;
+  portChanged();
+}
+
+/////////
+// USI //
+/////////
+
+bool usiTwoWire() {
+  return (USICR.value & _BV(USIWM1)) && !(PRR.value & _BV(PRUSI));
+}
+
+// The pins are open drain in two-wire mode: an output pin only ever pulls
+// its line low. SCL is also held low after a start, and after a counter
+// overflow with USIWM0 set, until the flag is cleared.
+bool usiPulls(uint8_t pin) {
+  if (!(DDRA.value & _BV(pin))) {
+    return false;
+  }
+  if (!(PORTA.value & _BV(pin))) {
+    return true;
+  }
+  if (pin == USI_SDA) {
+    return !usilatch;
+  }
+  return usistarthold
+         || ((USICR.value & _BV(USIWM0)) && (usiflags & _BV(USIOIF)));
+}
+
+// Follow the lines until they settle. Start and stop conditions set their
+// flags, and with the external clock the counter takes both SCL edges, the
+// rising one shifting SDA into USIDR. The output latch takes bit 7 as SCL
+// falls.
+void usiLinesChanged() {
+  while (true) {
+    bool scl = simPinLevel(USI_SCL);
+    bool sda = simPinLevel(USI_SDA);
+    if (scl == usiscl && sda == usisda) {
+      break;
+    }
+    if (!usiTwoWire()) {
+      usiscl = scl;
+      usisda = sda;
+      break;
+    }
+    if (sda != usisda) {
+      if (scl && usiscl) {
+        usiflags |= sda ? _BV(USIPF) : _BV(USISIF);
+      }
+      usisda = sda;
+      continue;
+    }
+    usiscl = scl;
+    if (!(USICR.value & _BV(USICS1))) {
+      continue;
+    }
+    if (scl) {
+      USIDR.value = (USIDR.value << 1) | (sda ? 1 : 0);
+    } else {
+      usilatch = USIDR.value & 0x80;
+      if (usiflags & _BV(USISIF)) {
+        usistarthold = true;
+      }
+    }
+    usicount = (usicount + 1) & 0x0F;
+    if (usicount == 0) {
+      usiflags |= _BV(USIOIF);
+    }
+  }
+}
+
+uint8_t readUSISR(uint8_t) {
+  return usiflags | usicount;
+}
+
+// Flags clear by writing a one, the counter is written as is. USIDC is not
+// modelled.
+void writeUSISR(uint8_t v) {
+  usiflags &= ~(v & (_BV(USISIF) | _BV(USIOIF) | _BV(USIPF)));
+  usicount  = v & 0x0F;
+  if (!(usiflags & _BV(USISIF))) {
+    usistarthold = false;
+  }
+  usiLinesChanged();
+}
+
+// With SCL low the latch is open and takes the new bit 7 at once
+void writeUSIDR(uint8_t v) {
+  if (!usiscl) {
+    usilatch = v & 0x80;
+  }
+  usiLinesChanged();
+}
+
+void writeUSICR(uint8_t) {
+  usiLinesChanged();
+}
+
+////////////////
+// I2C Master //
+////////////////
+
+void i2cPush(uint8_t kind, uint8_t arg = 0) {
+  I2COp o = { kind, arg };
+  i2cops.push_back(o);
+}
+
+// One clock pulse, with the master sampling SDA before SCL falls again
+void i2cClock(uint8_t sample = I2C_WAIT, uint8_t arg = 0) {
+  i2cPush(I2C_WAIT);
+  i2cPush(I2C_SCL_RELEASE);
+  i2cPush(I2C_WAIT);
+  if (sample != I2C_WAIT) {
+    i2cPush(sample, arg);
+  }
+  i2cPush(I2C_SCL_LOW);
+}
+
+// A start, or a repeated start with SCL low
+void i2cStart() {
+  i2cPush(I2C_SDA, 1);
+  i2cPush(I2C_WAIT);
+  i2cPush(I2C_SCL_RELEASE);
+  i2cPush(I2C_WAIT);
+  i2cPush(I2C_SDA, 0);
+  i2cPush(I2C_WAIT);
+  i2cPush(I2C_SCL_LOW);
+}
+
+void i2cWrite(uint8_t c) {
+  for (int8_t bit = 7; bit >= 0; bit--) {
+    i2cPush(I2C_SDA, (c >> bit) & 1);
+    i2cClock();
+  }
+  i2cPush(I2C_SDA, 1);
+  i2cClock(I2C_ACK);
+}
+
+void i2cRead(uint8_t index, bool last) {
+  i2cPush(I2C_SDA, 1);
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    i2cClock(I2C_READ, index);
+  }
+  i2cPush(I2C_SDA, last ? 1 : 0);
+  i2cClock();
+}
+
+void i2cStop() {
+  i2cPush(I2C_SDA, 0);
+  i2cClock();
+  i2cPush(I2C_SCL_RELEASE);
+  i2cPush(I2C_WAIT);
+  i2cPush(I2C_SDA, 1);
+  i2cPush(I2C_WAIT);
+}
+
+void i2cDrive(uint8_t pin, bool level) {
+  extlevel[pin] = level;
+  usiLinesChanged();
+  pinsChanged();
+}
+
+void i2cStep(void *);
+
+// Start the next queued transfer, if the master is free
+void i2cNext() {
+  if (i2ccurrent || i2cqueue.empty()) {
+    return;
+  }
+  SimI2CTransfer *t = i2cqueue.front();
+  i2cqueue.pop_front();
+  i2ccurrent = t;
+
+  i2cops.clear();
+  i2cnext = 0;
+  i2cPush(I2C_BUS_FREE);
+  i2cStart();
+  if (t->writes || !t->reads) {
+    i2cWrite(t->address << 1);
+    for (uint8_t i = 0; i < t->writes; i++) {
+      i2cWrite(t->write[i]);
+    }
+    if (t->reads) {
+      i2cStart();
+    }
+  }
+  if (t->reads) {
+    i2cWrite((t->address << 1) | 1);
+    for (uint8_t i = 0; i < t->reads; i++) {
+      i2cRead(i, i + 1 == t->reads);
+    }
+  }
+  i2cStop();
+
+  // Giving up: cut the ops after that many SCL falls and let go of both
+  // lines, SDA first so that it is not a stop
+  if (t->giveup) {
+    uint16_t falls = 0;
+    for (size_t i = 0; i < i2cops.size(); i++) {
+      if (i2cops[i].kind == I2C_SCL_LOW && ++falls == t->giveup) {
+        i2cops.resize(i + 1);
+        i2cPush(I2C_WAIT);
+        i2cPush(I2C_LET_GO);
+        break;
+      }
+    }
+  }
+  simSchedule((t->cycle > now) ? t->cycle : now, i2cStep, 0);
+}
+
+// Carry out the transfer up to the next wait
+void i2cStep(void *) {
+  SimI2CTransfer *t = i2ccurrent;
+  while (i2cnext < i2cops.size()) {
+    const I2COp& o = i2cops[i2cnext];
+    switch (o.kind) {
+    case I2C_SDA:
+      i2cDrive(USI_SDA, o.arg);
+      break;
+    case I2C_SCL_LOW:
+      i2cDrive(USI_SCL, false);
+      break;
+    case I2C_SCL_RELEASE:
+      i2cDrive(USI_SCL, true);
+      if (!simPinLevel(USI_SCL)) {
+        t->stretchcycles += SIM_I2C_POLL;
+        simSchedule(now + SIM_I2C_POLL, i2cStep, 0);
+        return;
+      }
+      break;
+    case I2C_WAIT:
+      i2cnext++;
+      simSchedule(now + t->halfcycles, i2cStep, 0);
+      return;
+    case I2C_ACK:
+      if (!simPinLevel(USI_SDA)) {
+        t->acks++;
+      }
+      break;
+    case I2C_READ:
+      t->read[o.arg] = (t->read[o.arg] << 1) | (simPinLevel(USI_SDA) ? 1 : 0);
+      break;
+    case I2C_BUS_FREE:
+      if (!simPinLevel(USI_SCL) || !simPinLevel(USI_SDA)) {
+        simSchedule(now + SIM_I2C_POLL, i2cStep, 0);
+        return;
+      }
+      break;
+    case I2C_LET_GO:
+      i2cDrive(USI_SDA, true);
+      i2cDrive(USI_SCL, true);
+      break;
+    }
+    i2cnext++;
+  }
+  t->done    = true;
+  t->end     = now;
+  i2ccurrent = 0;
+  i2cNext();
+}
+
+/////////
+// ADC //
+/////////
+
+uint32_t adcPrescale() {
+  static const uint8_t table[8] = { 2, 2, 4, 8, 16, 32, 64, 128 };
+  return table[ADCSRA.value & 0x7];
+}
+
+void adcStart() {
+  // 13 ADC clocks, 25 for the first conversion after enabling. The input is
+  // held 1.5 ADC clocks in; close enough to take it now.
+  uint32_t clocks = adcstarted ? 13 : 25;
+  adcstarted = true;
+  adcbusy    = true;
+  adcdone    = now + clocks*adcPrescale();
+  adcsample  = simAnalogValue(ADMUX.value & 0x7);
+}
+
+void adcProcess() {
+  if (adcbusy && adcdone <= now && adcfault != ADC_FAULT_STALL) {
+    adcbusy   = false;
+    adcflag   = true;
+    ADC.value = (uint16_t)adcsample;
+    if (ADCSRA.value & _BV(ADATE)) {
+      adcStart();
+    }
+  }
+}
+
+uint8_t readADCSRA(uint8_t v) {
+  return (v & ~(_BV(ADSC) | _BV(ADIF)))
+         | (adcbusy ? _BV(ADSC) : 0) | (adcflag ? _BV(ADIF) : 0);
+}
+
+void writeADCSRA(uint8_t v) {
+  // ADIF is cleared by writing a one, ADSC starts a conversion
+  if (v & _BV(ADIF)) {
+    adcflag = false;
+  }
+  ADCSRA.value = v & ~(_BV(ADSC) | _BV(ADIF));
+  if (!(v & _BV(ADEN)) || (PRR.value & _BV(PRADC))) {
+    // Disabled, or its clock is shut off by the power reduction register
+    adcbusy    = false;
+    adcstarted = false;
+  } else if ((v & _BV(ADSC)) && !adcbusy) {
+    adcStart();
+  }
+}
+
+void writePRR(uint8_t v) {
+  // Shutting the ADC down mid-conversion loses the conversion, shutting the
+  // USI lets go of its lines. The timers are not modelled as stopping; the
+  // firmware never shuts them.
+  if (v & _BV(PRADC)) {
+    adcbusy    = false;
+    adcstarted = false;
+  }
+  usiLinesChanged();
+}
+
+//////////////
+// Watchdog //
+//////////////
+
+// WDRF forces the watchdog on, in reset mode, until it is cleared
+bool wdtRunning() {
+  return (wdtcsr & (_BV(WDE) | _BV(WDIE))) || (mcusr & _BV(WDRF));
+}
+
+uint64_t wdtPeriod() {
+  uint8_t wdp = ((wdtcsr >> WDP3) & 1) << 3 | (wdtcsr & 0x7);
+  return ((uint64_t)2048 << wdp)*SIM_CLOCK_FREQ/wdtfreq;
+}
+
+uint64_t wdtNextEvent() {
+  return wdtRunning() ? wdtstart + wdtPeriod() : UINT64_MAX;
+}
+
+void setWDTCSR(uint8_t v) {
+  if (mcusr & _BV(WDRF)) {
+    v |= _BV(WDE);
+  }
+  wdtcsr       = v;
+  WDTCSR.value = v;
+}
+
+// A time-out with WDIE set only raises the interrupt. One that finds the
+// interrupt still waiting, or comes with WDE alone, resets the part.
+void wdtProcess() {
+  while (wdtRunning() && wdtstart + wdtPeriod() <= now) {
+    wdtstart += wdtPeriod();
+    if ((wdtcsr & _BV(WDIE)) && !(wdtcsr & _BV(WDIF))) {
+      setWDTCSR(wdtcsr | _BV(WDIF));
+    } else if (wdtcsr & _BV(WDE)) {
+      SimReset r = { _BV(WDRF) };
+      throw r;
+    }
+  }
+}
+
+void writeWDTCSR(uint8_t v) {
+  bool    wasrunning = wdtRunning();
+  uint8_t control    = _BV(WDE) | _BV(WDP3) | 0x7;
+
+  // WDIF is cleared by writing a one. WDIE can always change and WDE can
+  // always be set, but clearing WDE or changing the prescaler needs WDCE
+  // and WDE written together just before.
+  uint8_t next = (wdtcsr & _BV(WDIF) & ~v) | (v & _BV(WDIE));
+  if (wdtchange) {
+    next |= v & control;
+  } else {
+    next |= (wdtcsr & control) | (v & _BV(WDE));
+  }
+  wdtchange = (v & _BV(WDCE)) && (v & _BV(WDE));
+  setWDTCSR(next);
+  if (!wasrunning && wdtRunning()) {
+    wdtstart = now;
+  }
+}
+
+// Reset flags only clear, by writing a zero
+void writeMCUSR(uint8_t v) {
+  mcusr      &= v;
+  MCUSR.value = mcusr;
+  setWDTCSR(wdtcsr);
+}
+
+////////////////
+// Interrupts //
+////////////////
+
+void wake(uint8_t source) {
+  if (sleeping) {
+    sleeping = false;
+    power.wakes[source]++;
+    simAdvance(COST_WAKE);
+  }
+}
+
+void runIsr(void (*handler)(), uint8_t source) {
+  simOps[OP_ISR]++;
+  ienabled = false;
+  wake(source);
+  handler();
+  simAdvance(COST_ISR);
+  ienabled = true;
+}
+
+// An enabled interrupt without a handler jumps to __bad_interrupt, which
+// resets the part. Count it and carry on.
+void runVector(void (*handler)(), uint8_t source) {
+  if (handler) {
+    runIsr(handler, source);
+  } else {
+    power.unserviced[source]++;
+    wake(source);
+  }
+}
+
+void dispatchInterrupts() {
+  // Vector order is priority order on the ATtiny84
+  while (ienabled) {
+    if ((gflags & _BV(PCIF0)) && (GIMSK.value & _BV(PCIE0))) {
+      gflags &= ~_BV(PCIF0);
+      runVector(PCINT0_vect, WAKE_PCINT0);
+    } else if ((wdtcsr & _BV(WDIF)) && (wdtcsr & _BV(WDIE))) {
+      // Running the vector puts the watchdog back in reset mode
+      uint8_t clear = _BV(WDIF) | ((wdtcsr & _BV(WDE)) ? _BV(WDIE) : 0);
+      setWDTCSR(wdtcsr & ~clear);
+      runVector(WDT_vect, WAKE_WDT);
+    } else if ((t1flags & _BV(OCF1A)) && (TIMSK1.value & _BV(OCIE1A))) {
+      t1flags &= ~_BV(OCF1A);
+      runVector(TIM1_COMPA_vect, WAKE_TIM1_COMPA);
+    } else if ((t1flags & _BV(OCF1B)) && (TIMSK1.value & _BV(OCIE1B))) {
+      t1flags &= ~_BV(OCF1B);
+      runVector(TIM1_COMPB_vect, WAKE_TIM1_COMPB);
+    } else if ((t1flags & _BV(TOV1)) && (TIMSK1.value & _BV(TOIE1))) {
+      t1flags &= ~_BV(TOV1);
+      runVector(TIM1_OVF_vect, WAKE_TIM1_OVF);
+    } else if ((t0flags & _BV(OCF0A)) && (TIMSK0.value & _BV(OCIE0A))) {
+      t0flags &= ~_BV(OCF0A);
+      runVector(TIM0_COMPA_vect, WAKE_TIM0_COMPA);
+    } else if ((t0flags & _BV(TOV0)) && (TIMSK0.value & _BV(TOIE0))) {
+      t0flags &= ~_BV(TOV0);
+      runVector(coreTimer0Overflow, WAKE_TIM0_OVF);
+    } else if (adcflag && (ADCSRA.value & _BV(ADIE))) {
+      adcflag = false;
+      runVector(ADC_vect, WAKE_ADC);
+    } else if ((usiflags & _BV(USISIF)) && (USICR.value & _BV(USISIE))
+               && usiTwoWire()) {
+      // USI flags stay set until the handler clears them
+      runVector(USI_STR_vect, WAKE_USI_STR);
+    } else if ((usiflags & _BV(USIOIF)) && (USICR.value & _BV(USIOIE))
+               && usiTwoWire()) {
+      runVector(USI_OVF_vect, WAKE_USI_OVF);
+    } else {
+      break;
+    }
+  }
+}
+
+uint64_t nextEvent() {
+  uint64_t next = t0NextEvent();
+  uint64_t t1   = t1NextEvent();
+  if (t1 < next) next = t1;
+  if (!scheduled.empty() && scheduled.top().cycle < next) {
+    next = scheduled.top().cycle;
+  }
+  if (adcbusy && adcdone < next && adcfault != ADC_FAULT_STALL) {
+    next = adcdone;
+  }
+  uint64_t wdt = wdtNextEvent();
+  if (wdt < next) next = wdt;
+  return next;
+}
+
+// Move the clock, booking the time as awake or asleep
+void advanceClock(uint64_t to) {
+  uint64_t elapsed = to - now;
+  if (sleeping) {
+    power.sleepcycles += elapsed;
+  } else {
+    power.awakecycles += elapsed;
+  }
+  if ((ADCSRA.value & _BV(ADEN)) && !(PRR.value & _BV(PRADC))) {
+    power.adccycles += elapsed;
+  }
+  now = to;
+}
+
+void processEvents() {
+  t0Process();
+  t1Process();
+  adcProcess();
+  wdtProcess();
+  while (!scheduled.empty() && scheduled.top().cycle <= now) {
+    Scheduled s = scheduled.top();
+    scheduled.pop();
+    s.fn(s.arg);
+  }
+}
+
+} // namespace
+
+////////////////////
+// Virtual Clock  //
+////////////////////
+
+uint64_t simNow() {
+  return now;
+}
+
+double simMicros() {
+  return (double)now/SIM_CYCLES_PER_US;
+}
+
+void simAdvanceTo(uint64_t target) {
+  while (true) {
+    uint64_t next = nextEvent();
+    if (next > target) {
+      break;
+    }
+    if (next > now) {
+      advanceClock(next);
+    }
+    processEvents();
+    dispatchInterrupts();
+  }
+  if (now < target) {
+    advanceClock(target);
+  }
+}
+
+void simAdvance(uint32_t cycles) {
+  simAdvanceTo(now + cycles);
+}
+
+void simCharge(SimOp op, uint32_t cycles) {
+  simOps[op]++;
+  if (cycles && costing) {
+    simAdvance(cycles);
+  }
+}
+
+void simSetCosting(bool enabled) {
+  costing = enabled;
+}
+
+void simSchedule(uint64_t cycle, SimCallback fn, void *arg) {
+  Scheduled s = { cycle, scheduledseq++, fn, arg };
+  scheduled.push(s);
+}
+
+bool simInterruptsEnabled() {
+  return ienabled;
+}
+
+void simSetInterrupts(bool enabled) {
+  ienabled = enabled;
+  if (enabled) {
+    dispatchInterrupts();
+  }
+}
+
+const SimPowerStats& simPowerStats() {
+  return power;
+}
+
+void simSleep() {
+  simOps[OP_SLEEP]++;
+
+  // SLEEP does nothing unless sleep_enable() set SE
+  if (!(MCUCR.value & _BV(SE))) {
+    return;
+  }
+  power.sleeps++;
+
+  // Only idle keeps clk_I/O running. The others would stop the PWM timer
+  // mid-pulse; the simulator keeps the timers going and just counts them.
+  if (MCUCR.value & (_BV(SM1) | _BV(SM0))) {
+    power.clockstops++;
+  }
+
+  // With interrupts off the part never wakes again
+  if (!ienabled) {
+    power.neverwoke++;
+    return;
+  }
+
+  sleeping = true;
+  while (sleeping) {
+    uint64_t next = nextEvent();
+    if (next == UINT64_MAX) {
+      sleeping = false;
+      power.neverwoke++;
+      return;
+    }
+    if (next > now) {
+      advanceClock(next);
+    }
+    processEvents();
+    dispatchInterrupts();
+  }
+}
+
+void simPowerOn() {
+  SimReg8  *regs8[]  = { &TCCR0A, &TCCR0B, &TCNT0, &OCR0A, &OCR0B, &TIMSK0,
+                         &TIFR0, &TCCR1A, &TCCR1B, &TCCR1C, &TIMSK1, &TIFR1,
+                         &PORTA, &DDRA, &PINA, &PORTB, &DDRB, &PINB,
+                         &ADMUX, &ADCSRA, &ADCSRB, &DIDR0,
+                         &GIMSK, &GIFR, &PCMSK0, &PCMSK1, &SREG,
+                         &MCUCR, &PRR, &WDTCSR, &MCUSR,
+                         &USICR, &USISR, &USIDR, &USIBR };
+  SimReg16 *regs16[] = { &TCNT1, &OCR1A, &OCR1B, &ICR1, &ADC };
+  for (size_t i = 0; i < sizeof(regs8)/sizeof(regs8[0]); i++) {
+    *regs8[i] = SimReg8();
+  }
+  for (size_t i = 0; i < sizeof(regs16)/sizeof(regs16[0]); i++) {
+    *regs16[i] = SimReg16();
+  }
+
+  now             = 0;
+  ienabled        = false;
+  costing         = true;
+  sleeping        = false;
+  memset(&power, 0, sizeof(power));
+  mcusr           = resetflags;
+  resetflags      = _BV(PORF);
+  MCUSR.value     = mcusr;
+  wdtchange       = false;
+  wdtstart        = 0;
+  setWDTCSR(0);
+  adcfault        = ADC_FAULT_NONE;
+  scheduled       = std::priority_queue<Scheduled, std::vector<Scheduled>,
+                                        std::greater<Scheduled> >();
+  eeprombusy      = 0;
+  t0start         = 0;
+  t0flags         = 0;
+  t0compadone     = false;
+  timer0millis    = 0;
+  timer0fract     = 0;
+  timer0overflows = 0;
+  t1base          = 0;
+  t1countbase     = 0;
+  t1prescale      = 0;
+  t1ocra          = 0;
+  t1ocrb          = 0;
+  t1flags         = 0;
+  t1topdone       = t1compadone = t1compbdone = false;
+  detectlevel     = false;
+  detectchange    = 0;
+  detectfrom      = 0;
+  lastporta       = lastportb = 0;
+  gflags          = 0;
+  usiflags        = 0;
+  usicount        = 0;
+  usistarthold    = false;
+  usilatch        = true;
+  usiscl          = usisda = true;
+  i2cqueue.clear();
+  i2ccurrent      = 0;
+  adcbusy         = adcflag = adcstarted = false;
+  adcdone         = 0;
+  adcsample       = 0;
+  analognoise     = 0;
+  for (uint8_t i = 0; i < 11; i++) {
+    extlevel[i] = true;
+    grounded[i] = false;
+  }
+  for (uint8_t i = 0; i < 8; i++) {
+    analogvalue[i]     = 0;
+    analogconnected[i] = false;
+  }
+  memset(simOps, 0, sizeof(simOps));
+  simTrace.clear();
+
+  TCCR1A.writehook = onTCCR1;
+  TCCR1B.writehook = onTCCR1;
+  TCNT1.readhook   = readTCNT1;
+  TCNT1.writehook  = writeTCNT1;
+  OCR1A.writehook  = writeOCR1A;
+  OCR1B.writehook  = writeOCR1B;
+  TIFR1.readhook   = readTIFR1;
+  TIFR1.writehook  = writeTIFR1;
+  TCNT0.readhook   = readTCNT0;
+  TIFR0.readhook   = readTIFR0;
+  TIFR0.writehook  = writeTIFR0;
+  OCR0A.writehook  = writeOCR0A;
+  OCR0B.writehook  = writeOCR0B;
+  PORTA.writehook  = writePort;
+  PORTB.writehook  = writePort;
+  DDRA.writehook   = writePort;
+  DDRB.writehook   = writePort;
+  PINA.readhook    = readPINA;
+  PINB.readhook    = readPINB;
+  PINA.writehook   = writePINA;
+  PINB.writehook   = writePINB;
+  ADCSRA.readhook  = readADCSRA;
+  ADCSRA.writehook = writeADCSRA;
+  GIFR.readhook    = readGIFR;
+  GIFR.writehook   = writeGIFR;
+  SREG.readhook    = readSREG;
+  SREG.writehook   = writeSREG;
+  PRR.writehook    = writePRR;
+  WDTCSR.writehook = writeWDTCSR;
+  MCUSR.writehook  = writeMCUSR;
+  USICR.writehook  = writeUSICR;
+  USISR.readhook   = readUSISR;
+  USISR.writehook  = writeUSISR;
+  USIDR.writehook  = writeUSIDR;
+
+  // Arduino core init(): timer0 fast PWM at prescaler 64 with the overflow
+  // interrupt driving millis(), ADC enabled at 125 kHz, then interrupts on
+  TCCR0A.value = _BV(WGM01) | _BV(WGM00);
+  TCCR0B.value = _BV(CS01) | _BV(CS00);
+  TIMSK0.value = _BV(TOIE0);
+  ADCSRA.value = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1);
+  ienabled     = true;
+  pinlevelsa   = inputLevels(0, 8);
+  pinlevelsb   = readPINB(0);
+}
+
+void simSetResetFlags(uint8_t flags) {
+  resetflags = flags;
+}
+
+void simSetWatchdogClock(uint32_t hz) {
+  wdtfreq = hz;
+}
+
+void simWatchdogReset() {
+  wdtstart = now;
+}
+
+///////////////////
+// Outside World //
+///////////////////
+
+void simSetAnalog(uint8_t channel, int value) {
+  analogvalue[channel]     = value;
+  analogconnected[channel] = true;
+  pinsChanged();
+}
+
+void simDisconnectAnalog(uint8_t channel) {
+  analogconnected[channel] = false;
+  pinsChanged();
+}
+
+void simSetADCFault(uint8_t fault) {
+  adcfault = fault;
+}
+
+void simSetAnalogNoise(int lsb) {
+  analognoise = lsb;
+}
+
+int simAnalogValue(uint8_t channel) {
+  double value = analogTarget(channel & 0x7);
+  if (analognoise) {
+    noiseseed = noiseseed*1103515245u + 12345u;
+    value += (int)((noiseseed >> 16) % (2*analognoise + 1)) - analognoise;
+  }
+  int result = (int)(value + 0.5);
+  return constrain(result, 0, 1023);
+}
+
+void simSetDigitalInput(uint8_t pin, bool level) {
+  extlevel[pin] = level;
+  usiLinesChanged();
+  pinsChanged();
+}
+
+void simGroundPin(uint8_t pin, bool ground) {
+  grounded[pin] = ground;
+  usiLinesChanged();
+  pinsChanged();
+}
+
+bool simPinLevel(uint8_t pin) {
+  if (grounded[pin]) {
+    return false;
+  }
+  if ((pin == USI_SCL || pin == USI_SDA) && usiTwoWire()) {
+    return extlevel[pin] && !usiPulls(pin);
+  }
+  if (isOutput(pin)) {
+    return outputLevel(pin);
+  }
+  if (pin < 8 && analogconnected[pin]) {
+    return analogvalue[pin] > 511;
+  }
+  return extlevel[pin];
+}
+
+void simEraseEEPROM() {
+  memset(simEEPROM, 0xff, sizeof(simEEPROM));
+}
+
+namespace {
+// A new part comes erased
+bool eepromerased = (simEraseEEPROM(), true);
+}
+
+void simI2CTransfer(SimI2CTransfer *transfer) {
+  transfer->done          = false;
+  transfer->acks          = 0;
+  transfer->stretchcycles = 0;
+  memset(transfer->read, 0, sizeof(transfer->read));
+  i2cqueue.push_back(transfer);
+  i2cNext();
+}
+
+uint16_t simTimer1Prescale() {
+  return t1prescale;
+}
+
+uint32_t simTimer1FrameCycles() {
+  return ((uint32_t)t1Top() + 1)*t1prescale;
+}
+
+//////////////////
+// Arduino Core //
+//////////////////
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  simCharge(OP_PINMODE, COST_PINMODE);
+  SimReg8& ddr  = (pin < 8) ? DDRA  : DDRB;
+  SimReg8& port = (pin < 8) ? PORTA : PORTB;
+  uint8_t  bit  = (pin < 8) ? pin : 10 - pin;
+  if (mode == OUTPUT) {
+    ddr.value  |= _BV(bit);
+  } else {
+    ddr.value  &= ~_BV(bit);
+    if (mode == INPUT_PULLUP) {
+      port.value |= _BV(bit);
+    } else {
+      port.value &= ~_BV(bit);
+    }
+  }
+  portChanged();
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  simCharge(OP_DIGITALWRITE, COST_DIGITALWRITE);
+  SimReg8& port = (pin < 8) ? PORTA : PORTB;
+  uint8_t  bit  = (pin < 8) ? pin : 10 - pin;
+  if (val == LOW) {
+    port.value &= ~_BV(bit);
+  } else {
+    port.value |= _BV(bit);
+  }
+  portChanged();
+}
+
+int digitalRead(uint8_t pin) {
+  simCharge(OP_DIGITALREAD, COST_DIGITALREAD);
+  return simPinLevel(pin) ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  // Sample is held at the start of the conversion
+  int value = simAnalogValue(pin);
+  simCharge(OP_ANALOGREAD, COST_ANALOGREAD);
+  return value;
+}
+
+uint32_t millis() {
+  simCharge(OP_MILLIS, COST_MILLIS);
+  return timer0millis;
+}
+
+uint32_t micros() {
+  simCharge(OP_MICROS, COST_MICROS);
+  uint32_t overflows = timer0overflows;
+  uint8_t  count     = (uint8_t)((now - t0start)/T0_PRESCALE);
+  if (t0flags & _BV(TOV0)) {
+    overflows++;
+  }
+  return ((overflows << 8) + count)*(T0_PRESCALE/SIM_CYCLES_PER_US);
+}
+
+void delay(uint32_t ms) {
+  simCharge(OP_DELAY, ms*SIM_CYCLES_PER_MS);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simCharge(OP_DELAY, us*SIM_CYCLES_PER_US);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  simCharge(OP_MAP, COST_MAP);
+  return (x - in_min)*(out_max - out_min)/(in_max - in_min) + out_min;
+}
+
+void cli() {
+  simOps[OP_CLI]++;
+  ienabled = false;
+}
+
+void sei() {
+  simOps[OP_SEI]++;
+  simSetInterrupts(true);
+}
+
+////////////
+// EEPROM //
+////////////
+
+// The part programs a byte in the background once started. avr-libc's
+// routines busy-wait for the byte before to finish, interrupts stay enabled.
+
+namespace {
+void waitEEPROM() {
+  if (costing && now < eeprombusy) {
+    simAdvanceTo(eeprombusy);
+  }
+}
+}
+
+bool eeprom_is_ready() {
+  simCharge(OP_REGREAD, 0);
+  return now >= eeprombusy;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+  waitEEPROM();
+  simCharge(OP_EEPROM, COST_EEPROM_READ);
+  return simEEPROM[(uintptr_t)addr % SIM_EEPROM_SIZE];
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    ((uint8_t*)dst)[i] = eeprom_read_byte((const uint8_t*)src + i);
+  }
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+  waitEEPROM();
+  simCharge(OP_EEPROM, COST_EEPROM_START);
+  simEEPROM[(uintptr_t)addr % SIM_EEPROM_SIZE] = value;
+  simEEPROMWrites[(uintptr_t)addr % SIM_EEPROM_SIZE]++;
+  eeprombusy = now + COST_EEPROM_WRITE;
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+  if (eeprom_read_byte(addr) != value) {
+    eeprom_write_byte(addr, value);
+  }
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    eeprom_update_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]);
+  }
+}
@@ -0,0 +1,337 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Hardware
+
+Description: This code builds the Thruster Commander firmware natively on a
+Linux host. It replaces the ATtiny84 registers and the parts of the Arduino
+core used by the firmware with a mock layer driven by a virtual clock, so the
+control path can be profiled and replayed without a boat.
+
+The simulated part runs at 8 MHz. All virtual time is kept in CPU cycles.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef SIMHARDWARE
+#define SIMHARDWARE
+
+#include <stdint.h>
+#include <vector>
+
+#define SIM_CLOCK_FREQ    8000000ul   // Hz
+#define SIM_CYCLES_PER_US 8
+#define SIM_CYCLES_PER_MS 8000
+
+// Approximate ATtiny84 cycle costs of the Arduino core calls we replace.
+// Used to charge virtual time so that loop() takes as long as it would on
+// the real part.
+#define COST_ANALOGREAD   872         // 13 ADC clocks at 125 kHz + setup
+#if BARE_METAL
+// The inline HAL of the bare-metal build instead, with the constant pins the
+// firmware always passes
+#define COST_DIGITALREAD  3           // in, then the bit to a register
+#define COST_DIGITALWRITE 2           // sbi or cbi
+#define COST_PINMODE      4           // sbi or cbi on DDR and PORT
+#define COST_MILLIS       12          // 4 lds with interrupts off
+#define COST_MICROS       36
+#else
+#define COST_DIGITALREAD  52          // pin tables in PROGMEM
+#define COST_DIGITALWRITE 72
+#define COST_PINMODE      72
+#define COST_MILLIS       28
+#define COST_MICROS       44
+#endif
+#define COST_MAP          680         // 32-bit multiply + __divmodsi4
+#define COST_EEPROM_READ  4           // per byte
+#define COST_EEPROM_START 12          // per byte changed, to start it
+#define COST_EEPROM_WRITE 27200       // then 3.4 ms erase+write in the
+                                      //   background
+#define COST_ISR          32          // vector, prologue and epilogue
+#define COST_WAKE         4           // waking from idle before the vector
+#if BARE_METAL
+#define COST_LOOP         5           // rcall and rjmp, nothing else to poll
+#else
+#define COST_LOOP         12          // main() calling loop() again
+#endif
+
+//////////////////////
+// Register Mocking //
+//////////////////////
+
+// A memory-mapped I/O register. Reads and writes go through optional hooks so
+// the timer, ADC and port models can react to the firmware.
+template <typename T>
+class SimRegister {
+public:
+  typedef T    (*ReadHook)(T value);
+  typedef void (*WriteHook)(T value);
+
+  SimRegister() : value(0), readhook(0), writehook(0) {}
+
+  T read() const;
+  void write(T v);
+
+  operator T() const { return read(); }
+  SimRegister& operator=(T v)  { write(v); return *this; }
+  SimRegister& operator=(const SimRegister& r) { write(r.read()); return *this; }
+  SimRegister& operator|=(T v) { write(read() | v); return *this; }
+  SimRegister& operator&=(T v) { write(read() & v); return *this; }
+  SimRegister& operator^=(T v) { write(read() ^ v); return *this; }
+
+  T         value;
+  ReadHook  readhook;
+  WriteHook writehook;
+};
+
+typedef SimRegister<uint8_t>  SimReg8;
+typedef SimRegister<uint16_t> SimReg16;
+
+///////////////////////
+// Operation Counts  //
+///////////////////////
+
+enum SimOp {
+  OP_ANALOGREAD,
+  OP_DIGITALREAD,
+  OP_DIGITALWRITE,
+  OP_PINMODE,
+  OP_MILLIS,
+  OP_MICROS,
+  OP_DELAY,
+  OP_MAP,
+  OP_EEPROM,
+  OP_CLI,
+  OP_SEI,
+  OP_SLEEP,
+  OP_REGREAD,
+  OP_REGWRITE,
+  OP_ISR,
+  OP_COUNT
+};
+
+extern const char *simOpNames[OP_COUNT];
+extern uint32_t    simOps[OP_COUNT];
+
+///////////
+// Trace //
+///////////
+
+enum SimEventKind {
+  EVENT_OCR1A,      // firmware set the OC1A pulse (value: pulse in ns)
+  EVENT_OCR1B,      // firmware set the OC1B pulse (value: pulse in ns)
+  EVENT_OCR0A,      // firmware wrote OCR0A (value: raw register)
+  EVENT_OCR0B,      // firmware wrote OCR0B (value: raw register)
+  EVENT_PULSE_A,    // OC1A pulse started (value: width in ns)
+  EVENT_PULSE_B,    // OC1B pulse started (value: width in ns)
+  EVENT_PIN,        // output pin changed (channel: pin, value: level)
+  EVENT_FRAME       // timer1 reached BOTTOM
+};
+
+struct SimEvent {
+  uint64_t cycle;
+  uint8_t  kind;
+  uint8_t  channel;
+  int32_t  value;
+};
+
+extern std::vector<SimEvent> simTrace;
+extern bool                  simTraceEnabled;
+
+////////////////////
+// Virtual Clock  //
+////////////////////
+
+// Reset every register and the virtual clock to the power-on state, then run
+// the Arduino core's init() equivalent (timer0 at prescaler 64, ADC enabled)
+void     simPowerOn();
+
+uint64_t simNow();                    // cycles since power-on
+double   simMicros();                 // microseconds since power-on
+void     simAdvance(uint32_t cycles); // let virtual time pass
+void     simAdvanceTo(uint64_t cycle);
+void     simCharge(SimOp op, uint32_t cycles);
+
+// With costing off, calls are still counted but take no virtual time
+void     simSetCosting(bool enabled);
+
+// Run fn(arg) at the given cycle, from the event loop (not an interrupt)
+typedef void (*SimCallback)(void *arg);
+void     simSchedule(uint64_t cycle, SimCallback fn, void *arg);
+
+// Interrupt flag (SREG I bit)
+bool     simInterruptsEnabled();
+void     simSetInterrupts(bool enabled);
+
+///////////
+// Power //
+///////////
+
+// Interrupts that can end a sleep, in vector (priority) order
+enum SimWake {
+  WAKE_PCINT0,
+  WAKE_WDT,
+  WAKE_TIM1_COMPA,
+  WAKE_TIM1_COMPB,
+  WAKE_TIM1_OVF,
+  WAKE_TIM0_COMPA,
+  WAKE_TIM0_OVF,
+  WAKE_ADC,
+  WAKE_USI_STR,
+  WAKE_USI_OVF,
+  WAKE_SOURCES
+};
+
+extern const char *simWakeNames[WAKE_SOURCES];
+
+// Where the time went since power-on. Counted whether or not the firmware
+// ever sleeps, so builds with and without sleeping can be compared.
+struct SimPowerStats {
+  uint64_t awakecycles;
+  uint64_t sleepcycles;
+  uint64_t adccycles;                 // ADC enabled and not powered down
+  uint32_t sleeps;
+  uint32_t wakes[WAKE_SOURCES];       // sleeps ended by each interrupt
+  uint32_t unserviced[WAKE_SOURCES];  // enabled with no vector: a reset on
+                                      // the part
+  uint32_t neverwoke;                 // slept with nothing able to wake it
+  uint32_t clockstops;                // slept in a mode that halts clk_I/O
+                                      // and with it both timers
+};
+
+const SimPowerStats& simPowerStats();
+
+// The SLEEP instruction. With SE set in MCUCR, let time pass until an
+// interrupt has run.
+void     simSleep();
+
+//////////////////////////
+// Watchdog and Resets  //
+//////////////////////////
+
+// The watchdog oscillator, nominally 128 kHz, is not trimmed on the part
+#define SIM_WDT_FREQ      128000ul    // Hz
+
+// A reset of the part unwinds out of whatever the firmware was doing as this
+// exception. flags is what MCUSR would read after it.
+struct SimReset {
+  uint8_t flags;
+};
+
+// MCUSR for the next simPowerOn(), power-on reset unless set otherwise
+void     simSetResetFlags(uint8_t flags);
+void     simSetWatchdogClock(uint32_t hz);
+
+// The WDR instruction
+void     simWatchdogReset();
+
+///////////////////
+// Outside World //
+///////////////////
+
+// Analog inputs are on ADC channels 0-7 (PA0-PA7). A connected pot holds its
+// value; a disconnected input floats to the DETECT line through its 100k
+// resistor and settles with the given time constant.
+#define SIM_DETECT_TAU_US 1000
+
+void     simSetAnalog(uint8_t channel, int value);
+void     simDisconnectAnalog(uint8_t channel);
+void     simSetAnalogNoise(int lsb);
+int      simAnalogValue(uint8_t channel);
+
+// Digital inputs driven from outside (switch, etc.)
+void     simSetDigitalInput(uint8_t pin, bool level);
+bool     simPinLevel(uint8_t pin);
+
+// A switch to ground on a pin, which wins over whatever else drives it
+void     simGroundPin(uint8_t pin, bool ground);
+
+// EEPROM keeps its contents across simPowerOn(). It starts out erased.
+// Writes to each byte are counted, for the wear.
+#define SIM_EEPROM_SIZE   512
+extern uint8_t  simEEPROM[SIM_EEPROM_SIZE];
+extern uint32_t simEEPROMWrites[SIM_EEPROM_SIZE];
+void     simEraseEEPROM();
+
+// Faults injected into the ADC: conversions that never complete
+enum SimADCFault {
+  ADC_FAULT_NONE,
+  ADC_FAULT_STALL
+};
+void     simSetADCFault(uint8_t fault);
+
+// An I2C master on the USI pins, SCL on PA4 and SDA on PA6, both pulled up.
+// It waits for both lines to be high to start, clocks each transfer out bit
+// by bit, waiting whenever the target holds SCL low, and carries on through a missing ACK: in a multi-node run each
+// process has just one of the nodes, and a byte this one ignored may be
+// another's. A transfer can be cut short, as by a master that resets. Transfers queue up and each starts no earlier than its cycle.
+#define SIM_I2C_HALF      40          // cycles, half an SCL period at 100 kHz
+#define SIM_I2C_POLL      8           // cycles between looks at a held SCL
+#define SIM_I2C_BYTES     24
+
+struct SimI2CTransfer {
+  uint64_t cycle;                     // when the master starts it
+  uint32_t halfcycles;                // half an SCL period
+  uint8_t  address;                   // 7-bit, 0 for a general call
+  uint8_t  writes;                    // bytes written after the address
+  uint8_t  write[SIM_I2C_BYTES];
+  uint8_t  reads;                     // bytes read after a repeated start
+  uint16_t giveup;                    // 0, or SCL falls before the master
+                                      //   gives up and lets go of the bus
+  // Filled in by the master
+  bool     done;
+  uint8_t  acks;                      // ACK bits seen, addresses included
+  uint8_t  read[SIM_I2C_BYTES];
+  uint64_t end;                       // when the stop condition finished
+  uint32_t stretchcycles;             // time SCL was held low by the target
+};
+
+// Queue a transfer, which must stay put until done. simPowerOn() drops any
+// still queued.
+void     simI2CTransfer(SimI2CTransfer *transfer);
+
+// Timer1 output state
+uint16_t simTimer1Prescale();
+uint32_t simTimer1FrameCycles();
+
+//////////////////////////////
+// Register Implementation  //
+//////////////////////////////
+
+template <typename T>
+T SimRegister<T>::read() const {
+  simCharge(OP_REGREAD, 0);
+  return readhook ? readhook(value) : value;
+}
+
+template <typename T>
+void SimRegister<T>::write(T v) {
+  simCharge(OP_REGWRITE, 0);
+  value = v;
+  if (writehook) {
+    writehook(v);
+  }
+}
+
+#endif
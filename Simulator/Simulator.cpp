@@ -0,0 +1,121 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator
+
+Description: Entry point of the host simulation build. Runs one or all of the
+benchmarks against the firmware compiled for Linux.
+
+Usage: simulator [benchmark|all] [--trace file.csv]
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Harness.h"
+
+
+const char *traceFile  = 0;
+const char *eepromFile = 0;
+
+namespace {
+
+struct Benchmark {
+  const char *name;
+  void      (*run)();
+};
+
+void runBenchmark(const void *arg, void *) {
+  ((const Benchmark*)arg)->run();
+}
+
+const Benchmark benchmarks[] = {
+  { "baseline",  benchBaseline  },
+  { "limiter",   benchLimiter   },
+  { "dshot",     benchDShot     },
+  { "serial",    benchSerial    },
+  { "mapping",   benchMapping   },
+  { "timing",    benchTiming    },
+  { "power",     benchPower     },
+  { "boot",      benchBoot      },
+  { "failsafe",  benchFailsafe  },
+  { "scheduler", benchScheduler },
+  { "bus",       benchBus       },
+  { "tasks",     benchTasks     },
+  { "plant",     benchPlant     },
+  { "mixer",     benchMixer     },
+  { "rc",        benchRC        },
+  { "blackbox",  benchBlackBox  },
+  { "indicator", benchIndicator },
+};
+
+const size_t benchmarkcount = sizeof(benchmarks)/sizeof(benchmarks[0]);
+
+void usage(const char *self) {
+  fprintf(stderr, "usage: %s [benchmark|all] [--trace file.csv] "
+                  "[--eeprom image.bin]\n", self);
+  fprintf(stderr, "benchmarks:");
+  for (size_t i = 0; i < benchmarkcount; i++) {
+    fprintf(stderr, " %s", benchmarks[i].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *name = "all";
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      traceFile = argv[++i];
+    } else if (strcmp(argv[i], "--eeprom") == 0 && i + 1 < argc) {
+      eepromFile = argv[++i];
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      name = argv[i];
+    }
+  }
+
+  bool found = false;
+  for (size_t i = 0; i < benchmarkcount; i++) {
+    if (strcmp(name, benchmarks[i].name) == 0) {
+      benchmarks[i].run();
+      found = true;
+    } else if (strcmp(name, "all") == 0) {
+      // The firmware's globals only start out fresh once per process, so
+      // each benchmark runs in a child of its own as if run by name
+      if (!runInChild(runBenchmark, &benchmarks[i], 0, 0)) {
+        return 1;
+      }
+      found = true;
+    }
+  }
+  if (!found) {
+    usage(argv[0]);
+    return 1;
+  }
+  return checksFailed() ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator EEPROM
+
+Description: Stand-in for avr-libc's <avr/eeprom.h>. Addresses are offsets
+into the simulated EEPROM in Sim-Hardware.cpp, which survives simPowerOn()
+like the real one survives a reset.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef AVR_EEPROM_MOCK
+#define AVR_EEPROM_MOCK
+
+#include <stddef.h>
+#include <stdint.h>
+
+bool    eeprom_is_ready();
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void    eeprom_read_block(void *dst, const void *src, size_t n);
+void    eeprom_write_byte(uint8_t *addr, uint8_t value);
+void    eeprom_update_byte(uint8_t *addr, uint8_t value);
+void    eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,57 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Host Simulator Sleep
+
+Description: Stand-in for avr-libc's <avr/sleep.h>. The mode and enable bits
+live in the simulated MCUCR; sleep_cpu() lets virtual time pass until an
+interrupt runs, see simSleep() in Sim-Hardware.cpp.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef AVR_SLEEP_MOCK
+#define AVR_SLEEP_MOCK
+
+#include <Arduino.h>
+
+#define SLEEP_MODE_IDLE       0
+#define SLEEP_MODE_ADC        _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN   _BV(SM1)
+#define SLEEP_MODE_STANDBY    (_BV(SM1) | _BV(SM0))
+
+#define set_sleep_mode(mode) \
+  (MCUCR = (MCUCR & ~(_BV(SM1) | _BV(SM0))) | (mode))
+#define sleep_enable()        (MCUCR |= _BV(SE))
+#define sleep_disable()       (MCUCR &= ~_BV(SE))
+#define sleep_cpu()           simSleep()
+
+#define sleep_mode()  \
+  do {                \
+    sleep_enable();   \
+    sleep_cpu();      \
+    sleep_disable();  \
+  } while (0)
+
+#endif
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# Stands in for avrdude when testing programCommander.sh without boards.
+#
+# Takes the options programCommander.sh passes and answers like avrdude with
+# an ATtiny84 on a usbtiny. What each programmer (-P port, "default" without
+# one) does is set in STUB_AVRDUDE as port=behaviour pairs:
+#
+#   ok        fuses already set, flash writes and verifies (the default)
+#   blank     fuses at their factory values, so they need writing
+#   mismatch  flash verification fails
+#   timeout   hangs until killed
+#   absent    no programmer at that port
+#
+# A fuse read takes STUB_AVRDUDE_READ seconds and a flash write
+# STUB_AVRDUDE_WRITE seconds.
+
+port="default"
+ops=()
+while [ $# -gt 0 ]; do
+  case "$1" in
+  -P)  port="$2"; shift ;;
+  -P*) port="${1#-P}" ;;
+  -U)  ops+=("$2"); shift ;;
+  -U*) ops+=("${1#-U}") ;;
+  esac
+  shift
+done
+
+behaviour="ok"
+for entry in $STUB_AVRDUDE; do
+  if [ "${entry%=*}" = "$port" ]; then
+    behaviour="${entry##*=}"
+  fi
+done
+
+case $behaviour in
+absent)
+  echo "avrdude: Error: Could not find USBtiny device (0x1781/0xc9f)" >&2
+  exit 1
+  ;;
+timeout)
+  exec sleep 3600
+  ;;
+esac
+
+echo "avrdude: AVR device initialized and ready to accept instructions" >&2
+echo "avrdude: Device signature = 0x1e930c (probably t84)" >&2
+
+declare -A fuses=([lfuse]=0xfe [hfuse]=0xdf [efuse]=0xff)
+if [ "$behaviour" = "blank" ]; then
+  fuses[lfuse]=0x62
+fi
+
+for op in "${ops[@]}"; do
+  IFS=: read memory mode value format <<<"$op"
+  case "$memory:$mode" in
+  *fuse:r)
+    sleep "${STUB_AVRDUDE_READ:-0.2}"
+    echo "${fuses[$memory]}"
+    ;;
+  *fuse:w)
+    fuses[$memory]="$value"
+    echo "avrdude: 1 bytes of $memory written" >&2
+    echo "avrdude: 1 bytes of $memory verified" >&2
+    ;;
+  flash:w)
+    bytes=0
+    while read -r record; do
+      bytes=$((bytes + 16#${record:1:2}))
+    done <"$value"
+    echo "avrdude: erasing chip" >&2
+    sleep "${STUB_AVRDUDE_WRITE:-1}"
+    echo "avrdude: $bytes bytes of flash written" >&2
+    if [ "$behaviour" = "mismatch" ]; then
+      echo "avrdude: verification error, first mismatch at byte 0x0100" >&2
+      echo "         0x3f != 0x2b" >&2
+      echo "avrdude: verification error; content mismatch" >&2
+      exit 1
+    fi
+    echo "avrdude: $bytes bytes of flash verified" >&2
+    ;;
+  esac
+done
+
+echo "avrdude: safemode: Fuses OK (E:${fuses[efuse]}, H:${fuses[hfuse]}," \
+     "L:${fuses[lfuse]})" >&2
+echo "avrdude done.  Thank you." >&2
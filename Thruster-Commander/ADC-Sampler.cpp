@@ -0,0 +1,223 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - ADC Sampler
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "ADC-Sampler.h"
+#include "Thruster-Commander.h"
+
+// The ADC conversion complete interrupt converts the input channels in turn
+// and sums OVERSAMPLE conversions of each. Summing 16 10-bit conversions and
+// dropping 2 bits leaves a 12-bit reading (ADC_SCALE counts per adc count).
+#define OVERSAMPLE    16
+#define DECIMATE      2
+#define MAX_CHANNELS  4
+
+namespace {
+uint8_t           channels[MAX_CHANNELS];   // ADC channel of each slot
+uint8_t           channelcount;
+uint8_t           slot;                     // slot being converted
+uint16_t          accumulator[MAX_CHANNELS];
+uint8_t           samples[MAX_CHANNELS];
+volatile uint16_t reading[MAX_CHANNELS];
+volatile uint8_t  fresh;                    // slots with a reading since restart
+#if FAILSAFE
+volatile uint8_t  readings;                 // counts every reading made
+bool              running;
+uint8_t           lastreadings;             // readings when last checked
+uint32_t          lastprogress;             // millis() when it last moved on
+#endif
+#if TIMING_STATS
+volatile uint16_t stamp[MAX_CHANNELS];      // TCNT1 when reading was made
+#endif
+
+// Find the slot sampling a pin. Aliased pins (INPUT_L and INPUT_SPD) share one.
+uint8_t findSlot(uint8_t pin) {
+  for (uint8_t i = 0; i < channelcount; i++) {
+    if (channels[i] == pin) {
+      return i;
+    }
+  }
+  return MAX_CHANNELS;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Build the channel table and start the first conversion
+void initializeADCSampler() {
+  const uint8_t pins[] = { INPUT_L, INPUT_R, INPUT_SPD, INPUT_STR };
+
+  // Stop interrupts while changing ADC settings
+  cli();
+
+  // Each distinct pin gets one slot; An is ADC channel n
+  channelcount = 0;
+  for (uint8_t i = 0; i < sizeof(pins); i++) {
+    if (findSlot(pins[i]) == MAX_CHANNELS) {
+      channels[channelcount++] = pins[i];
+    }
+  }
+  slot  = 0;
+  fresh = 0;
+#if FAILSAFE
+  running      = true;
+  lastprogress = millis();
+#endif
+
+  // Vcc reference, first channel
+  ADMUX   = channels[0];
+  // Enable ADC and its interrupt, prescaler 64 (125 kHz), start converting
+  ADCSRA  = (1 << ADEN) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1);
+  ADCSRA |= (1 << ADSC);
+
+  // Done setting ADC -> allow interrupts again
+  sei();
+}
+
+// Latest oversampled reading of a pin, 0 to ADC_MAX. Never waits.
+uint16_t readADCSampler(uint8_t pin) {
+  uint8_t i = findSlot(pin);
+  if (i == MAX_CHANNELS) {
+    return 0;
+  }
+
+  // Stop interrupts while reading the 16-bit value
+  cli();
+  uint16_t value = reading[i];
+  sei();
+
+  return value;
+}
+
+// Throw away partial sums, e.g. after driving DETECT, so the next readings
+// only hold conversions taken from now on
+void restartADCSampler() {
+  cli();
+  for (uint8_t i = 0; i < channelcount; i++) {
+    accumulator[i] = 0;
+    samples[i]     = 0;
+  }
+  fresh = 0;
+  sei();
+}
+
+// True once every pin has a reading made only of conversions since restart
+bool adcSamplerReady() {
+  return fresh == (1 << channelcount) - 1;
+}
+
+// Stop converting and shut the ADC's clock off. Readings keep their last
+// values until startADCSampler().
+void stopADCSampler() {
+  cli();
+  ADCSRA = 0;
+  PRR   |= (1 << PRADC);
+  fresh  = 0;
+  sei();
+#if FAILSAFE
+  running = false;
+#endif
+}
+
+// Power the ADC up again and start over from the first pin, with no partial
+// sums left from before it stopped
+void startADCSampler() {
+  PRR &= ~(1 << PRADC);
+  restartADCSampler();
+  initializeADCSampler();
+}
+
+#if FAILSAFE
+// True while running if no new reading has been made for ADC_STALL ms, e.g.
+// a conversion never completed. Call regularly; each call looks at what
+// happened since the one before.
+bool adcSamplerStalled() {
+  uint32_t now = millis();
+  if (!running || readings != lastreadings) {
+    lastreadings = readings;
+    lastprogress = now;
+    return false;
+  }
+  return now - lastprogress > ADC_STALL;
+}
+#endif
+
+#if TIMING_STATS
+// Timer1 count when the pin's latest reading was made
+uint16_t adcSamplerStamp(uint8_t pin) {
+  uint8_t i = findSlot(pin);
+  if (i == MAX_CHANNELS) {
+    return 0;
+  }
+
+  // Stop interrupts while reading the 16-bit value
+  cli();
+  uint16_t value = stamp[i];
+  sei();
+
+  return value;
+}
+#endif
+
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered at the end of every conversion (about 9.6 kHz)
+SIGNAL(ADC_vect) {
+  accumulator[slot] += ADC;
+  if (++samples[slot] >= OVERSAMPLE) {
+    reading[slot]     = accumulator[slot] >> DECIMATE;
+    accumulator[slot] = 0;
+    samples[slot]     = 0;
+    fresh            |= (1 << slot);
+#if FAILSAFE
+    readings++;
+#endif
+#if TIMING_STATS
+    stamp[slot]       = TCNT1;
+#endif
+  }
+
+  // Move on to the next channel and start its conversion
+  if (++slot >= channelcount) {
+    slot = 0;
+  }
+  ADMUX   = channels[slot];
+  ADCSRA |= (1 << ADSC);
+}
@@ -0,0 +1,394 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Black Box Recorder
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Black-Box.h"
+
+#if BLACK_BOX
+
+#include <avr/eeprom.h>
+
+// The update hands recordBlackBox() a sample every pass and it keeps one
+// every BLACK_BOX_DT, delta encoded into a RAM ring. flushBlackBox() runs
+// from the task table and writes at most one byte per run, only once the
+// EEPROM has finished the byte before, so neither ever waits the 3.4 ms a
+// write takes. Blocks are filled in turn and each byte is written about
+// once per lap, which spreads the wear over the whole log.
+#define BOX_ALL         ((1 << BOX_FIELDS) - 1)
+#define NO_BREAK        0xFF
+
+namespace {
+// Encoder
+uint8_t        ring[BLACK_BOX_RING];
+uint8_t        head;                  // oldest byte
+uint8_t        count;
+uint8_t        breakat;               // bytes before the next block starts
+uint16_t       heldsince;             // millis() the ring last filled from
+BlackBoxSample logged;                // values as the log has them
+uint8_t        block;                 // block being filled
+uint8_t        seq;                   // and its sequence number
+uint8_t        blockfill;             // its bytes, the ring's included
+uint16_t       samples;               // since power-up, logged or not
+uint16_t       lastsample;            // millis()
+uint8_t        unchanged;             // samples waiting to go out as a run
+uint8_t        missed;                // samples dropped with the ring full
+bool           poweredup;             // the power-up marker is to go out
+
+// Writer
+uint16_t       writeat;               // log offset of ring[head]
+uint8_t        batch;                 // bytes being written, 0 for none
+uint8_t        commit;                // offset of the batch's first record
+uint8_t        step;
+
+uint8_t nextSeq(uint8_t s) {
+  return (s < BOX_ERASED - 1) ? s + 1 : 0;
+}
+
+// EEPROM is addressed from the start of the log
+uint16_t blockStart(uint8_t b) {
+  return (uint16_t)b*BLACK_BOX_BLOCK;
+}
+
+uint8_t readByte(uint16_t at) {
+  return eeprom_read_byte((const uint8_t*)BLACK_BOX_EEPROM + at);
+}
+
+// Values before a block's first record and after a power-up
+void clearValues(BlackBoxSample *values) {
+  memset(values, 0, sizeof(*values));
+  values->field[BOX_OUT_L] = PWM_NEUTRAL;
+  values->field[BOX_OUT_R] = PWM_NEUTRAL;
+}
+
+uint8_t deltaBytes(int16_t delta) {
+  return (delta >= -64 && delta < 64) ? 1 : 2;
+}
+
+// Bytes of a sample record with the fields in mask, deltas from base
+uint8_t sampleBytes(uint8_t mask, const BlackBoxSample& sample,
+                    const BlackBoxSample& base) {
+  uint8_t bytes = 1;
+  for (uint8_t f = 0; f < BOX_PATTERN; f++) {
+    if (mask & (1 << f)) {
+      bytes += deltaBytes(sample.field[f] - base.field[f]);
+    }
+  }
+  if (mask & (1 << BOX_PATTERN)) {
+    bytes += 2;
+  }
+  if (mask & (1 << BOX_FLAGS)) {
+    bytes += 1;
+  }
+  return bytes;
+}
+
+uint8_t changedFields(const BlackBoxSample& sample) {
+  uint8_t mask = 0;
+  for (uint8_t f = 0; f < BOX_FIELDS; f++) {
+    int16_t delta = sample.field[f] - logged.field[f];
+    if (f <= BOX_OUT_R ? (delta >= BLACK_BOX_STEP
+                          || delta <= -BLACK_BOX_STEP)
+                       : delta != 0) {
+      mask |= 1 << f;
+    }
+  }
+  return mask;
+}
+
+void put(uint8_t value) {
+  uint8_t at = head + count;
+  ring[at < BLACK_BOX_RING ? at : at - BLACK_BOX_RING] = value;
+  count++;
+}
+
+uint8_t ringByte(uint8_t offset) {
+  uint8_t at = head + offset;
+  return ring[at < BLACK_BOX_RING ? at : at - BLACK_BOX_RING];
+}
+
+void putSample(uint8_t mask, const BlackBoxSample& sample) {
+  put(mask);
+  for (uint8_t f = 0; f < BOX_PATTERN; f++) {
+    if (mask & (1 << f)) {
+      int16_t delta = sample.field[f] - logged.field[f];
+      if (deltaBytes(delta) == 1) {
+        put(delta & 0x7F);
+      } else {
+        put(0x80 | ((delta >> 8) & 0x7F));
+        put(delta & 0xFF);
+      }
+    }
+  }
+  if (mask & (1 << BOX_PATTERN)) {
+    put(sample.field[BOX_PATTERN] & 0xFF);
+    put(sample.field[BOX_PATTERN] >> 8);
+  }
+  if (mask & (1 << BOX_FLAGS)) {
+    put(sample.field[BOX_FLAGS]);
+  }
+  for (uint8_t f = 0; f < BOX_FIELDS; f++) {
+    if (mask & (1 << f)) {
+      logged.field[f] = sample.field[f];
+    }
+  }
+}
+
+// Log the run and gap waiting to go out, then the sample: in full at the
+// start of a block or after a power-up, otherwise the fields in mask, or
+// with no fields as the first of the next run. False, with nothing logged,
+// if the ring has no room.
+bool logSample(uint8_t mask, const BlackBoxSample& sample) {
+  uint8_t prefix = (unchanged ? 1 : 0) + (missed ? 2 : 0)
+                   + (poweredup ? 1 : 0);
+  uint8_t need   = prefix + (mask ? sampleBytes(mask, sample, logged) : 0);
+
+  // The block keeps a byte for the end marker after its last record
+  bool fresh = blockfill + need + 1 > BLACK_BOX_BLOCK;
+  if (fresh) {
+    BlackBoxSample zero;
+    clearValues(&zero);
+    mask = BOX_ALL;
+    need = BOX_HEADER + prefix + sampleBytes(mask, sample, zero);
+    if (breakat != NO_BREAK) {
+      return false;
+    }
+  }
+  if (need > BLACK_BOX_RING - count) {
+    return false;
+  }
+
+  if (count == 0) {
+    heldsince = lastsample;
+  }
+  if (fresh) {
+    uint16_t first = samples - unchanged - missed;
+    breakat   = count;
+    block     = (block + 1 < BLACK_BOX_BLOCKS) ? block + 1 : 0;
+    seq       = nextSeq(seq);
+    blockfill = 0;
+    put(seq);
+    put(first & 0xFF);
+    put(first >> 8);
+    clearValues(&logged);
+  }
+  if (unchanged) {
+    put(BOX_RUN + unchanged);
+  }
+  if (missed) {
+    put(BOX_GAP);
+    put(missed);
+  }
+  if (poweredup) {
+    put(BOX_POWER_UP);
+  }
+  if (mask) {
+    putSample(mask, sample);
+  }
+  blockfill += need;
+  unchanged  = mask ? 0 : 1;
+  missed     = 0;
+  poweredup  = false;
+  samples++;
+  return true;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Carry on from where the log left off: after the last record of the
+// newest block, the one the next block does not follow on from, or in the
+// block after it when there is no room left for a full sample
+void initializeBlackBox() {
+  uint8_t newest = NO_BREAK;
+  for (uint8_t b = 0; b < BLACK_BOX_BLOCKS && newest == NO_BREAK; b++) {
+    uint8_t s    = readByte(blockStart(b));
+    uint8_t next = readByte(blockStart((b + 1 < BLACK_BOX_BLOCKS) ? b + 1
+                                                                    : 0));
+    if (s != BOX_ERASED && next != nextSeq(s)) {
+      newest = b;
+    }
+  }
+
+  uint8_t at = BLACK_BOX_BLOCK;
+  if (newest == NO_BREAK) {
+    block = BLACK_BOX_BLOCKS - 1;
+    seq   = BOX_ERASED - 1;
+  } else {
+    uint16_t start = blockStart(newest);
+    block = newest;
+    seq   = readByte(start);
+    at    = BOX_HEADER;
+    while (at < BLACK_BOX_BLOCK) {
+      uint8_t code = readByte(start + at);
+      if (code == BOX_END || code == BOX_ERASED) {
+        break;
+      }
+      if (code == BOX_GAP) {
+        at += 2;
+      } else if (code > BOX_RUN) {
+        at += 1;
+      } else {
+        at += 1;
+        for (uint8_t f = 0; f < BOX_FIELDS; f++) {
+          if (!(code & (1 << f))) {
+            continue;
+          }
+          if (f == BOX_PATTERN) {
+            at += 2;
+          } else if (f == BOX_FLAGS) {
+            at += 1;
+          } else {
+            at += (readByte(start + at) & 0x80) ? 2 : 1;
+          }
+        }
+      }
+    }
+    if (at + 1 + BOX_SAMPLE_MAX + 1 > BLACK_BOX_BLOCK) {
+      at = BLACK_BOX_BLOCK;
+    }
+  }
+  writeat    = blockStart(block) + at;
+  blockfill  = at;
+  head       = 0;
+  count      = 0;
+  breakat    = NO_BREAK;
+  batch      = 0;
+  clearValues(&logged);
+  samples    = 0;
+  unchanged  = 0;
+  missed     = 0;
+  poweredup  = true;
+  lastsample = millis() - BLACK_BOX_DT;
+}
+
+// Keep the update's values every BLACK_BOX_DT. Call from every update.
+void recordBlackBox(const BlackBoxSample& sample) {
+  uint16_t now = millis();
+  if ((uint16_t)(now - lastsample) < BLACK_BOX_DT) {
+    return;
+  }
+  // Stay on the BLACK_BOX_DT grid unless a whole sample was skipped
+  lastsample = ((uint16_t)(now - lastsample) < 2*BLACK_BOX_DT)
+               ? lastsample + BLACK_BOX_DT : now;
+
+  uint8_t mask = poweredup ? BOX_ALL : changedFields(sample);
+  if (!mask && unchanged < BOX_RUN_MAX) {
+    unchanged++;
+    samples++;
+    return;
+  }
+  if (!logSample(mask, sample)) {
+    if (missed < 0xFF) {
+      missed++;
+    }
+    samples++;
+  }
+}
+
+// Write the next byte of the ring to EEPROM, if the one before is done.
+// A batch goes out once BLACK_BOX_BATCH bytes or a new block are waiting,
+// or the oldest has waited BLACK_BOX_HOLD. An end marker goes after it
+// first, and its first record last, so a reset part way through leaves the
+// block ending where it did.
+void flushBlackBox() {
+  if (!eeprom_is_ready()) {
+    return;
+  }
+
+  if (!batch) {
+    // The rest of the ring is for the block started last
+    if (breakat == 0) {
+      writeat = blockStart(block);
+      breakat = NO_BREAK;
+    }
+    if (!count || (breakat == NO_BREAK && count < BLACK_BOX_BATCH
+                   && (uint16_t)(millis() - heldsince) < BLACK_BOX_HOLD)) {
+      return;
+    }
+    batch  = (breakat != NO_BREAK) ? breakat : count;
+    commit = (writeat % BLACK_BOX_BLOCK == 0) ? BOX_HEADER : 0;
+    step   = 0;
+  }
+
+  uint16_t at;
+  uint8_t  value;
+  if (step == 0) {
+    at    = writeat + commit;
+    value = BOX_END;
+  } else if (step == 1) {
+    at    = writeat + batch;
+    value = BOX_END;
+  } else {
+    uint8_t k      = step - 2;
+    uint8_t offset = (k == batch - 1) ? commit : (k < commit ? k : k + 1);
+    at    = writeat + offset;
+    value = ringByte(offset);
+  }
+  eeprom_update_byte((uint8_t*)BLACK_BOX_EEPROM + at, value);
+
+  if (++step < batch + 2) {
+    return;
+  }
+  head += batch;
+  if (head >= BLACK_BOX_RING) {
+    head -= BLACK_BOX_RING;
+  }
+  count   -= batch;
+  writeat += batch;
+  if (breakat != NO_BREAK) {
+    breakat -= batch;
+  }
+  if (count) {
+    heldsince = millis();
+  }
+  batch = 0;
+}
+
+uint16_t blackBoxSamples() {
+  return samples;
+}
+
+uint8_t blackBoxPending() {
+  return count;
+}
+
+const BlackBoxSample& blackBoxLogged() {
+  return logged;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Black Box Recorder
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef BLACKBOX
+#define BLACKBOX
+
+#include <Arduino.h>
+#include "Thruster-Commander.h"
+
+// What is sampled every BLACK_BOX_DT. Inputs are in adc counts (SPD shares
+// L's pin), outputs in us. An input or output is only logged again once it
+// has moved BLACK_BOX_STEP from the value last logged.
+enum BlackBoxField {
+  BOX_INPUT_L,
+  BOX_INPUT_R,
+  BOX_INPUT_STR,
+  BOX_OUT_L,
+  BOX_OUT_R,
+  BOX_PATTERN,              // errorPtrn
+  BOX_FLAGS,                // BOX_ENABLED and the rest
+  BOX_FIELDS
+};
+
+#define BOX_ENABLED     0x01      // SWITCH on
+#define BOX_CLASSIFIED  0x02      // the first detect() cycle is done
+#define BOX_L           0x04      // inputs connected
+#define BOX_R           0x08
+#define BOX_SPD         0x10
+#define BOX_STR         0x20
+
+struct BlackBoxSample {
+  int16_t field[BOX_FIELDS];
+};
+
+// The log in EEPROM, the same on the ATtiny and the host. Each block starts
+// with a sequence number, one more (mod 255) than the block before, and the
+// low 16 bits of the sample count at its first record. Records follow:
+//
+//   0x01-0x7F  a sample, the mask of the fields that changed, then each of
+//              them in field order: a delta from the value before in one
+//              byte (-64 to 63) or two, high first with bit 7 set; the
+//              pattern as two bytes, low first; the flags as one
+//   0x80-0xFB  that many less 0x7F samples that changed nothing
+//   0xFC n     n samples never logged, the RAM ring was full
+//   0xFD       power-up, the sample count starts again at 0
+//   0x00, 0xFF the end of the block's records
+//
+// Values before a block's first record, and after a power-up, count as 0
+// (outputs as PWM_NEUTRAL), so the first sample is logged in full. Writes
+// leave the end marker in place until the records before it are complete.
+#define BOX_HEADER      3         // sequence and sample count
+#define BOX_RUN         0x7F      // code less the samples it stands for
+#define BOX_RUN_MAX     (0xFB - BOX_RUN)
+#define BOX_GAP         0xFC
+#define BOX_POWER_UP    0xFD
+#define BOX_END         0x00
+#define BOX_ERASED      0xFF
+#define BOX_SAMPLE_MAX  (1 + 5*2 + 2 + 1)   // a full sample's bytes
+
+#if BLACK_BOX_EEPROM + BLACK_BOX_BLOCKS*BLACK_BOX_BLOCK > 512
+#error "The black box runs past the ATtiny84's 512 bytes of EEPROM"
+#endif
+
+#if BLACK_BOX
+// Function Declarations
+void     initializeBlackBox();
+void     recordBlackBox(const BlackBoxSample& sample);
+void     flushBlackBox();
+uint16_t blackBoxSamples();
+uint8_t  blackBoxPending();
+const BlackBoxSample& blackBoxLogged();
+#endif
+
+#endif
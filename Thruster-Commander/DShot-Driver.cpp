@@ -0,0 +1,158 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - DShot Driver
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "DShot-Driver.h"
+#include "Thruster-Commander.h"
+
+// Built in only when PWM_PROTOCOL or PWM_PROTOCOL_ALT is DShot150
+#if PWM_DSHOT
+
+// DShot150 bit timing in cpu cycles: a bit every 6.67 us, high for 2.5 us
+// for a 0 and 5 us for a 1
+#define DSHOT_BIT   (CLOCK_FREQ/150000)
+#define DSHOT_T0H   (CLOCK_FREQ/400000)
+#define DSHOT_T1H   (CLOCK_FREQ/200000)
+
+// Output pins, PWM_L and PWM_R are PA5 and PA6
+#define DSHOT_PINS  ((1 << PWM_L) | (1 << PWM_R))
+
+namespace {
+// Port bits of each output pin that stay high past DSHOT_T0H, one byte per
+// bit of the frame, most significant bit first
+uint8_t bits[16];
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Throttle value for a 1000-2000 us command. 0 stops the motor. In 3D mode
+// 48-1047 run in reverse and 1048-2047 ahead, both from slowest to full;
+// otherwise 48-2047 run from slowest to full. The deadzone around neutral
+// (or around PWM_MIN) stops the motor like a PWM ESC's deadband does.
+uint16_t dshotThrottle(int pulsewidth) {
+  pulsewidth = constrain(pulsewidth, PWM_MIN, PWM_MAX);
+
+#if DSHOT_3D
+  if (pulsewidth >= PWM_NEUTRAL + DEADZONE) {
+    return 1047 + 2*(pulsewidth - PWM_NEUTRAL);
+  }
+  if (pulsewidth <= PWM_NEUTRAL - DEADZONE) {
+    return 47 + 2*(PWM_NEUTRAL - pulsewidth);
+  }
+#else
+  if (pulsewidth >= PWM_MIN + DEADZONE) {
+    return 47 + 2*(pulsewidth - PWM_MIN);
+  }
+#endif
+
+  return 0;
+}
+
+// 16-bit frame: 11-bit throttle, telemetry request bit (never set), 4-bit
+// checksum of the other three nibbles
+uint16_t dshotPacket(uint16_t throttle) {
+  uint16_t value = throttle << 1;
+  return (value << 4) | ((value ^ (value >> 4) ^ (value >> 8)) & 0x0F);
+}
+
+// Set the frame sent on an output pin from the next sendDShot() on. Also
+// called from the watchdog interrupt, so leaves the interrupt flag as it was.
+void writeDShot(int pin, uint16_t packet) {
+  uint8_t mask = 1 << pin;     // digital pins 0-7 are PA0-PA7
+
+  // Stop interrupts while changing the frame
+  uint8_t sreg = SREG;
+  cli();
+
+  for (uint8_t i = 0; i < 16; i++) {
+    if (packet & 0x8000) {
+      bits[i] |= mask;
+    } else {
+      bits[i] &= ~mask;
+    }
+    packet <<= 1;
+  }
+
+  // Done changing the frame -> interrupts as they were
+  SREG = sreg;
+}
+
+// Send the frame on both output pins at once. The bit timing comes from
+// counted cycles, so interrupts must be off: call from an ISR only.
+void sendDShot() {
+  uint8_t        low  = PORTA & ~DSHOT_PINS;
+  uint8_t        high = low | DSHOT_PINS;
+  const uint8_t *bit  = bits;
+  uint8_t        n    = 16;
+  uint8_t        mid;
+
+#ifdef __AVR__
+  // Instruction cycles in the comments, t counts from the first out
+  asm volatile(
+    "1:                              \n\t"
+    "out  %[port], %[high]           \n\t"  // 1  t = 0, both high
+    "ld   %[mid], %a[bit]+           \n\t"  // 2
+    "or   %[mid], %[low]             \n\t"  // 1
+    ".rept %[d0]\n\t nop\n\t .endr   \n\t"
+    "out  %[port], %[mid]            \n\t"  // 1  t = DSHOT_T0H, 0 bits low
+    ".rept %[d1]\n\t nop\n\t .endr   \n\t"
+    "out  %[port], %[low]            \n\t"  // 1  t = DSHOT_T1H, both low
+    ".rept %[d2]\n\t nop\n\t .endr   \n\t"
+    "dec  %[n]                       \n\t"  // 1
+    "brne 1b                         \n\t"  // 2  t = DSHOT_BIT
+    : [bit] "+e" (bit), [n] "+r" (n), [mid] "=&r" (mid)
+    : [port] "I" (_SFR_IO_ADDR(PORTA)), [high] "r" (high), [low] "r" (low),
+      [d0] "n" (DSHOT_T0H - 4),
+      [d1] "n" (DSHOT_T1H - DSHOT_T0H - 1),
+      [d2] "n" (DSHOT_BIT - DSHOT_T1H - 4)
+  );
+#else
+  // Same port writes at the same cycle offsets, for the host simulator
+  for (; n; n--) {
+    PORTA = high;
+    mid   = *bit++ | low;
+    __builtin_avr_delay_cycles(DSHOT_T0H);
+    PORTA = mid;
+    __builtin_avr_delay_cycles(DSHOT_T1H - DSHOT_T0H);
+    PORTA = low;
+    __builtin_avr_delay_cycles(DSHOT_BIT - DSHOT_T1H);
+  }
+#endif
+}
+
+#endif
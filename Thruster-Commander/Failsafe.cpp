@@ -0,0 +1,226 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Failsafe
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Failsafe.h"
+
+#if FAILSAFE
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include "Servo-Driver.h"
+
+// The watchdog runs in interrupt and reset mode at its shortest period, 16 ms
+// (2048 cycles of its 128 kHz oscillator), and loop() feeds it every pass.
+// A pass that runs longer gets the interrupt, which forces neutral. The part
+// clears WDIE on the way in, so if loop() still has not fed it by the next
+// time-out, or interrupts were off throughout, the part resets and the
+// outputs stop until setup() sends neutral again. Either way no more than
+// two PWM frames go out with the last command.
+#define WDT_PRESCALE  0               // WDP3:0 for 16 ms
+
+FailsafeRun failsafeRun __attribute__((section(".noinit")));
+
+namespace {
+FailsafeLog   record;                 // the log as it is, or will be, saved
+bool          dirty;                  // record not in EEPROM yet
+volatile bool tripped;
+bool          overdue;                // neutral already forced for this gap
+uint32_t      lasttick;               // millis() of the latest update
+
+uint16_t checkOf(const FailsafeRun& run) {
+  return run.overruns ^ run.trips ^ 0xA5A5;
+}
+
+uint16_t addCounts(uint16_t a, uint16_t b) {
+  return (a > 0xFFFF - b) ? 0xFFFF : a + b;
+}
+
+// Move the counts of this run into the record. Interrupts must be off.
+void collectRun() {
+  if (failsafeRun.overruns || failsafeRun.trips) {
+    record.overruns     = addCounts(record.overruns, failsafeRun.overruns);
+    record.trips        = addCounts(record.trips, failsafeRun.trips);
+    failsafeRun.overruns = 0;
+    failsafeRun.trips    = 0;
+    dirty               = true;
+  }
+  failsafeRun.check = checkOf(failsafeRun);
+}
+
+// Only changed bytes are written, but each takes 3.4 ms, so feed the
+// watchdog as it goes
+void writeRecord() {
+  const uint8_t *src = (const uint8_t*)&record;
+  for (uint8_t i = 0; i < sizeof(record); i++) {
+    eeprom_update_byte((uint8_t*)FAILSAFE_EEPROM + i, src[i]);
+    wdt_reset();
+  }
+  dirty = false;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Start the watchdog and log why the part came out of reset. Call early in
+// setup(): after a watchdog reset the watchdog is already running.
+void initializeFailsafe() {
+  uint8_t cause = MCUSR;
+
+  // Clear the reset flags, WDRF would keep the watchdog in reset mode
+  cli();
+  MCUSR  = 0;
+  wdt_reset();
+  WDTCSR = (1 << WDCE) | (1 << WDE);
+  WDTCSR = (1 << WDIE) | (1 << WDE) | WDT_PRESCALE;
+  sei();
+
+  eeprom_read_block(&record, (const void*)FAILSAFE_EEPROM, sizeof(record));
+  if (record.magic != FAILSAFE_MAGIC) {
+    memset(&record, 0, sizeof(record));
+    record.magic = FAILSAFE_MAGIC;
+  }
+  record.lastcause = cause;
+  if ((cause & (1 << WDRF)) && record.watchdogresets < 0xFF) {
+    record.watchdogresets++;
+  }
+  if ((cause & (1 << BORF)) && record.brownouts < 0xFF) {
+    record.brownouts++;
+  }
+  dirty = true;
+
+  // Counts the run before left behind, unless power was lost since
+  if ((cause & (1 << PORF)) || failsafeRun.check != checkOf(failsafeRun)) {
+    failsafeRun.overruns = 0;
+    failsafeRun.trips    = 0;
+  }
+  cli();
+  collectRun();
+  sei();
+
+  // A reset the part did itself is saved now, while the outputs are still
+  // neutral. A plain power-up waits for saveFailsafeLog().
+  if (cause != (1 << PORF)) {
+    writeRecord();
+  }
+  lasttick = millis();
+}
+
+// Call every loop() pass. Restarts the watchdog, and while updates are
+// ticking forces neutral once the next one is TICK_DEADLINE late. Without
+// ticking, e.g. while updates may slip a frame, the deadline starts over.
+void feedFailsafe(bool ticking) {
+  cli();
+  wdt_reset();
+  WDTCSR = (1 << WDIE) | (1 << WDE) | WDT_PRESCALE;
+  sei();
+
+  uint32_t now = millis();
+  if (!ticking) {
+    lasttick = now;
+    overdue  = false;
+  } else if (!overdue && now - lasttick > TICK_DEADLINE) {
+    forceNeutralPWM();
+    overdue = true;
+    tripped = true;
+  }
+}
+
+// Call at the start of every PWM update, counts an overrun if it is late
+void tickFailsafe() {
+  uint32_t now = millis();
+  if (now - lasttick > TICK_DEADLINE) {
+    cli();
+    failsafeRun.overruns++;
+    failsafeRun.check = checkOf(failsafeRun);
+    sei();
+  }
+  lasttick = now;
+  overdue  = false;
+}
+
+// Force neutral now for a fault found elsewhere, e.g. a stalled sampler,
+// as for a missed deadline
+void tripFailsafe() {
+  forceNeutralPWM();
+  tripped = true;
+}
+
+// True once after the failsafe has forced neutral, so loop() can hold it
+// and start its limiters over from there
+bool failsafeTripped() {
+  cli();
+  bool value = tripped;
+  tripped    = false;
+  sei();
+  return value;
+}
+
+// Write anything new to EEPROM. Can hold up loop() for about 30 ms, so only
+// call this with the outputs idle.
+void saveFailsafeLog() {
+  cli();
+  collectRun();
+  sei();
+  if (dirty) {
+    writeRecord();
+    lasttick = millis();
+  }
+}
+
+// The log as it would be saved now
+void readFailsafeLog(FailsafeLog *log) {
+  cli();
+  *log          = record;
+  log->overruns = addCounts(log->overruns, failsafeRun.overruns);
+  log->trips    = addCounts(log->trips, failsafeRun.trips);
+  sei();
+}
+
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered when a loop() pass outlasts the watchdog period. Neutral goes out
+// from the next frame on; loop() finds out through failsafeTripped().
+SIGNAL(WDT_vect) {
+  forceNeutralPWM();
+  tripped = true;
+  failsafeRun.trips++;
+  failsafeRun.check = checkOf(failsafeRun);
+}
+#endif
@@ -0,0 +1,77 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Failsafe
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef FAILSAFEWATCHDOG
+#define FAILSAFEWATCHDOG
+
+#include <Arduino.h>
+#include "Thruster-Commander.h"
+
+// What goes to EEPROM at FAILSAFE_EEPROM, the same layout on the ATtiny and
+// the host. Counters stop at their largest value.
+#define FAILSAFE_MAGIC  0x46
+struct FailsafeLog {
+  uint8_t  magic;
+  uint8_t  lastcause;       // MCUSR at the latest start-up
+  uint8_t  watchdogresets;
+  uint8_t  brownouts;
+  uint16_t overruns;        // updates more than TICK_DEADLINE apart
+  uint16_t trips;           // times the watchdog interrupt forced neutral
+};
+
+// Counts not in EEPROM yet. Kept where the startup code does not clear them,
+// so they outlive a watchdog reset; check tells them from power-up garbage.
+struct FailsafeRun {
+  uint16_t overruns;
+  uint16_t trips;
+  uint16_t check;
+};
+
+#if FAILSAFE
+extern FailsafeRun failsafeRun;
+
+// Function Declarations
+void initializeFailsafe();
+void feedFailsafe(bool ticking);
+void tickFailsafe();
+void tripFailsafe();
+bool failsafeTripped();
+void saveFailsafeLog();
+void readFailsafeLog(FailsafeLog *log);
+#endif
+
+#endif
@@ -0,0 +1,306 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - I2C Target
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "I2C-Target.h"
+#include "Thruster-Commander.h"
+#include "Servo-Driver.h"
+#include "Timing-Stats.h"
+#include "Failsafe.h"
+
+#if I2C_TARGET
+
+#include <avr/eeprom.h>
+
+// Two-wire mode of the USI, after Atmel's AVR312. The start interrupt arms
+// the counter for the address byte, the overflow interrupt takes each byte
+// and ACK bit in turn. SCL is held low from every overflow until its
+// interrupt has run, so a late interrupt stretches the clock instead of
+// losing bits, and loop() never waits on the bus.
+#define USI_SCL       PA4             // fixed by the USI, the SWITCH pin
+#define USI_SDA       PA6
+
+// USISR values: clear every flag but a new start, then count 8 bits or 1
+#define USISR_BYTE    ((1 << USIOIF) | (1 << USIPF) | (1 << USIDC))
+#define USISR_BIT     (USISR_BYTE | (0x0E << USICNT0))
+
+// One pass of the wait for the end of a start condition, on the part, and
+// the most passes: 125 us, over ten SCL periods at 100 kHz
+#define SPIN_CYCLES   5
+#define START_SPINS   200
+
+namespace {
+enum { STATE_ADDRESS, STATE_SEND, STATE_SEND_ACK, STATE_CHECK_ACK,
+       STATE_RECEIVE, STATE_GET };
+
+uint8_t           address;                // own 7-bit address
+volatile uint8_t  state;
+volatile bool     inflight;               // a transfer started, not dropped
+volatile uint8_t  busevents;              // USI interrupts, for checkI2CBus()
+uint8_t           lastevents;
+uint32_t          lastprogress;
+bool              generalcall;            // this transfer was to address 0
+bool              pointed;                // first write byte set the pointer
+uint8_t           pointer;
+
+// regs is what the master reads and writes. A read transfer goes out from a
+// copy taken at its address, so 16-bit values never tear.
+volatile uint8_t  regs[I2C_REGISTERS];
+uint8_t           sent[I2C_REGISTERS];
+
+// Command taken at the latest sync, for readI2CCommand()
+volatile bool     synced;
+volatile bool     syncarmed;
+volatile int      syncleft, syncright;
+volatile uint16_t syncs;
+
+void putWord(uint8_t reg, uint16_t value) {
+  regs[reg]     = value & 0xFF;
+  regs[reg + 1] = value >> 8;
+}
+
+uint16_t getWord(uint8_t reg) {
+  return regs[reg] | (regs[reg + 1] << 8);
+}
+
+// Let go of SDA, and of SCL if the USI holds it, and wait for the next
+// start condition
+void listen() {
+  DDRA &= ~(1 << USI_SDA);
+  USICR = (1 << USISIE) | (1 << USIWM1) | (1 << USICS1);
+  USISR = USISR_BYTE;
+  inflight = false;
+}
+
+// Pull SDA low through the next bit
+void acknowledge() {
+  USIDR = 0;
+  DDRA |= (1 << USI_SDA);
+  USISR = USISR_BIT;
+}
+
+// A written byte: the pointer, then data for ARM and COMMAND only. A general
+// call only ever means a sync.
+void takeByte(uint8_t c) {
+  if (generalcall) {
+    if (c == I2C_SYNC) {
+      syncarmed = regs[I2C_REG_ARM] & 1;
+      syncleft  = getWord(I2C_REG_COMMAND);
+      syncright = getWord(I2C_REG_COMMAND + 2);
+      synced    = true;
+      putWord(I2C_REG_SYNCS, ++syncs);
+      syncPWMFrame();
+    }
+    return;
+  }
+  if (!pointed) {
+    pointer = (c < I2C_REGISTERS) ? c : 0;
+    pointed = true;
+    return;
+  }
+  if (pointer >= I2C_REG_ARM && pointer < I2C_REG_OUTPUT) {
+    regs[pointer] = c;
+  }
+  pointer = (pointer + 1 < I2C_REGISTERS) ? pointer + 1 : 0;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Listen on the bus at the address in EEPROM at I2C_EEPROM, or I2C_ADDRESS
+// if it holds none
+void initializeI2CTarget() {
+  address = eeprom_read_byte((const uint8_t*)I2C_EEPROM);
+  if (address < 0x08 || address > 0x77) {
+    address = I2C_ADDRESS;
+  }
+
+  // Stop interrupts while changing USI settings
+  cli();
+
+  // Both lines released; SCL is an output so the USI can hold it low
+  PORTA |= (1 << USI_SCL) | (1 << USI_SDA);
+  DDRA  |= (1 << USI_SCL);
+  putWord(I2C_REG_COMMAND, PWM_NEUTRAL);
+  putWord(I2C_REG_COMMAND + 2, PWM_NEUTRAL);
+  listen();
+
+  // Done setting interrupts -> allow interrupts again
+  sei();
+}
+
+// True once per sync, with the command it made current
+bool readI2CCommand(I2CCommand *command) {
+  cli();
+  bool fresh = synced;
+  if (fresh) {
+    command->syncs = syncs;
+    command->armed = syncarmed;
+    command->left  = syncleft;
+    command->right = syncright;
+    synced         = false;
+  }
+  sei();
+  return fresh;
+}
+
+// Publish the state of the latest update, called once per update
+void updateI2CRegisters(uint8_t status, int left, int right) {
+  cli();
+  regs[I2C_REG_STATUS] = status;
+  putWord(I2C_REG_OUTPUT, left);
+  putWord(I2C_REG_OUTPUT + 2, right);
+  putWord(I2C_REG_FRAMES, getWord(I2C_REG_FRAMES) + 1);
+#if FAILSAFE
+  putWord(I2C_REG_OVERRUNS, failsafeRun.overruns);
+#endif
+#if TIMING_STATS
+  putWord(I2C_REG_UPDATE, timingMax(TIMING_UPDATE));
+  putWord(I2C_REG_LATENCY, timingMax(TIMING_LATENCY));
+#endif
+  sei();
+}
+
+// Call every update. A transfer that has stopped mid-way for
+// I2C_BUS_TIMEOUT, with SCL grounded by the switch or the master gone, is
+// dropped. The target may be holding SDA low for an ACK or a 0 bit, which
+// would keep the master from sending another start.
+void checkI2CBus() {
+  uint32_t now = millis();
+  cli();
+  if (!inflight || busevents != lastevents) {
+    lastevents   = busevents;
+    lastprogress = now;
+  } else if (now - lastprogress > I2C_BUS_TIMEOUT) {
+    listen();
+  }
+  sei();
+}
+
+////////////////////////////////
+// Interrupt Service Routines //
+////////////////////////////////
+
+// Triggered by a start condition. The USI holds SCL low once the master
+// pulls it low, until USISIF is cleared.
+SIGNAL(USI_STR_vect) {
+  state = STATE_ADDRESS;
+  DDRA &= ~(1 << USI_SDA);
+  busevents++;
+
+  // The start is over when SCL goes low, unless a stop comes first. Lines
+  // stuck past START_SPINS are left to the next start.
+  uint8_t spins = START_SPINS;
+  while ((PINA & (1 << USI_SCL)) && !(PINA & (1 << USI_SDA)) && --spins) {
+#ifndef __AVR__
+    // Register reads take no time on the host
+    __builtin_avr_delay_cycles(SPIN_CYCLES);
+#endif
+  }
+  if (PINA & (1 << USI_SCL)) {
+    // Back to waiting for a start
+    USICR = (1 << USISIE) | (1 << USIWM1) | (1 << USICS1);
+  } else {
+    // Count the address byte, holding SCL after it
+    USICR = (1 << USISIE) | (1 << USIOIE) | (1 << USIWM1) | (1 << USIWM0)
+            | (1 << USICS1);
+    inflight = true;
+  }
+  USISR = (1 << USISIF) | USISR_BYTE;
+}
+
+// Triggered once the counter has clocked in or out a byte or an ACK bit
+SIGNAL(USI_OVF_vect) {
+  busevents++;
+  switch (state) {
+  case STATE_ADDRESS: {
+    uint8_t c = USIDR;
+    if (c != 0 && (c >> 1) != address) {
+      listen();
+      break;
+    }
+    generalcall = (c == 0);
+    if (c & 1) {
+      memcpy(sent, (const uint8_t*)regs, sizeof(sent));
+      state = STATE_SEND;
+    } else {
+      pointed = false;
+      state   = STATE_RECEIVE;
+    }
+    acknowledge();
+    break;
+  }
+
+  case STATE_CHECK_ACK:
+    // No ACK from the master ends the read
+    if (USIDR) {
+      listen();
+      break;
+    }
+    // fall through
+  case STATE_SEND:
+    USIDR   = sent[pointer];
+    pointer = (pointer + 1 < I2C_REGISTERS) ? pointer + 1 : 0;
+    DDRA   |= (1 << USI_SDA);
+    USISR   = USISR_BYTE;
+    state   = STATE_SEND_ACK;
+    break;
+
+  case STATE_SEND_ACK:
+    // Let go of SDA for the master's ACK
+    USIDR   = 0;
+    DDRA   &= ~(1 << USI_SDA);
+    USISR   = USISR_BIT;
+    state   = STATE_CHECK_ACK;
+    break;
+
+  case STATE_RECEIVE:
+    DDRA   &= ~(1 << USI_SDA);
+    USISR   = USISR_BYTE;
+    state   = STATE_GET;
+    break;
+
+  case STATE_GET:
+    takeByte(USIDR);
+    acknowledge();
+    state   = STATE_RECEIVE;
+    break;
+  }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - I2C Target
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef I2CTARGET
+#define I2CTARGET
+
+#include <Arduino.h>
+
+// Register map. 16-bit values are little endian. A write transfer sets the
+// register pointer with its first byte and writes from there, a read starts
+// at the pointer; both move on one register per byte and wrap at the end.
+//   0x00  STATUS    r   I2C_STATUS_ bits
+//   0x01  ARM       rw  1 armed, taken at the next sync
+//   0x02  COMMAND   rw  left and right commands, us, taken at the next sync
+//   0x06  OUTPUT    r   left and right pulses of the latest update, us
+//   0x0A  FRAMES    r   updates since power-up
+//   0x0C  SYNCS     r   syncs taken since power-up
+//   0x0E  OVERRUNS  r   late updates, with FAILSAFE
+//   0x10  UPDATE    r   longest update, Timer1 ticks, with TIMING_STATS
+//   0x12  LATENCY   r   longest input to writePWM(), likewise
+// A general call (address 0) of I2C_SYNC has every target take its ARM and
+// COMMAND registers at once and start a PWM frame I2C_SYNC_LEAD after it.
+#define I2C_REG_STATUS    0x00
+#define I2C_REG_ARM       0x01
+#define I2C_REG_COMMAND   0x02
+#define I2C_REG_OUTPUT    0x06
+#define I2C_REG_FRAMES    0x0A
+#define I2C_REG_SYNCS     0x0C
+#define I2C_REG_OVERRUNS  0x0E
+#define I2C_REG_UPDATE    0x10
+#define I2C_REG_LATENCY   0x12
+#define I2C_REGISTERS     0x14
+
+#define I2C_STATUS_ARMED      0x01
+#define I2C_STATUS_CLASSIFIED 0x02    // first detect cycle done
+#define I2C_STATUS_L          0x04    // inputs found connected
+#define I2C_STATUS_R          0x08
+#define I2C_STATUS_SPD        0x10
+#define I2C_STATUS_STR        0x20
+#define I2C_STATUS_FAULT      0x40    // held at neutral by a timeout or fault
+
+struct I2CCommand {
+  uint16_t syncs;
+  bool     armed;
+  int      left;        // us
+  int      right;       // us
+};
+
+// Function Declarations
+void initializeI2CTarget();
+bool readI2CCommand(I2CCommand *command);
+void updateI2CRegisters(uint8_t status, int left, int right);
+void checkI2CBus();
+
+#endif
@@ -37,11 +37,55 @@ THE SOFTWARE.
 
 #include "Indicator.h"
 #include "Thruster-Commander.h"
+#include "Mapping.h"
+#include "Timing-Stats.h"
+
+// Timer0 compare interrupts per pattern bit, so a 16 bit pattern takes 2 s
+#define BLINK_TICKS   (2*(F_CPU/64/256)/16)
 
 namespace {
-uint16_t  pattern;
-uint8_t   patternindex;
-bool      blinking;
+// Per LED blink state. The interrupt shifts one bit of the pattern out per
+// BLINK_TICKS and starts over from the stored pattern after 16 bits, so it
+// never has to index into the pattern or look up pins.
+struct Blinker {
+  uint16_t  pattern;      // pattern being shown, bit 0 first
+  uint16_t  shift;        // rest of the pattern this time around
+  uint8_t   remaining;    // bits left in shift
+  bool      blinking;     // false while the timer dims the LED
+};
+
+Blinker   blinkers[2];    // 0: OC0A (LED_L), 1: OC0B (LED_R)
+
+// Timer0 output compare bits for each LED
+const uint8_t commask[2] = { _BV(COM0A0) | _BV(COM0A1),
+                             _BV(COM0B0) | _BV(COM0B1) };
+
+Blinker *blinkerFor(int pin) {
+  return (pin == OC0A_PIN) ? &blinkers[0] : &blinkers[1];
+}
+
+// Hand one LED to the timer (dimming) or to the interrupt (blinking)
+void setCompareOutput(uint8_t channel, bool enabled) {
+  // Stop interrupts while changing timer settings
+  cli();
+
+  if (enabled) {
+    // Inverting Fast PWM mode
+    TCCR0A |= commask[channel];
+  } else {
+    TCCR0A &= ~commask[channel];
+  }
+  blinkers[channel].blinking = !enabled;
+
+  // Done setting timers -> allow interrupts again
+  sei();
+}
+
+// Start a pattern over from its first bit
+void restartPattern(Blinker *b) {
+  b->shift     = b->pattern;
+  b->remaining = 16;
+}
 }
 
 ///////////////
@@ -58,8 +102,9 @@ void initializeLEDs() {
   bitSet(TCCR0A, WGM01);
 
   // Start initialized for blinking
+  restartPattern(&blinkers[0]);
+  restartPattern(&blinkers[1]);
   setBlinkerBits();
-  blinking = true;
 
   // Enable timer0 OCR0A compare interrupt (for blinking)
   bitSet(TIMSK0, OCIE0A);
@@ -67,20 +112,20 @@ void initializeLEDs() {
 
 // Set dimmer value
 void writeDimmer(int pin, int pwm) {
+  Blinker *b       = blinkerFor(pin);
+  uint8_t  channel = b - blinkers;
+
   // Check whether we were previously in Blinker mode
-  if (blinking) {
-    // Stop blinking
-    blinking = false;
-    // Set up for dimming mode
-    setDimmerBits();
+  if (b->blinking) {
+    // Stop blinking, set up for dimming mode
+    setCompareOutput(channel, true);
   }
 
+  uint8_t period = mapDimmer(pwm);   // 255 is off (inverting mode)
+
   // Stop interrupts while changing pwm settings
   cli();
 
-  uint8_t period = constrain(map(abs(pwm - PWM_NEUTRAL), DEADZONE, HALF_RANGE,
-                                 255, 0), 0, 255);   // 255 is off (inverting mode)
-
   if (pin == OC0A_PIN) {
     // Set timer0 Output Compare Register A
     // Set shut-off counter value to get pulsewidth us pulse
@@ -96,55 +141,49 @@ void writeDimmer(int pin, int pwm) {
   sei();
 }
 
-// Set blink pattern
+// Set blink pattern on both LEDs
 void writeBlinker(uint16_t ptrn) {
+  writeBlinker(OC0A_PIN, ptrn);
+  writeBlinker(OC0B_PIN, ptrn);
+}
+
+// Set blink pattern on one LED
+void writeBlinker(int pin, uint16_t ptrn) {
+  Blinker *b       = blinkerFor(pin);
+  uint8_t  channel = b - blinkers;
+  bool     restart = false;
+
   // Check whether we were previously in Blinker mode
-  if (!blinking) {
+  if (!b->blinking) {
     // Start blinking
-    blinking = true;
-    // Set up for dimming mode
-    setBlinkerBits();
-    // Reset pattern index
-    patternindex = 0;
+    setCompareOutput(channel, false);
+    restart = true;
+  }
+
+  // If pattern is different, start the new one from its first bit
+  if (ptrn != b->pattern) {
+    restart = true;
   }
 
-  // If pattern is different, reset index, save new pattern
-  if (ptrn != pattern) {
-    // Reset pattern index
-    patternindex = 0;
-    // Save new pattern
-    pattern = ptrn;
+  if (restart) {
+    // The interrupt shifts these, keep it out while they change
+    cli();
+    b->pattern = ptrn;
+    restartPattern(b);
+    sei();
   }
 }
 
-// Switch to dimmer mode by setting register bits
+// Switch both LEDs to dimmer mode by setting register bits
 void setDimmerBits() {
-  // Stop interrupts while changing timer settings
-  cli();
-
-  // Set inverting Fast PWM mode on A and B
-  bitSet(TCCR0A, COM0A0);
-  bitSet(TCCR0A, COM0A1);
-  bitSet(TCCR0A, COM0B0);
-  bitSet(TCCR0A, COM0B1);
-
-  // Done setting timers -> allow interrupts again
-  sei();
+  setCompareOutput(0, true);
+  setCompareOutput(1, true);
 }
 
-// Switch to blinker mode by setting register bits
+// Switch both LEDs to blinker mode by setting register bits
 void setBlinkerBits() {
-  // Stop interrupts while changing timer settings
-  cli();
-
-  // Disable inverting Fast PWM mode on A and B
-  bitClear(TCCR0A, COM0A0);
-  bitClear(TCCR0A, COM0A1);
-  bitClear(TCCR0A, COM0B0);
-  bitClear(TCCR0A, COM0B1);
-
-  // Done setting timers -> allow interrupts again
-  sei();
+  setCompareOutput(0, false);
+  setCompareOutput(1, false);
 }
 
 ///////////////////////////////
@@ -152,22 +191,42 @@ void setBlinkerBits() {
 ///////////////////////////////
 
 namespace {
-uint16_t  isrcounter;
+uint8_t   isrcounter;
+
+// Next bit of an LED's pattern
+inline bool nextBit(Blinker *b) {
+  bool on = b->shift & 1;
+  b->shift >>= 1;
+  if (--b->remaining == 0) {
+    restartPattern(b);
+  }
+  return on;
+}
 }
 
-// Triggered every time OCR0A matches TIMER0 counter (488 Hz)
+// Triggered every time OCR0A matches TIMER0 counter (488 Hz). Only touches
+// the LED port bits, never Timer0 itself, which millis() depends on.
 SIGNAL(TIM0_COMPA_vect) {
-  isrcounter++;
-  if (isrcounter >= 2*(F_CPU/64/256)/16) {
+  TIMING_START(isrstart);
+
+  if (++isrcounter >= BLINK_TICKS) {
     isrcounter = 0;
-    if (blinking) {
-      digitalWrite(OC0A_PIN, bitRead(pattern, patternindex));
-      digitalWrite(OC0B_PIN, bitRead(pattern, patternindex));
-      if (patternindex < 15) {
-        patternindex++;
+
+    if (blinkers[0].blinking) {
+      if (nextBit(&blinkers[0])) {
+        OC0A_PORT |= _BV(OC0A_BIT);
       } else {
-        patternindex = 0;
+        OC0A_PORT &= ~_BV(OC0A_BIT);
+      }
+    }
+    if (blinkers[1].blinking) {
+      if (nextBit(&blinkers[1])) {
+        OC0B_PORT |= _BV(OC0B_BIT);
+      } else {
+        OC0B_PORT &= ~_BV(OC0B_BIT);
       }
     }
   }
+
+  TIMING_STOP(TIMING_INDICATOR, isrstart);
 }
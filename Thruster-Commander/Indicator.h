@@ -40,8 +40,12 @@ THE SOFTWARE.
 
 #include <Arduino.h>
 
-#define OC0A_PIN  8
-#define OC0B_PIN  7
+#define OC0A_PIN  8         // LED_L
+#define OC0B_PIN  7         // LED_R
+#define OC0A_PORT PORTB     // port and bit of each pin, for the interrupt
+#define OC0A_BIT  PB2
+#define OC0B_PORT PORTA
+#define OC0B_BIT  PA7
 
 #define BLINK_1S  0b00000001  // 1 short blink
 #define BLINK_2S  0b00000101  // 2 short blinks
@@ -56,6 +60,7 @@ THE SOFTWARE.
 void initializeLEDs();
 void writeDimmer(int pin, int pulsewidth);
 void writeBlinker(uint16_t ptrn);
+void writeBlinker(int pin, uint16_t ptrn);
 void setDimmerBits();
 void setBlinkerBits();
 
@@ -40,6 +40,9 @@ THE SOFTWARE.
 // DEFAULT VALUES
 #define DEFAULT_MAX_ACCEL 50      // us/s
 
+// Largest change step() can ever need: the whole int range, in us << 8
+#define FULL_RANGE        0x1000000L
+
 //////////////////
 // Constructors //
 //////////////////
@@ -47,14 +50,16 @@ THE SOFTWARE.
 // Default Constructor
 Limiter::Limiter() {
   this->_lastoutput   = 0;
-  this->_maxaccel     = DEFAULT_MAX_ACCEL;
+  this->_rate         = (((uint32_t)DEFAULT_MAX_ACCEL << 16) + 500)/1000;
+  this->_maxdt        = 0xFFFFFFFFul/this->_rate;
   this->_lastruntime  = millis();
 }
 
 // Useful Constructor
-Limiter::Limiter(float maxaccel, float startvalue) {
-  this->_lastoutput   = startvalue;
-  this->_maxaccel     = maxaccel;
+Limiter::Limiter(uint16_t maxaccel, int startvalue) {
+  this->_lastoutput   = (int32_t)startvalue << 8;
+  this->_rate         = (((uint32_t)maxaccel << 16) + 500)/1000;
+  this->_maxdt        = this->_rate ? 0xFFFFFFFFul/this->_rate : 0xFFFFFFFFul;
   this->_lastruntime  = millis();
 }
 
@@ -67,20 +72,34 @@ Limiter::~Limiter() {} // Nothing to destruct
 ////////////////////
 
 // Move filter along one timestep, return filtered output
-float Limiter::step(float input) {
+int Limiter::step(int input) {
   // Measure elapsed time
-  float dt  = (millis() - this->_lastruntime)/1000.0f;
-  this->_lastruntime = millis();
+  uint32_t now = millis();
+  uint32_t dt  = now - this->_lastruntime;
+  this->_lastruntime = now;
 
-  // Calculate maximum/minimum allowable values this round
-  float max = this->_lastoutput + dt*(this->_maxaccel);
-  float min = this->_lastoutput - dt*(this->_maxaccel);
+  // Calculate maximum allowable change this round. Past _maxdt, dt*rate
+  // would overflow, but the step already covers any possible input.
+  int32_t maxstep = (dt > this->_maxdt) ? FULL_RANGE
+                    : (int32_t)((dt*this->_rate) >> 8);
+  int32_t target  = (int32_t)input << 8;
 
   // Limit output value
-  float output = (input > max) ? max : ((input < min) ? min : input);
-
-  // Save latest output
-  this->_lastoutput = output;
+  if (target > this->_lastoutput + maxstep) {
+    this->_lastoutput += maxstep;
+  } else if (target < this->_lastoutput - maxstep) {
+    this->_lastoutput -= maxstep;
+  } else {
+    this->_lastoutput = target;
+  }
+
+  // Truncate towards zero like the previous float to int conversion
+  int32_t output = this->_lastoutput;
+  return (output < 0) ? -(int)((-output) >> 8) : (int)(output >> 8);
+}
 
-  return output;
+// Jump straight to a value, e.g. neutral after a fault, and limit from there
+void Limiter::reset(int value) {
+  this->_lastoutput   = (int32_t)value << 8;
+  this->_lastruntime  = millis();
 }
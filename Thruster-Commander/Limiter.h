@@ -39,16 +39,20 @@ THE SOFTWARE.
 
 #include <Arduino.h>
 
+// Fixed point acceleration limiter. The output is kept in 1/256 us steps and
+// the rate in 1/65536 us per ms, so step() needs no floating point math.
 class Limiter {
 public:
   Limiter();
-  Limiter(float maxaccel, float startvalue);
+  Limiter(uint16_t maxaccel, int startvalue);
   ~Limiter();
-  float step(float input);
+  int step(int input);
+  void reset(int value);
 
 private:
-  float    _lastoutput;
-  float    _maxaccel;
+  int32_t  _lastoutput;   // us << 8
+  uint32_t _rate;         // maxaccel in (us << 16) per ms
+  uint32_t _maxdt;        // longest dt (ms) before dt*_rate overflows
   uint32_t _lastruntime;
 };
 
@@ -0,0 +1,175 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Mapping
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Mapping.h"
+#include "Thruster-Commander.h"
+
+// The ATtiny84 has no divide (or multiply) instruction, so map() costs a
+// 32-bit multiply and a 32-bit division per call. Each mapping here folds its
+// ranges into a fixed point scale instead: (counts*SCALE) >> SHIFT floors
+// exactly like map()'s division for every count the sampler can produce, so
+// the linear outputs are bit-identical. Bench-Mapping in the simulator checks
+// every input, rerun it after changing any of the ranges below.
+#define FIXED_SCALE(out, in, shift) \
+  ((((uint32_t)(out) << (shift)) + (in) - 1)/(in))
+
+// Sampler reading to 1000-2000 us
+#define THROTTLE_SHIFT  21
+#define THROTTLE_SCALE  FIXED_SCALE(PWM_MAX - PWM_MIN, ADC_MAX, THROTTLE_SHIFT)
+
+// Sampler reading to +/- steering range
+#define STEERING_SHIFT  22
+#define STEERING_SCALE  FIXED_SCALE(2*STEER_MAX, ADC_MAX, STEERING_SHIFT)
+
+// Receiver pulse to +/- steering range
+#define PULSE_STEERING_SHIFT  10
+#define PULSE_STEERING_SCALE  FIXED_SCALE(STEER_MAX, HALF_RANGE,           \
+                                          PULSE_STEERING_SHIFT)
+
+// Distance from neutral to LED compare value, 255 (off) at DEADZONE down to
+// 0 (full on) at HALF_RANGE
+#define DIMMER_SHIFT    12
+#define DIMMER_SCALE    FIXED_SCALE(255, HALF_RANGE - DEADZONE, DIMMER_SHIFT)
+
+// Response curves are 17 points over half the pot travel, from the centre
+// (0) to either end (CURVE_SPAN), in sampler counts. The other half mirrors.
+#define CURVE_SPAN      2048
+#define CURVE_STEP      7             // log2 of counts between points
+#define CURVE_CENTRE    (ADC_MAX/2)
+
+#if THROTTLE_CURVE == CURVE_EXPO
+#define THROTTLE_TABLE  expoCurve
+#elif THROTTLE_CURVE == CURVE_THRUST
+#define THROTTLE_TABLE  thrustCurve
+#endif
+
+#if STEERING_CURVE == CURVE_EXPO
+#define STEERING_TABLE  expoCurve
+#elif STEERING_CURVE == CURVE_THRUST
+#define STEERING_TABLE  thrustCurve
+#endif
+
+namespace {
+#if THROTTLE_CURVE == CURVE_EXPO || STEERING_CURVE == CURVE_EXPO
+// Half linear, half cubic: half the usual response around neutral
+const uint16_t expoCurve[] PROGMEM = {
+     0,   64,  130,  199,  272,  351,  438,  534,  640,
+   758,  890, 1037, 1200, 1381, 1582, 1804, 2048 };
+#endif
+
+#if THROTTLE_CURVE == CURVE_THRUST || STEERING_CURVE == CURVE_THRUST
+// Square root: thrust goes roughly with the square of the command, so this
+// makes thrust roughly follow the pot
+const uint16_t thrustCurve[] PROGMEM = {
+     0,  512,  724,  887, 1024, 1145, 1254, 1355, 1448,
+  1536, 1619, 1698, 1774, 1846, 1916, 1983, 2048 };
+#endif
+
+// map(x, 0, in, 0, out) for the scale above, truncating toward zero like
+// map() does for negative x
+int32_t fixedScale(int32_t x, uint32_t factor, uint8_t shift) {
+  if (x < 0) {
+    return -(int32_t)(((uint32_t)-x*factor) >> shift);
+  }
+  return (int32_t)(((uint32_t)x*factor) >> shift);
+}
+
+#if defined(THROTTLE_TABLE) || defined(STEERING_TABLE)
+// Look up a response curve, interpolating between its points
+int16_t applyCurve(const uint16_t *curve, int16_t counts) {
+  int16_t  offset = counts - CURVE_CENTRE;
+  uint16_t a      = (offset < 0) ? -offset : offset;
+  int16_t  y;
+
+  if (a >= CURVE_SPAN) {
+    y = pgm_read_word(&curve[CURVE_SPAN >> CURVE_STEP]);
+  } else {
+    uint8_t  i    = a >> CURVE_STEP;
+    uint8_t  f    = a & ((1 << CURVE_STEP) - 1);
+    int16_t  y0   = pgm_read_word(&curve[i]);
+    int16_t  y1   = pgm_read_word(&curve[i + 1]);
+    y = y0 + (int16_t)(((int32_t)(y1 - y0)*f) >> CURVE_STEP);
+  }
+  return (offset < 0) ? CURVE_CENTRE - y : CURVE_CENTRE + y;
+}
+#endif
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Map an oversampled pot reading to the 1000-2000 us range
+int mapThrottle(uint16_t reading) {
+  int16_t counts = reading - POT_OFFSET*ADC_SCALE;
+#ifdef THROTTLE_TABLE
+  counts = applyCurve(THROTTLE_TABLE, counts);
+#endif
+  return PWM_MIN + fixedScale(counts, THROTTLE_SCALE, THROTTLE_SHIFT);
+}
+
+// Map an oversampled pot reading to the +/- steering range
+int mapSteering(uint16_t reading) {
+  int16_t counts = reading - POT_OFFSET*ADC_SCALE;
+#ifdef STEERING_TABLE
+  counts = applyCurve(STEERING_TABLE, counts);
+#endif
+  return -STEER_MAX + fixedScale(counts, STEERING_SCALE, STEERING_SHIFT);
+}
+
+// Map a receiver pulse to the +/- steering range, full stick either way
+// giving STEER_MAX. The transmitter has its own rates and expo, so there is
+// no response curve.
+int mapPulseSteering(int pulsewidth) {
+  int16_t offset = constrain(pulsewidth, PWM_MIN, PWM_MAX) - PWM_NEUTRAL;
+  return fixedScale(offset, PULSE_STEERING_SCALE, PULSE_STEERING_SHIFT);
+}
+
+// Map an output pulse to the LED compare value: 255 (off, inverting mode)
+// within DEADZONE of neutral, brighter further away
+uint8_t mapDimmer(int pwm) {
+  int16_t distance = (pwm < PWM_NEUTRAL) ? PWM_NEUTRAL - pwm
+                                         : pwm - PWM_NEUTRAL;
+
+  if (distance <= DEADZONE) {
+    return 255;
+  }
+  if (distance >= HALF_RANGE) {
+    return 0;
+  }
+  return 255 - fixedScale(distance - DEADZONE, DIMMER_SCALE, DIMMER_SHIFT);
+}
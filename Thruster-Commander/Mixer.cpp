@@ -0,0 +1,179 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Mixer
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Mixer.h"
+#include "Thruster-Commander.h"
+
+// Mixing gains in 1/64, so 64 passes an input through as it is
+#define MIX_SHIFT       6
+#define MIX_ONE         (1 << MIX_SHIFT)
+
+namespace {
+// What each mode makes of the inputs (L, R, SPD, STR) for the left and the
+// right output. Gains other than 0 and +/-MIX_ONE cost a multiply.
+const int8_t mixMatrix[MIX_MODES][2][MIX_INPUTS] PROGMEM = {
+  // MIX_NEUTRAL
+  { { 0,       0,       0,       0       },
+    { 0,       0,       0,       0       } },
+  // MIX_TANK
+  { { MIX_ONE, 0,       0,       0       },
+    { 0,       MIX_ONE, 0,       0       } },
+  // MIX_ARCADE
+  { { 0,       0,       MIX_ONE, MIX_ONE },
+    { 0,       0,       MIX_ONE, -MIX_ONE } },
+  // MIX_SINGLE_L
+  { { MIX_ONE, 0,       0,       0       },
+    { MIX_ONE, 0,       0,       0       } },
+  // MIX_SINGLE_R
+  { { 0,       MIX_ONE, 0,       0       },
+    { 0,       MIX_ONE, 0,       0       } },
+};
+
+// Mode for each combination of connected inputs, indexed by the
+// MIX_CONNECTED_ bits. Both L and R come first, then SPD and STR, then
+// either one alone. L and SPD share a pin, so only rows with both or
+// neither set turn up on the board.
+const uint8_t modeTable[16] PROGMEM = {
+  MIX_NEUTRAL,  MIX_SINGLE_L, MIX_SINGLE_R, MIX_TANK,   // -
+  MIX_NEUTRAL,  MIX_SINGLE_L, MIX_SINGLE_R, MIX_TANK,   // SPD
+  MIX_NEUTRAL,  MIX_SINGLE_L, MIX_SINGLE_R, MIX_TANK,   // STR
+  MIX_ARCADE,   MIX_ARCADE,   MIX_ARCADE,   MIX_TANK,   // SPD and STR
+};
+
+// One input's share of an output
+int16_t term(int16_t input, int8_t gain) {
+  if (gain == 0) {
+    return 0;
+  }
+  if (gain == MIX_ONE) {
+    return input;
+  }
+  if (gain == -MIX_ONE) {
+    return -input;
+  }
+  return ((int32_t)input*gain) >> MIX_SHIFT;
+}
+
+int16_t mixRow(const int8_t *gains, const int16_t *inputs) {
+  int16_t sum = 0;
+  for (uint8_t i = 0; i < MIX_INPUTS; i++) {
+    sum += term(inputs[i], (int8_t)pgm_read_byte(&gains[i]));
+  }
+  return sum;
+}
+
+// Bring both outputs within HALF_RANGE of neutral. Throttle and steering
+// are the sum and difference of the two sides (doubled, to stay exact):
+// an output is in range exactly when the two add up to 2*HALF_RANGE or
+// less, so the policy decides which of them gives way.
+void desaturate(uint8_t policy, int16_t *left, int16_t *right) {
+  int16_t throttle = *left + *right;
+  int16_t steering = *left - *right;
+  int16_t room     = 2*HALF_RANGE;
+
+  switch (policy) {
+  case DESAT_STEERING:
+    steering  = constrain(steering, -room, room);
+    room     -= abs(steering);
+    throttle  = constrain(throttle, -room, room);
+    break;
+
+  case DESAT_THROTTLE:
+    throttle  = constrain(throttle, -room, room);
+    room     -= abs(throttle);
+    steering  = constrain(steering, -room, room);
+    break;
+
+  case DESAT_PROPORTIONAL: {
+    // The same fraction off both keeps their ratio: the side further out
+    // goes to the end of the range and the other follows it. That takes
+    // a 32-bit division, but only while saturated; a coarser fraction
+    // from a 16-bit one lets the outputs step backwards.
+    int16_t  *outer = (abs(*left) >= abs(*right)) ? left : right;
+    int16_t  *inner = (outer == left) ? right : left;
+    uint16_t  reach = abs(*outer);
+    if (reach <= HALF_RANGE) {
+      return;
+    }
+    int16_t   part  = (uint32_t)abs(*inner)*HALF_RANGE/reach;
+    *inner = (*inner < 0) ? -part : part;
+    *outer = (*outer < 0) ? -HALF_RANGE : HALF_RANGE;
+    return;
+  }
+
+  default:
+    // DESAT_CLIP: each side on its own, as the mix always used to
+    *left  = constrain(*left, -HALF_RANGE, HALF_RANGE);
+    *right = constrain(*right, -HALF_RANGE, HALF_RANGE);
+    return;
+  }
+
+  // Sum and difference always share their parity, so this is exact
+  *left  = (throttle + steering)/2;
+  *right = (throttle - steering)/2;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Mixing mode for the inputs detect() found connected
+uint8_t mixerMode(uint8_t connected) {
+  return pgm_read_byte(&modeTable[connected & 0x0f]);
+}
+
+// Mix the mapped inputs (us from neutral) into the two outputs (us). Every
+// policy but DESAT_CLIP first holds each input to HALF_RANGE, so the pots'
+// overtravel past the ends is not taken for a request to saturate.
+void mixOutputs(uint8_t mode, uint8_t policy, const int16_t *inputs,
+                int *pwmL, int *pwmR) {
+  int16_t held[MIX_INPUTS];
+  if (policy != DESAT_CLIP) {
+    for (uint8_t i = 0; i < MIX_INPUTS; i++) {
+      held[i] = constrain(inputs[i], -HALF_RANGE, HALF_RANGE);
+    }
+    inputs = held;
+  }
+
+  int16_t left  = mixRow(mixMatrix[mode][0], inputs);
+  int16_t right = mixRow(mixMatrix[mode][1], inputs);
+  desaturate(policy, &left, &right);
+
+  *pwmL = PWM_NEUTRAL + left;
+  *pwmR = PWM_NEUTRAL + right;
+}
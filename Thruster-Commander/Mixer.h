@@ -0,0 +1,69 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Mixer
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef MIXER
+#define MIXER
+
+#include <Arduino.h>
+
+// Mixer inputs, as us from neutral
+#define MIX_L           0
+#define MIX_R           1
+#define MIX_SPD         2
+#define MIX_STR         3
+#define MIX_INPUTS      4
+
+// Mixing modes, the rows of the matrix table in Mixer.cpp
+#define MIX_NEUTRAL     0             // nothing usable connected
+#define MIX_TANK        1             // L and R each drive their side
+#define MIX_ARCADE      2             // SPD plus and minus STR
+#define MIX_SINGLE_L    3             // L drives both sides
+#define MIX_SINGLE_R    4             // R drives both sides
+#define MIX_MODES       5
+
+// Connected inputs, for mixerMode()
+#define MIX_CONNECTED_L    _BV(MIX_L)
+#define MIX_CONNECTED_R    _BV(MIX_R)
+#define MIX_CONNECTED_SPD  _BV(MIX_SPD)
+#define MIX_CONNECTED_STR  _BV(MIX_STR)
+
+// Function Declarations
+uint8_t mixerMode(uint8_t connected);
+void    mixOutputs(uint8_t mode, uint8_t policy, const int16_t *inputs,
+                   int *pwmL, int *pwmR);
+
+#endif
@@ -0,0 +1,263 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - PWM Scheduler
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "PWM-Scheduler.h"
+#include "Thruster-Commander.h"
+
+#if PWM_SCHEDULED
+
+#define WORK_LISTS    3               // front, pending and the one being built
+#define NEUTRAL_LIST  3               // kept for forceNeutralScheduler()
+#define NO_LIST       0xFF
+#define FRAME_START   0xFF            // next interrupt raises the outputs
+
+// One pass of the wait for a close edge, on the part
+#define SPIN_CYCLES   6
+
+namespace {
+// Output pins in channel order
+#if PWM_CHANNELS > 3
+const uint8_t pins[PWM_CHANNELS] = { PWM_L, PWM_R, PWM_3, PWM_4 };
+#elif PWM_CHANNELS > 2
+const uint8_t pins[PWM_CHANNELS] = { PWM_L, PWM_R, PWM_3 };
+#else
+const uint8_t pins[PWM_CHANNELS] = { PWM_L, PWM_R };
+#endif
+
+// Outputs to lower, a number of counts after the frame started
+struct Edge {
+  uint16_t count;
+  uint8_t  porta;
+  uint8_t  portb;
+};
+
+// Every fall of a frame in time order, channels with equal counts share one
+struct EdgeList {
+  Edge     edge[PWM_CHANNELS];
+  uint8_t  edges;
+};
+
+// The interrupt runs the front list and takes up the pending one at the
+// next frame start. Lists are built by loop() in one that is neither, so a
+// pulse never mixes two lists and a new list never waits on the interrupt.
+EdgeList          lists[WORK_LISTS + 1];
+volatile uint8_t  front   = NEUTRAL_LIST;
+volatile uint8_t  pending = NO_LIST;
+volatile uint8_t  forces;               // times neutral was forced
+uint16_t          counts[PWM_CHANNELS]; // latest pulse of each channel
+uint8_t           risea, riseb;         // port bits of every output
+uint8_t           next    = FRAME_START;
+uint16_t          start;                // TCNT1 as the outputs went high
+uint16_t          spin;                 // counts waited out in the interrupt
+#if I2C_TARGET
+uint16_t          top;                  // ICR1 of a frame not resynced
+#endif
+
+// Port bit of an output pin, pins 8-10 are PB2-PB0
+void addPortBit(uint8_t pin, uint8_t *a, uint8_t *b) {
+  if (pin < 8) {
+    *a |= (1 << pin);
+  } else {
+    *b |= (1 << (10 - pin));
+  }
+}
+
+// Sort the channels' falls into the list by insertion, merging equal counts
+void buildEdges(EdgeList *list) {
+  uint8_t n = 0;
+
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    uint8_t a = 0, b = 0;
+    uint8_t i = 0;
+    addPortBit(pins[c], &a, &b);
+
+    while (i < n && list->edge[i].count < counts[c]) {
+      i++;
+    }
+    if (i < n && list->edge[i].count == counts[c]) {
+      list->edge[i].porta |= a;
+      list->edge[i].portb |= b;
+      continue;
+    }
+    for (uint8_t j = n; j > i; j--) {
+      list->edge[j] = list->edge[j - 1];
+    }
+    list->edge[i].count = counts[c];
+    list->edge[i].porta = a;
+    list->edge[i].portb = b;
+    n++;
+  }
+  list->edges = n;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Start with neutral on every output. Call with interrupts off, after timer1
+// is set up in CTC mode and before it starts. waitcounts is how many counts
+// before an edge the interrupt comes in to wait for it, more than the longest
+// any other interrupt can hold it up.
+void initializePWMScheduler(uint16_t neutral, uint16_t waitcounts) {
+  risea = 0;
+  riseb = 0;
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    counts[c] = neutral;
+    addPortBit(pins[c], &risea, &riseb);
+  }
+  buildEdges(&lists[NEUTRAL_LIST]);
+  front   = NEUTRAL_LIST;
+  pending = NO_LIST;
+  next    = FRAME_START;
+  spin    = waitcounts;
+#if I2C_TARGET
+  top     = ICR1;
+#endif
+
+  // Outputs low until the first frame starts at count 0
+  PORTA  &= ~risea;
+  PORTB  &= ~riseb;
+  OCR1A   = 0;
+  TIFR1   = (1 << OCF1A);
+  TIMSK1 |= (1 << OCIE1A);
+}
+
+// Give a channel a new pulse from the next frame that starts after the
+// call returns. The whole list is sorted again here in loop(), so the
+// interrupt only walks it.
+void schedulePWM(int pin, uint16_t width) {
+  uint8_t back = 0;
+  uint8_t forced;
+
+  // Stop interrupts while picking a list neither in use nor waiting
+  cli();
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    if (pins[c] == pin) {
+      counts[c] = width;
+    }
+  }
+  while (back == front || back == pending) {
+    back++;
+  }
+  forced = forces;
+  sei();
+
+  buildEdges(&lists[back]);
+
+  // Hand it over, unless neutral was forced while it was being built
+  cli();
+  if (forces == forced) {
+    pending = back;
+  }
+  sei();
+}
+
+// Neutral on every output from the next frame on, until the next
+// schedulePWM(). Safe to call from an interrupt.
+void forceNeutralScheduler() {
+  uint8_t sreg = SREG;
+  cli();
+  for (uint8_t c = 0; c < PWM_CHANNELS; c++) {
+    counts[c] = lists[NEUTRAL_LIST].edge[0].count;
+  }
+  pending = NEUTRAL_LIST;
+  forces++;
+  SREG    = sreg;
+}
+
+#if I2C_TARGET
+// Start the next frame lead counts from now, wherever the current one is,
+// by moving TOP. The frame after it is back to full length. Pulses already
+// going still end on time as long as lead is longer than any of them. Call
+// from an interrupt.
+void resyncScheduler(uint16_t lead) {
+  ICR1 = TCNT1 + lead;
+}
+#endif
+
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered at count 0 to start a frame, then shortly before each edge. An
+// edge closer than spin counts is waited for here, so the time the vector
+// takes to come in never shows in a pulse. Widths count from the moment
+// the outputs went high, so a late frame start delays pulses but does not
+// stretch them.
+SIGNAL(TIM1_COMPA_vect) {
+  if (next == FRAME_START) {
+    if (pending != NO_LIST) {
+      front   = pending;
+      pending = NO_LIST;
+    }
+    PORTA |= risea;
+    PORTB |= riseb;
+    start  = TCNT1;
+    next   = 0;
+#if I2C_TARGET
+    ICR1   = top;
+#endif
+  }
+
+  const EdgeList& list = lists[front];
+  while (next < list.edges) {
+    const Edge& e   = list.edge[next];
+    uint16_t    due = start + e.count;
+
+    if ((int16_t)(due - TCNT1) > (int16_t)spin) {
+      // Come back a little before it
+      OCR1A = due - spin;
+      return;
+    }
+    while ((int16_t)(due - TCNT1) > 0) {
+#ifndef __AVR__
+      // Register reads take no time on the host
+      __builtin_avr_delay_cycles(SPIN_CYCLES);
+#endif
+    }
+    PORTA &= ~e.porta;
+    PORTB &= ~e.portb;
+    next++;
+  }
+
+  // All low, wait for the next frame
+  next  = FRAME_START;
+  OCR1A = 0;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Power Saving
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Power-Saving.h"
+
+#if SLEEP_IDLE
+#include <avr/sleep.h>
+
+// Only idle sleep keeps clk_I/O, and with it Timer0 and Timer1, running.
+// ADC noise reduction, power-down and standby would all stop the PWM timer
+// mid-pulse, so the ADC sampler simply keeps converting through idle sleep.
+
+///////////////
+// Functions //
+///////////////
+
+// Shut off the USI unless it takes I2C commands, and pick idle sleep. Its
+// interrupts wake the CPU from idle like any other.
+void initializePowerSaving() {
+#if !I2C_TARGET
+  PRR |= (1 << PRUSI);
+#endif
+  set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+// Sleep until the next interrupt. Timer0 wakes the CPU every 2 ms or so, the
+// ADC sampler after every conversion (about 104 us) while it runs.
+void sleepUntilInterrupt() {
+  sleep_enable();
+  sleep_cpu();
+  sleep_disable();
+}
+#endif
@@ -0,0 +1,292 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - RC Input
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "RC-Input.h"
+#include "Thruster-Commander.h"
+#include "Servo-Driver.h"
+
+#if RC_INPUT
+
+// Input capture is taken: ICP1 is LED_R's pin and ICR1 is TOP for the
+// outputs. The pin change interrupt stamps each edge instead, with micros()
+// for the whole width and TCNT1 for the fine part. micros() moves in 8 us
+// steps and TCNT1 wraps every PWM frame, so readRCInput() takes the Timer1
+// width closest to the micros() one.
+#define RC_PINS       (((1 << RC_CHANNELS) - 1) << RC_FIRST_PIN)
+#define COARSE_SLACK  32              // us, micros() steps and the vector
+                                      //   coming in late at either edge
+
+namespace {
+// Latest pulse on each channel, written by the interrupt and taken by
+// readRCInput() while its pulsefresh bit is set
+volatile uint8_t  pulsefresh;
+volatile uint16_t pulseus[RC_CHANNELS];       // width from micros()
+volatile uint16_t pulsecounts[RC_CHANNELS];   // width in Timer1 counts,
+                                              //   less whole frames
+volatile uint16_t pulseframe[RC_CHANNELS];    // us since the pulse before
+
+// Edges so far, only used by the interrupt
+uint8_t           pinlevels;
+uint16_t          riseus[RC_CHANNELS];
+uint16_t          risecount[RC_CHANNELS];
+uint16_t          frameus[RC_CHANNELS];
+uint8_t           fallen;                     // channels done this frame
+
+// Channels that make up a receiver frame, set by readRCInput()
+volatile uint8_t  framechannels;
+
+// What readRCInput() made of the pulses
+struct Channel {
+  uint16_t width;       // latest pulse taken, us
+  uint16_t held;        // a jump waiting for the next pulse to confirm it
+  bool     holding;
+  uint8_t  run;         // good pulses in a row, up to RC_DETECT_PULSES
+  bool     seen;        // a receiver, since power-up
+  bool     pulsed;      // any pulse at all since power-up
+  uint32_t lastgood;    // millis() at the latest pulse taken
+  uint32_t lastpulse;   // millis() at the latest pulse, good or not
+};
+Channel channels[RC_CHANNELS];
+
+uint16_t distance(uint16_t a, uint16_t b) {
+  return (a > b) ? a - b : b - a;
+}
+
+// The Timer1 width, plus whole frames, closest to the micros() one, in us
+uint16_t resolveWidth(uint16_t us, uint16_t counts, uint16_t period) {
+  // Timer1 counts 8 times a us at prescale 1, once at prescale 8
+  uint8_t  shift  = ((TCCR1B & 0x07) == (1 << CS10)) ? 3 : 0;
+  uint16_t target = us << shift;
+  while (counts + (period >> 1) < target) {
+    counts += period;
+  }
+  return counts >> shift;
+}
+
+// Check one pulse and take it as the channel's width, true if taken. A
+// pulse too short or too long, or too soon or too late after the one
+// before, is a glitch. A jump of more than RC_GLITCH from the width taken
+// before needs the next pulse to confirm it. Edges from a floating pin
+// following DETECT are far too long apart to count as pulses at all.
+bool takePulse(Channel *ch, uint16_t us, uint16_t counts, uint16_t frame,
+               uint16_t period, uint32_t now) {
+  if (us < RC_PULSE_MIN - COARSE_SLACK || us > RC_PULSE_MAX + COARSE_SLACK) {
+    ch->run = 0;
+    return false;
+  }
+  ch->pulsed    = true;
+  ch->lastpulse = now;
+
+  uint16_t width = 0;
+  if (frame >= RC_FRAME_MIN && frame <= RC_FRAME_MAX) {
+    width = resolveWidth(us, counts, period);
+  }
+  if (width < RC_PULSE_MIN || width > RC_PULSE_MAX) {
+    ch->run = 0;
+    return false;
+  }
+
+  if (ch->seen && distance(width, ch->width) > RC_GLITCH
+      && !(ch->holding && distance(width, ch->held) <= RC_GLITCH)) {
+    ch->held    = width;
+    ch->holding = true;
+    return false;
+  }
+  ch->holding  = false;
+  ch->width    = width;
+  ch->lastgood = now;
+  if (ch->run < RC_DETECT_PULSES && ++ch->run == RC_DETECT_PULSES) {
+    ch->seen = true;
+  }
+  return true;
+}
+
+bool timedOut(const Channel& ch, uint32_t now) {
+  return now - ch.lastgood > RC_TIMEOUT;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+void initializeRCInput() {
+  // Stop interrupts while changing pin change settings
+  cli();
+
+  memset(channels, 0, sizeof(channels));
+  pulsefresh    = 0;
+  fallen        = 0;
+  framechannels = 0;
+  pinlevels     = PINA & RC_PINS;
+
+  // Pin change interrupt on every input pin (digital pins 0-7 are PCINT0-7)
+  PCMSK0 |= RC_PINS;
+  GIFR    = (1 << PCIF0);
+  GIMSK  |= (1 << PCIE0);
+
+  // Done setting interrupts -> allow interrupts again
+  sei();
+}
+
+// Take in the pulses since the last call. Returns a bit (1 << pin) for
+// each pin with a new width taken.
+uint8_t readRCInput() {
+  uint32_t now   = millis();
+  uint8_t  fresh = 0;
+  uint8_t  live  = 0;
+
+  for (uint8_t c = 0; c < RC_CHANNELS; c++) {
+    // Stop interrupts while copying the channel's pulse and reading ICR1,
+    // both 16-bit
+    cli();
+    bool     got    = pulsefresh & (1 << c);
+    uint16_t us     = pulseus[c];
+    uint16_t counts = pulsecounts[c];
+    uint16_t frame  = pulseframe[c];
+    uint16_t period = ICR1 + 1;
+    pulsefresh &= ~(1 << c);
+    sei();
+
+    Channel *ch = &channels[c];
+    if (got && takePulse(ch, us, counts, frame, period, now)) {
+      fresh |= 1 << (RC_FIRST_PIN + c);
+    }
+    if (ch->seen && !timedOut(*ch, now)) {
+      live |= 1 << c;
+    }
+  }
+
+  framechannels = live;
+  return fresh;
+}
+
+// True for a pin with a receiver on it, or with pulses of about the right
+// width lately: its reading is no pot's
+bool rcInputActive(uint8_t pin) {
+  const Channel& ch = channels[pin - RC_FIRST_PIN];
+  return ch.seen || (ch.pulsed && millis() - ch.lastpulse <= RC_TIMEOUT);
+}
+
+// Latest width on a pin, neutral until a receiver is seen on it and while
+// its pulses are lost
+int rcInputWidth(uint8_t pin) {
+  const Channel& ch = channels[pin - RC_FIRST_PIN];
+  if (!ch.seen || timedOut(ch, millis())) {
+    return PWM_NEUTRAL;
+  }
+  return ch.width;
+}
+
+// True once a receiver seen on any pin has sent no good pulse for
+// RC_TIMEOUT
+bool rcInputLost() {
+  uint32_t now = millis();
+  for (uint8_t c = 0; c < RC_CHANNELS; c++) {
+    if (channels[c].seen && timedOut(channels[c], now)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The same for the receiver on one pin
+bool rcInputLost(uint8_t pin) {
+  const Channel& ch = channels[pin - RC_FIRST_PIN];
+  return ch.seen && timedOut(ch, millis());
+}
+
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered by any change on an enabled PORTA pin
+SIGNAL(PCINT0_vect) {
+  uint16_t count   = TCNT1;           // first, closest to the edge
+  uint16_t now     = micros();
+  uint16_t period  = ICR1 + 1;
+  uint8_t  levels  = PINA & RC_PINS;
+  uint8_t  changed = levels ^ pinlevels;
+  pinlevels = levels;
+
+  for (uint8_t c = 0; c < RC_CHANNELS; c++) {
+    uint8_t bit = 1 << (RC_FIRST_PIN + c);
+    if (!(changed & bit)) {
+      continue;
+    }
+    if (levels & bit) {
+      // A pulse starts. Its channel starting again before every channel
+      // finished the last frame means that frame was cut short.
+      frameus[c]   = now - riseus[c];
+      riseus[c]    = now;
+      risecount[c] = count;
+      if (fallen & (1 << c)) {
+        fallen = 0;
+      }
+    } else {
+      // A pulse ends, counting across a wrap of Timer1 at TOP
+      uint16_t counts = count - risecount[c];
+      if (count < risecount[c]) {
+        counts += period;
+      }
+      pulseus[c]     = now - riseus[c];
+      pulsecounts[c] = counts;
+      pulseframe[c]  = frameus[c];
+      pulsefresh    |= 1 << c;
+      fallen        |= 1 << c;
+    }
+  }
+
+#if FRAME_SYNC
+  // The receiver's frame is done: cut the PWM frame short so the update
+  // puts it out with the very next pulses. Pulses still going count the
+  // skipped part out again.
+  uint8_t live = framechannels;
+  if (live && (fallen & live) == live) {
+    fallen = 0;
+    uint16_t skipped = lockPWMFrame();
+    for (uint8_t c = 0; skipped && c < RC_CHANNELS; c++) {
+      if (levels & (1 << (RC_FIRST_PIN + c))) {
+        uint16_t rise = risecount[c] + skipped;
+        risecount[c]  = (rise >= period) ? rise - period : rise;
+      }
+    }
+  }
+#endif
+}
+
+#endif
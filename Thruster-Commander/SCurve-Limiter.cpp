@@ -0,0 +1,251 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Jerk Limited Acceleration Limiter
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "SCurve-Limiter.h"
+
+// DEFAULT VALUES
+#define DEFAULT_MAX_ACCEL 50      // us/s
+#define DEFAULT_MAX_JERK  500     // us/s^2
+
+// Longest dt (ms) one step integrates. Keeps rate*dt and the braking
+// products below in 32 bits; a longer gap just moves the output less.
+#define MAX_DT            64
+
+namespace {
+// us/s to (us << 16) per ms
+uint32_t rateOf(uint16_t perSecond) {
+  return (((uint32_t)perSecond << 16) + 500)/1000;
+}
+
+// us/s^2 to (us << 16) per ms^2
+uint32_t jerkOf(uint16_t perSecond2) {
+  return (((uint32_t)perSecond2 << 16) + 500000)/1000000;
+}
+
+// Longest distance (us << 8) that 2*jerk*distance fits 32 bits for
+uint32_t brakeLimitOf(uint32_t jerk) {
+  return jerk ? 0xFFFFFFFFul/(2*jerk) : 0xFFFFFFFFul;
+}
+
+// Whether a speed must start coming down to reach endspeed within distance,
+// slowing by jerk per ms. speed, endspeed: (us << 16) per ms,
+// distance: us << 8. Compares v^2 - e^2 >= 2*jerk*distance with v and e
+// dropped to (us << 8) per ms so it fits 32 bits for rates to 15000 us/s.
+// Beyond limit the right hand side could not fit, and no such rate needs
+// that far to stop.
+bool mustBrake(uint32_t speed, uint32_t endspeed, int32_t distance,
+               uint32_t jerk, uint32_t limit) {
+  if (speed <= endspeed) {
+    return false;
+  }
+  if (distance <= 0) {
+    return true;
+  }
+  if ((uint32_t)distance >= limit) {
+    return false;
+  }
+  uint32_t v = speed >> 8;
+  uint32_t e = endspeed >> 8;
+  return ((v*v - e*e) << 8) >= 2*jerk*(uint32_t)distance;
+}
+}
+
+//////////////////
+// Constructors //
+//////////////////
+
+// Default Constructor
+SCurveLimiter::SCurveLimiter() {
+  this->_lastoutput   = 0;
+  this->_rate         = 0;
+  this->_jerk         = jerkOf(DEFAULT_MAX_JERK);
+  this->_brakelimit   = brakeLimitOf(this->_jerk);
+  this->_speedup      = rateOf(DEFAULT_MAX_ACCEL);
+  this->_slowdown     = this->_speedup;
+  this->_reversal     = this->_speedup;
+  this->_neutral      = 0;
+  this->_band         = 0;
+  this->_lastruntime  = millis();
+}
+
+// Useful Constructor, the same rate limit in every direction
+SCurveLimiter::SCurveLimiter(uint16_t maxaccel, uint16_t maxjerk,
+                             int startvalue) {
+  this->_lastoutput   = (int32_t)startvalue << 8;
+  this->_rate         = 0;
+  this->_jerk         = jerkOf(maxjerk);
+  this->_brakelimit   = brakeLimitOf(this->_jerk);
+  this->_speedup      = rateOf(maxaccel);
+  this->_slowdown     = this->_speedup;
+  this->_reversal     = this->_speedup;
+  this->_neutral      = 0;
+  this->_band         = 0;
+  this->_lastruntime  = millis();
+}
+
+// Destructor
+SCurveLimiter::~SCurveLimiter() {} // Nothing to destruct
+
+
+////////////////////
+// Public Methods //
+////////////////////
+
+// Use separate rate limits moving away from neutral, towards it, and within
+// band of it
+void SCurveLimiter::setDirectionalLimits(int neutral, uint16_t band,
+                                         uint16_t speedup, uint16_t slowdown,
+                                         uint16_t reversal) {
+  this->_neutral  = (int32_t)neutral << 8;
+  this->_band     = (int32_t)band << 8;
+  this->_speedup  = rateOf(speedup);
+  this->_slowdown = rateOf(slowdown);
+  this->_reversal = rateOf(reversal);
+}
+
+// Whether moving at speed for dt leaves too little room to stop at the
+// target, or to enter the neutral band no faster than the reversal limit.
+// Slowing by jerk*dt every dt from there covers v^2/(2*jerk) - v*dt/2, so
+// the room needed is v^2/(2*jerk) plus half a step.
+bool SCurveLimiter::tooFast(uint32_t speed, int32_t distance, int32_t ahead,
+                            int32_t fromband, uint32_t dt) {
+  int32_t travel = (int32_t)((speed*dt) >> 9);
+  if (mustBrake(speed, 0, distance - travel, this->_jerk, this->_brakelimit)) {
+    return true;
+  }
+  // Only when the band lies between here and the target
+  return ahead > 0 && fromband > 0 && fromband < distance
+         && mustBrake(speed, this->_reversal, fromband - travel, this->_jerk,
+                      this->_brakelimit);
+}
+
+// Move filter along one timestep, return filtered output
+int SCurveLimiter::step(int input) {
+  // Measure elapsed time
+  uint32_t now = millis();
+  uint32_t dt  = now - this->_lastruntime;
+  this->_lastruntime = now;
+  if (dt > MAX_DT) {
+    dt = MAX_DT;
+  }
+
+  // Work in the direction of the target: speed > 0 moves towards it
+  int32_t  target   = (int32_t)input << 8;
+  int32_t  error    = target - this->_lastoutput;
+  bool     up       = (error > 0) || (error == 0 && this->_rate > 0);
+  int32_t  distance = up ? error : -error;
+  int32_t  speed    = up ? this->_rate : -this->_rate;
+  uint32_t jerkstep = this->_jerk*dt;
+
+  // Where the output is relative to neutral, in the direction of travel
+  int32_t  offset   = this->_lastoutput - this->_neutral;
+  int32_t  ahead    = up ? -offset : offset;        // > 0: neutral is ahead
+  int32_t  fromband = (offset < 0 ? -offset : offset) - this->_band;
+  uint32_t limit;
+  if (fromband < 0) {
+    limit = this->_reversal;
+  } else if (ahead > 0) {
+    limit = this->_slowdown;
+  } else {
+    limit = this->_speedup;
+  }
+
+  if (speed < 0) {
+    // Moving away from the target, turn around
+    speed += jerkstep;
+  } else {
+    // Speed up only while the next step could still stop in time, slow down
+    // once this one can't
+    uint32_t faster = (uint32_t)speed + jerkstep;
+    if (faster > limit) {
+      faster = ((uint32_t)speed > limit) ? (uint32_t)speed : limit;
+    }
+    if (this->tooFast(speed, distance, ahead, fromband, dt)) {
+      speed = ((uint32_t)speed > jerkstep) ? speed - (int32_t)jerkstep : 0;
+    } else if (!this->tooFast(faster, distance, ahead, fromband, dt)) {
+      speed = faster;
+    } else if ((uint32_t)speed < this->_reversal
+               && !this->tooFast(this->_reversal, distance, ahead, fromband,
+                                 dt)) {
+      // A whole jerk step would cross into the band too fast, which with
+      // a low reversal limit would hold the output at its edge for good.
+      // Take the part of it up to the reversal limit.
+      speed = ((uint32_t)speed + jerkstep < this->_reversal)
+              ? speed + (int32_t)jerkstep : (int32_t)this->_reversal;
+    }
+    if ((uint32_t)speed > limit) {
+      // Above the limit for this side of neutral, come down to it
+      speed = ((uint32_t)speed > limit + jerkstep) ? speed - (int32_t)jerkstep
+                                                   : (int32_t)limit;
+    }
+  }
+
+  // Advance, landing on the target once it is within one step and the
+  // rate was within one jerk step of stopping. Short of that, stop at the
+  // target and let the rate come down over the next steps.
+  int32_t  move  = (speed*(int32_t)dt) >> 8;
+  int32_t  reach = (int32_t)((jerkstep*dt) >> 8);
+  uint32_t was   = (this->_rate < 0) ? -this->_rate : this->_rate;
+  if ((uint32_t)speed <= jerkstep && was <= jerkstep
+      && distance <= (move > reach ? move : reach)) {
+    this->_lastoutput = target;
+    this->_rate       = 0;
+  } else {
+    if (speed > 0 && move > distance) {
+      move = distance;
+    }
+    this->_lastoutput += up ? move : -move;
+    this->_rate        = up ? speed : -speed;
+  }
+
+  // Truncate towards zero like Limiter
+  int32_t output = this->_lastoutput;
+  return (output < 0) ? -(int)((-output) >> 8) : (int)(output >> 8);
+}
+
+// Jump straight to a value, e.g. neutral after a fault, at rest
+void SCurveLimiter::reset(int value) {
+  this->_lastoutput   = (int32_t)value << 8;
+  this->_rate         = 0;
+  this->_lastruntime  = millis();
+}
+
+// Current rate in us/s, > 0 increasing
+int32_t SCurveLimiter::rate() {
+  int32_t r = this->_rate;
+  return (r < 0) ? -(int32_t)((-r*1000ll) >> 16) : (int32_t)((r*1000ll) >> 16);
+}
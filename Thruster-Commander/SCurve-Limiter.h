@@ -0,0 +1,78 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Jerk Limited Acceleration Limiter
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+#ifndef SCURVELIMITER
+#define SCURVELIMITER
+
+#include <Arduino.h>
+
+// Second order acceleration limiter. Like Limiter the output moves towards
+// the input no faster than maxaccel (us/s), but the rate itself only changes
+// by maxjerk (us/s^2), so the output follows an S-curve instead of a ramp
+// with corners. Optionally the rate limit depends on whether the output is
+// moving away from neutral (speeding up), towards it (slowing down) or is
+// within a band around neutral (reversing).
+//
+// Fixed point: output in 1/256 us, rates in 1/65536 us per ms, jerk in
+// 1/65536 us per ms^2. Rate limits up to 15000 us/s.
+class SCurveLimiter {
+public:
+  SCurveLimiter();
+  SCurveLimiter(uint16_t maxaccel, uint16_t maxjerk, int startvalue);
+  ~SCurveLimiter();
+  void setDirectionalLimits(int neutral, uint16_t band, uint16_t speedup,
+                            uint16_t slowdown, uint16_t reversal);
+  int step(int input);
+  void reset(int value);
+  int32_t rate();
+
+private:
+  bool tooFast(uint32_t speed, int32_t distance, int32_t ahead,
+               int32_t fromband, uint32_t dt);
+
+  int32_t  _lastoutput;   // us << 8
+  int32_t  _rate;         // current rate, (us << 16) per ms
+  uint32_t _jerk;         // (us << 16) per ms^2
+  uint32_t _brakelimit;   // see mustBrake()
+  uint32_t _speedup;      // rate limits, (us << 16) per ms
+  uint32_t _slowdown;
+  uint32_t _reversal;
+  int32_t  _neutral;      // us << 8
+  int32_t  _band;         // us << 8
+  uint32_t _lastruntime;
+};
+
+#endif
@@ -0,0 +1,227 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Serial Commands
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Serial-Command.h"
+#include "Thruster-Commander.h"
+
+#if SERIAL_COMMAND
+
+// Receive only software UART on SERIAL_RX. The pin change interrupt stamps
+// every edge with micros() and fills in the bits since the last edge; the
+// stop bit of the last byte of a frame has no edge after it, so
+// readSerialCommand() finishes that byte once its time has passed.
+#define BIT_US16      (16000000ul/SERIAL_BAUD)    // bit period, us*16
+#define BYTE_US       (10000000ul/SERIAL_BAUD)    // start, 8 data, stop
+#define RX_BUFFER     16                          // bytes, power of 2
+
+namespace {
+// Ring buffer between the interrupt (writes rxhead) and readSerialCommand()
+// (writes rxtail). Each side only reads the other's index.
+volatile uint8_t  rxbuffer[RX_BUFFER];
+volatile uint8_t  rxhead;
+volatile uint8_t  rxtail;
+
+// Byte being received
+volatile bool     rxbusy;
+volatile uint32_t rxstart;        // micros() at the start bit edge
+uint16_t          rxcenter;       // middle of the next bit, us*16 from rxstart
+uint8_t           rxbit;          // next bit, 0 start, 1-8 data, 9 stop
+uint8_t           rxshift;
+bool              rxstartok;
+volatile bool     rxlevel;        // line level since the last edge
+
+// Frame being parsed
+uint8_t           frame[COMMAND_LENGTH];
+uint8_t           framelength;
+uint8_t           lastsequence;
+bool              sequenceseen;
+
+// Take in every bit whose middle is before elapsed, all at level. Call with
+// interrupts off.
+void clockBits(uint32_t elapsed, bool level) {
+  uint16_t elapsed16 = (elapsed >= 0x1000) ? 0xFFFF : (uint16_t)(elapsed << 4);
+
+  while (rxbit < 10 && elapsed16 >= rxcenter) {
+    if (rxbit == 0) {
+      rxstartok = !level;
+    } else if (rxbit <= 8) {
+      rxshift >>= 1;
+      if (level) {
+        rxshift |= 0x80;
+      }
+    } else if (level && rxstartok) {
+      // Good stop bit: store the byte, dropping it if the buffer is full
+      uint8_t next = (rxhead + 1) & (RX_BUFFER - 1);
+      if (next != rxtail) {
+        rxbuffer[rxhead] = rxshift;
+        rxhead           = next;
+      }
+    }
+    rxbit++;
+    rxcenter += BIT_US16;
+  }
+  if (rxbit >= 10) {
+    rxbusy = false;
+  }
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+void initializeSerialCommand() {
+  // Stop interrupts while changing pin change settings
+  cli();
+
+  rxhead  = rxtail = 0;
+  rxbusy  = false;
+  rxlevel = true;
+  framelength  = 0;
+  sequenceseen = false;
+
+  // Pin change interrupt on SERIAL_RX (digital pins 0-7 are PCINT0-7)
+  PCMSK0 |= (1 << SERIAL_RX);
+  GIFR    = (1 << PCIF0);
+  GIMSK  |= (1 << PCIE0);
+
+  // Done setting interrupts -> allow interrupts again
+  sei();
+}
+
+// Feed received bytes to the parser, true when they completed a new command
+bool readSerialCommand(SerialCommand *command) {
+  // Finish a byte whose stop bit has gone by without another edge
+  cli();
+  if (rxbusy) {
+    uint32_t elapsed = micros() - rxstart;
+    if (elapsed >= BYTE_US) {
+      clockBits(elapsed, rxlevel);
+    }
+  }
+  sei();
+
+  bool fresh = false;
+  while (rxtail != rxhead) {
+    uint8_t c = rxbuffer[rxtail];
+    rxtail    = (rxtail + 1) & (RX_BUFFER - 1);
+    if (parseSerialByte(c, command)) {
+      fresh = true;
+    }
+  }
+  return fresh;
+}
+
+// Add one byte to the frame, true if it completed a valid new command. On a
+// bad frame, resync at the next sync byte inside it.
+bool parseSerialByte(uint8_t c, SerialCommand *command) {
+  if (framelength == 0 && c != COMMAND_SYNC) {
+    return false;
+  }
+  frame[framelength++] = c;
+  if (framelength < COMMAND_LENGTH) {
+    return false;
+  }
+
+  if (commandCRC(frame, COMMAND_LENGTH - 1) != frame[COMMAND_LENGTH - 1]) {
+    uint8_t i = 1;
+    while (i < COMMAND_LENGTH && frame[i] != COMMAND_SYNC) {
+      i++;
+    }
+    framelength = COMMAND_LENGTH - i;
+    for (uint8_t j = 0; j < framelength; j++) {
+      frame[j] = frame[i + j];
+    }
+    return false;
+  }
+  framelength = 0;
+
+  // A repeated sequence number is a resend, not a new command
+  if (sequenceseen && frame[1] == lastsequence) {
+    return false;
+  }
+  lastsequence = frame[1];
+  sequenceseen = true;
+
+  command->sequence = frame[1];
+  command->armed    = frame[2] & COMMAND_ARMED;
+  command->left     = frame[3] | (frame[4] << 8);
+  command->right    = frame[5] | (frame[6] << 8);
+  return true;
+}
+
+// CRC-8, polynomial 0x07, initial value 0
+uint8_t commandCRC(const uint8_t *data, uint8_t length) {
+  uint8_t crc = 0;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered by any change on an enabled PORTA pin
+SIGNAL(PCINT0_vect) {
+  uint32_t now   = micros();
+  bool     level = PINA & (1 << SERIAL_RX);
+
+  if (level == rxlevel) {
+    return;
+  }
+
+  // Bits up to this edge were at the old level
+  if (rxbusy) {
+    clockBits(now - rxstart, rxlevel);
+  }
+
+  // A falling edge while idle is a start bit
+  if (!rxbusy && !level) {
+    rxbusy   = true;
+    rxstart  = now;
+    rxcenter = BIT_US16/2;
+    rxbit    = 0;
+  }
+  rxlevel = level;
+}
+
+#endif
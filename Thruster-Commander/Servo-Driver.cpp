@@ -36,31 +36,111 @@ THE SOFTWARE.
 -------------------------------*/
 
 #include "Servo-Driver.h"
+#include "DShot-Driver.h"
+#include "PWM-Scheduler.h"
 #include "Thruster-Commander.h"
 
-void writePWM(int pin, int pulsewidth) {
-  // Stop interrupts while changing pwm settings
-  cli();
+// Timer1 settings of each protocol. Commands stay in 1000-2000 us; OneShot
+// pulses are that divided by 8 (OneShot125) or 24 (OneShot42). The faster
+// protocols run timer1 at the full clock for finer steps. For DShot timer1
+// only paces the frames, the pins are driven by sendDShot().
+#define PERIOD_OF(p)    ((p) == PROTOCOL_PWM50      ? 20000 :             \
+                         (p) == PROTOCOL_PWM400     ? 2500  :             \
+                         (p) == PROTOCOL_ONESHOT125 ? 500   :             \
+                         (p) == PROTOCOL_ONESHOT42  ? 200   : 1000) // us
+#define PRESCALE_OF(p)  ((p) == PROTOCOL_PWM50                            \
+                         || (p) == PROTOCOL_DSHOT150 ? 8 : 1)
+#define DIVIDER_OF(p)   ((p) == PROTOCOL_ONESHOT125 ? 8 :                 \
+                         (p) == PROTOCOL_ONESHOT42  ? 24 : 1)
+#define CNT_PER_US(p)   (CLOCK_FREQ/1000000/PRESCALE_OF(p))   // timer counts
+#define LEAD_OF(p)      (FRAME_LEAD < PERIOD_OF(p)/2 ? FRAME_LEAD         \
+                                                     : PERIOD_OF(p)/2)  // us
+
+// With more than two channels, or with I2C_TARGET taking OC1A's pin for SDA,
+// every output comes from the PWM scheduler and timer1 runs in CTC mode,
+// where ICR1 as TOP sets ICF1 instead of TOV1
+#if PWM_SCHEDULED
+#define FRAME_FLAG      ICF1
+#else
+#define FRAME_FLAG      TOV1
+#endif
+
+// Everything writePWM() and pwmFrameDue() need, worked out at compile time
+#define PROTOCOL(p) {                                                     \
+  (uint16_t)(PERIOD_OF(p)*CNT_PER_US(p) - 1),                             \
+  (uint8_t)(PRESCALE_OF(p) == 8 ? (1 << CS11) : (1 << CS10)),             \
+  (uint32_t)(((CNT_PER_US(p) << 16) + DIVIDER_OF(p) - 1)/DIVIDER_OF(p)),  \
+  (uint16_t)((PERIOD_OF(p) - LEAD_OF(p))*CNT_PER_US(p)),                  \
+  (p) == PROTOCOL_DSHOT150 }
+
+namespace {
+struct Protocol {
+  uint16_t top;       // ICR1, counts per frame - 1
+  uint8_t  clock;     // TCCR1B clock select bits
+  uint32_t scale;     // compare counts per us of command, << 16
+  uint16_t due;       // counter value from which an update is due
+  bool     dshot;     // frames sent from the overflow interrupt
+};
+
+Protocol          protocol = PROTOCOL(PWM_PROTOCOL);
+#if PWM_DSHOT
+volatile bool     dshotframe;   // a DShot frame went out since the update
+#endif
+#if I2C_TARGET || RC_INPUT
+volatile bool     syncdue;      // a bus sync or a receiver frame wants an
+                                //   update right away
+#endif
 
+// Timer counts for a pulse width already in range
+uint16_t countsFor(int pulsewidth) {
+  return ((uint32_t)pulsewidth * protocol.scale) >> 16;
+}
+}
+
+void writePWM(int pin, int pulsewidth) {
   // Constrain pulsewidth to pwm range if > 0, otherwise set to neutral
   pulsewidth = (pulsewidth > 0) ? constrain(pulsewidth, PWM_MIN, PWM_MAX)
                : PWM_NEUTRAL;
 
+#if PWM_DSHOT
+  if (protocol.dshot) {
+    writeDShot(pin, dshotPacket(dshotThrottle(pulsewidth)));
+    return;
+  }
+#endif
+
+  // Scale to timer counts for the protocol in use
+  uint16_t counts = countsFor(pulsewidth);
+
+#if PWM_SCHEDULED
+  schedulePWM(pin, counts);
+#else
+  // Stop interrupts while changing pwm settings
+  cli();
+
   if (pin == OC1A_PIN) {
     // Set timer1 Output Compare Register A
     // Set shut-off counter value to get pulsewidth us pulse
-    OCR1A = (pulsewidth * CNT_PER_US) - 1;
+    OCR1A = counts - 1;
   } else if (pin == OC1B_PIN) {
     // Set timer1 Output Compare Register B
     // Set shut-off counter value to get pulsewidth us pulse
-    OCR1B = (pulsewidth * CNT_PER_US) - 1;
+    OCR1B = counts - 1;
   }
 
   // Done setting timers -> allow interrupts again
   sei();
+#endif
 }
 
-void initializePWMController() {
+// Set up timer1 for one of the PROTOCOL_ values. Only PWM_PROTOCOL and
+// PWM_PROTOCOL_ALT are built in, anything else gets PWM_PROTOCOL.
+void initializePWMController(uint8_t mode) {
+  const Protocol alternate = PROTOCOL(PWM_PROTOCOL_ALT);
+  if (mode == PWM_PROTOCOL_ALT) {
+    protocol = alternate;
+  }
+
   // Stop interrupts while changing timer settings
   cli();
 
@@ -69,20 +149,181 @@ void initializePWMController() {
   TCCR1B  = 0;
   TCCR1C  = 0;
 
-  // Set non-inverting Fast PWM mode on A and B
-  TCCR1A |= (1 << COM1A1);
-  TCCR1A |= (1 << COM1B1);
+#if PWM_SCHEDULED
+  // Set CTC mode (compare to ICR1), the pins are driven by the scheduler
+  TCCR1B |= (1 << WGM12);
+  TCCR1B |= (1 << WGM13);
+#else
+  // Set non-inverting Fast PWM mode on A and B, unless sending DShot
+  if (!protocol.dshot) {
+    TCCR1A |= (1 << COM1A1);
+    TCCR1A |= (1 << COM1B1);
+  }
   // Set Fast PWM mode (compare to ICR1)
   TCCR1A |= (1 << WGM11);
   TCCR1B |= (1 << WGM12);
   TCCR1B |= (1 << WGM13);
-  // Set timer1 clock source to prescaler 8
-  TCCR1B |= (1 << CS11);
+#endif
 
   // Set timer1 Input Capture Register
-  // Set end counter value to get a PWM_FREQ Hz timer
-  ICR1    = (PERIOD  * CNT_PER_US) - 1;
+  // Set end counter value to get the protocol's frame rate
+  ICR1    = protocol.top;
+
+  // Send neutral from the very first frame. The compare registers latch at
+  // BOTTOM, so park the counter at TOP: its first tick is a BOTTOM.
+#if PWM_SCHEDULED
+  initializePWMScheduler(countsFor(PWM_NEUTRAL), countsFor(PWM_EDGE_SPIN));
+#else
+  forceNeutralPWM();
+#endif
+  TCNT1   = protocol.top;
+
+  // Clear the frame flag, pwmFrameDue() uses it to mark each new frame
+  TIFR1   = (1 << FRAME_FLAG);
+
+#if PWM_DSHOT
+  // DShot: send stop frames from the overflow interrupt until told otherwise
+  if (protocol.dshot) {
+    TIMSK1 |= (1 << TOIE1);
+  }
+#endif
+
+  // Set timer1 clock source to the protocol's prescaler, starting it
+  TCCR1B |= protocol.clock;
 
   // Done setting timers -> allow interrupts again
   sei();
 }
+
+// Neutral on every output from the next frame on, whatever loop() is doing.
+// Safe to call from an interrupt.
+void forceNeutralPWM() {
+#if PWM_DSHOT
+  if (protocol.dshot) {
+    writeDShot(OC1A_PIN, dshotPacket(0));
+    writeDShot(OC1B_PIN, dshotPacket(0));
+    return;
+  }
+#endif
+
+#if PWM_SCHEDULED
+  forceNeutralScheduler();
+#else
+  uint16_t counts = countsFor(PWM_NEUTRAL);
+
+  // Stop interrupts while changing pwm settings, then put them back as they
+  // were
+  uint8_t sreg = SREG;
+  cli();
+  OCR1A = counts - 1;
+  OCR1B = counts - 1;
+  SREG  = sreg;
+#endif
+}
+
+// True once per PWM frame, FRAME_LEAD us before the frame ends. The compare
+// registers latch at BOTTOM, so values written now go out with the very next
+// pulse. TOV1 is set at TOP and stays set until the update has run, so a
+// frame missed by a long loop() pass is picked up in the following one.
+// At the faster protocols an update spans several frames and runs as often
+// as it can. With DShot the overflow interrupt takes TOV1, so it leaves its
+// own flag, and with the scheduler it is ICF1. A bus sync or the end of a
+// receiver frame makes one due straight away.
+bool pwmFrameDue() {
+  bool due = false;
+  uint16_t count;
+
+  // Stop interrupts while reading the 16-bit counter. Read the flag first:
+  // the counter sits at TOP as the flag gets set, which must not count as due.
+  cli();
+#if PWM_DSHOT
+  if (protocol.dshot ? dshotframe : (TIFR1 & (1 << FRAME_FLAG))) {
+#else
+  if (TIFR1 & (1 << FRAME_FLAG)) {
+#endif
+    count = TCNT1;
+#if I2C_TARGET
+    // A sync moves TOP for one frame, to below protocol.top at times
+    due   = count >= protocol.due && count < ICR1;
+#else
+    due   = count >= protocol.due && count < protocol.top;
+#endif
+  }
+#if I2C_TARGET
+  if (syncdue) {
+    due     = true;
+    syncdue = false;
+  }
+#endif
+  if (due) {
+    TIFR1      = (1 << FRAME_FLAG);
+#if PWM_DSHOT
+    dshotframe = false;
+#endif
+  }
+#if RC_INPUT
+  // A receiver frame's update leaves the flag for the frame's own, unless
+  // lockPWMFrame() moved the frame to its due point and took the flag
+  if (syncdue) {
+    due     = true;
+    syncdue = false;
+  }
+#endif
+  sei();
+
+  return due;
+}
+
+#if I2C_TARGET
+// Start a frame I2C_SYNC_LEAD from now and have pwmFrameDue() call for an
+// update at once, so the command just taken goes out with that frame. Every
+// target on the bus does the same at the same sync. Called from the I2C
+// interrupt.
+void syncPWMFrame() {
+  resyncScheduler(countsFor(I2C_SYNC_LEAD));
+  TIFR1   = (1 << FRAME_FLAG);
+  syncdue = true;
+}
+#endif
+
+#if RC_INPUT
+// Have pwmFrameDue() call for an update at once, and end this frame at the
+// point an update is due in it, so a receiver frame just measured goes out
+// with the very next pulses. Only a frame more than half gone, with its
+// pulses over, is cut short: ESCs never see a pulse stretched, or pulses
+// closer than half a frame. Any other frame runs its course. Returns the
+// counts skipped. Called from the pin change interrupt.
+uint16_t lockPWMFrame() {
+  syncdue = true;
+#if PWM_SCHEDULED
+  return 0;
+#else
+#if PWM_DSHOT
+  if (protocol.dshot) {
+    return 0;
+  }
+#endif
+  uint16_t count = TCNT1;
+  if (count <= (protocol.top >> 1) || count >= protocol.due
+      || count <= OCR1A || count <= OCR1B) {
+    return 0;
+  }
+  TCNT1 = protocol.due;
+  TIFR1 = (1 << FRAME_FLAG);
+  return protocol.due - count;
+#endif
+}
+#endif
+
+#if PWM_DSHOT
+///////////////////////////////
+// Interrupt Service Routine //
+///////////////////////////////
+
+// Triggered at TOP when sending DShot. Interrupts stay off while the frame
+// goes out, so the LED and ADC interrupts wait instead of stretching bits.
+SIGNAL(TIM1_OVF_vect) {
+  sendDShot();
+  dshotframe = true;
+}
+#endif
@@ -38,11 +38,17 @@ THE SOFTWARE.
 #ifndef SERVODRIVER
 #define SERVODRIVER
 
+#include <Arduino.h>
+
 #define OC1A_PIN  6
 #define OC1B_PIN  5
 
 // Function Declarations
 void writePWM(int pin, int pulsewidth);
-void initializePWMController();
+void initializePWMController(uint8_t mode);
+bool pwmFrameDue();
+void forceNeutralPWM();
+void syncPWMFrame();
+uint16_t lockPWMFrame();
 
 #endif
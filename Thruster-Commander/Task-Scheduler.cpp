@@ -0,0 +1,138 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Task Scheduler
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Task-Scheduler.h"
+
+namespace {
+const Task *tasks;
+uint8_t     taskcount;
+uint16_t    releases[TASK_MAX];     // tick of each task's next release
+TaskStats   stats[TASK_MAX];
+
+void count(uint16_t *counter) {
+  if (*counter < 0xFFFF) {
+    (*counter)++;
+  }
+}
+
+// Released at or before tick now, always without a period
+bool released(uint8_t task, uint16_t now) {
+  return tasks[task].period == 0 || (int16_t)(now - releases[task]) >= 0;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+// Start the table's phases from now. The table has to stay put.
+void initializeTasks(const Task *table, uint8_t count) {
+  uint16_t now = taskTick();
+
+  tasks     = table;
+  taskcount = (count < TASK_MAX) ? count : TASK_MAX;
+  for (uint8_t i = 0; i < taskcount; i++) {
+    releases[i] = now + tasks[i].phase;
+    memset(&stats[i], 0, sizeof(stats[i]));
+  }
+}
+
+// Ticks are whole milliseconds, compared with wrapping 16-bit arithmetic, so
+// no release may be more than 32 s away
+uint16_t taskTick() {
+  return millis();
+}
+
+// Run the first task in the table that is released and ready. False if none
+// was, and loop() has nothing to do until the next interrupt.
+bool runTasks() {
+  uint16_t now = taskTick();
+
+  for (uint8_t i = 0; i < taskcount; i++) {
+    const Task& task = tasks[i];
+    if (!released(i, now) || (task.ready && !task.ready())) {
+      continue;
+    }
+
+    // Periodic tasks released as well wait for a later pass
+    for (uint8_t j = i + 1; j < taskcount; j++) {
+      if (tasks[j].period && released(j, now)) {
+        count(&stats[j].deferred);
+      }
+    }
+
+    // Move on to the next release still ahead, counting any gone by
+    TaskStats& s = stats[i];
+    if (task.period) {
+      uint16_t late = now - releases[i];
+      if (late > s.maxlate) {
+        s.maxlate = late;
+      }
+      releases[i] += task.period;
+      while (released(i, now)) {
+        releases[i] += task.period;
+        count(&s.missed);
+      }
+    }
+
+    uint32_t start = micros();
+    task.run();
+    uint32_t us    = micros() - start;
+
+    count(&s.runs);
+    if (us > s.maxrun) {
+      s.maxrun = (us < 0xFFFF) ? us : 0xFFFF;
+    }
+    if (us > task.budget) {
+      count(&s.overruns);
+    }
+    return true;
+  }
+  return false;
+}
+
+uint8_t taskCount() {
+  return taskcount;
+}
+
+const Task& taskEntry(uint8_t task) {
+  return tasks[task];
+}
+
+const TaskStats& taskStats(uint8_t task) {
+  return stats[task];
+}
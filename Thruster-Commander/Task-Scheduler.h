@@ -0,0 +1,75 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Task Scheduler
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef TASKSCHEDULER
+#define TASKSCHEDULER
+
+#include <Arduino.h>
+#include "Thruster-Commander.h"
+
+// One row of the task table, which loop() works through in priority order.
+// A task is released every period ticks (ms), the first time phase ticks
+// after initializeTasks(), or on every pass with a period of 0. Once
+// released it runs as soon as no earlier row is due and ready(), if it has
+// one, says it can.
+struct Task {
+  void      (*run)();
+  bool      (*ready)();         // 0: always ready
+  uint16_t  period;             // ticks, 0: released on every pass
+  uint16_t  phase;              // ticks to the first release
+  uint16_t  budget;             // us a run may take
+};
+
+// What each task did since initializeTasks(). Counts stop at 65535.
+struct TaskStats {
+  uint16_t  runs;
+  uint16_t  deferred;           // released, but an earlier row ran first
+  uint16_t  missed;             // releases gone by before it ran
+  uint16_t  overruns;           // runs over budget
+  uint16_t  maxrun;             // us
+  uint16_t  maxlate;            // ticks from a release to its run
+};
+
+// Function Declarations
+void             initializeTasks(const Task *table, uint8_t count);
+uint16_t         taskTick();
+bool             runTasks();
+uint8_t          taskCount();
+const Task&      taskEntry(uint8_t task);
+const TaskStats& taskStats(uint8_t task);
+
+#endif
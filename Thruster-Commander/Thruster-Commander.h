@@ -47,17 +47,63 @@ THE SOFTWARE.
 #define INPUT_STR   A1  // Steering
 #define SWITCH      4
 #define PWM_L       5
-#define PWM_R       6
 #define LED_L       8
 #define LED_R       7
 #define DETECT      0
+#ifndef I2C_TARGET
+#define I2C_TARGET  0                 // 1: take commands over I2C on the USI
+#endif                                //    pins, SCL on SWITCH and SDA on PA6.
+                                      //    PWM_R moves to PB1, and turning
+                                      //    the switch on grounds SCL, which
+                                      //    stops the whole bus.
+#if I2C_TARGET && !I2C_REWIRED
+#error "I2C_TARGET: move the right ESC to PB1 and keep the switch off, then set I2C_REWIRED"
+#endif
+#if I2C_TARGET
+#define PWM_R       9                 // PB1, PA6 is SDA
+#else
+#define PWM_R       6
+#define PWM_3       9                 // PB1, with PWM_CHANNELS of 3 or more
+#define PWM_4       10                // PB0, with PWM_CHANNELS of 4
+#endif
 
 // PWM GENERATION DEFINITIONS
-#define PWM_FREQ    50                // Hz
-#define PERIOD      1000000/PWM_FREQ  // us
-#define PRESCALE    8                 // must match TCCR1B settings
 #define CLOCK_FREQ  8000000ul         // Hz
-#define CNT_PER_US  1                 // CLOCK_FREQ/PRESCALE/1000000 timer counts
+
+// ESC OUTPUT PROTOCOLS
+#define PROTOCOL_PWM50      0         // 1000-2000 us pulses at 50 Hz
+#define PROTOCOL_PWM400     1         // 1000-2000 us pulses at 400 Hz
+#define PROTOCOL_ONESHOT125 2         // 125-250 us pulses at 2 kHz
+#define PROTOCOL_ONESHOT42  3         // 41.7-83.3 us pulses at 5 kHz
+#define PROTOCOL_DSHOT150   4         // DShot150 frames at 1 kHz
+#ifndef PWM_PROTOCOL
+#define PWM_PROTOCOL     PROTOCOL_PWM50
+#endif
+#ifndef PWM_PROTOCOL_ALT              // used instead if SWITCH is enabled
+#define PWM_PROTOCOL_ALT PWM_PROTOCOL //   at power-up
+#endif
+#define PWM_DSHOT   (PWM_PROTOCOL == PROTOCOL_DSHOT150                    \
+                     || PWM_PROTOCOL_ALT == PROTOCOL_DSHOT150)
+                                      // DShot driver and its interrupt are
+                                      //   only built in when either uses it
+#ifndef DSHOT_3D
+#define DSHOT_3D    1                 // 1: DShot ESCs set to 3D (bidirectional)
+#endif
+
+// OUTPUT CHANNELS
+#ifndef PWM_CHANNELS
+#define PWM_CHANNELS    2             // 3-4: every output from the software
+#endif                                //   scheduler, adding PWM_3 and PWM_4
+#define PWM_EDGE_SPIN   16            // us, closer edges are waited out in
+                                      //   the scheduler's interrupt
+#define PWM_SCHEDULED   (PWM_CHANNELS > 2 || I2C_TARGET)
+#if PWM_SCHEDULED && (PWM_PROTOCOL > PROTOCOL_PWM400                      \
+                      || PWM_PROTOCOL_ALT > PROTOCOL_PWM400)
+#error "PWM_CHANNELS above 2 and I2C_TARGET need PWM50 or PWM400 pulses"
+#endif
+#if I2C_TARGET && PWM_CHANNELS > 2
+#error "I2C_TARGET leaves no pins for PWM_CHANNELS above 2"
+#endif
 
 // PWM OUTPUT CHARACTERISTICS
 #define PWM_MAX     2000              // us
@@ -68,21 +114,169 @@ THE SOFTWARE.
 #define DEADZONE    25                // us
 #define POT_OFFSET  -12               // adc counts
 
+// ADC SAMPLING
+#define ADC_SCALE   4                 // sampler counts per adc count
+#define ADC_MAX     (1023*ADC_SCALE)  // sampler counts at full scale
+
+// RESPONSE CURVES
+#define CURVE_LINEAR  0               // output follows the pot
+#define CURVE_EXPO    1               // half the response around neutral
+#define CURVE_THRUST  2               // square root, thrust follows the pot
+#ifndef THROTTLE_CURVE
+#define THROTTLE_CURVE  CURVE_LINEAR  // L, R and SPD pots
+#endif
+#ifndef STEERING_CURVE
+#define STEERING_CURVE  CURVE_LINEAR  // STR pot
+#endif
+
+// MIXING
+#define DESAT_CLIP          0         // each side clipped on its own
+#define DESAT_STEERING      1         // keep the steering, give up throttle
+#define DESAT_THROTTLE      2         // keep the throttle, give up steering
+#define DESAT_PROPORTIONAL  3         // scale both, keeping their ratio
+#ifndef MIXER_DESATURATE
+#define MIXER_DESATURATE DESAT_CLIP   // when the arcade mix asks an output
+#endif                                //   for more than it can give. Clipping
+                                      //   loses steering at full throttle;
+                                      //   DESAT_STEERING keeps it all.
+
+// SERIAL COMMANDS
+#ifndef SERIAL_COMMAND
+#define SERIAL_COMMAND  0             // 1: take commands on SERIAL_RX, the
+#endif                                //    STR pin, which then never counts
+                                      //    as a connected pot
+#define SERIAL_RX       INPUT_STR     // shared with the steering pot
+#define SERIAL_BAUD     9600          // bits/s
+#define SERIAL_TIMEOUT  200           // ms without a command to go neutral
+
+// I2C TARGET
+#define I2C_ADDRESS     0x2A          // 7-bit, unless set in EEPROM
+#define I2C_EEPROM      128           // EEPROM address of the bus address
+#define I2C_SYNC        0x5C          // general call byte applying commands
+#define I2C_SYNC_LEAD   3000          // us from a sync to the frame applying
+                                      //   it (more than PWM_MAX)
+#define I2C_TIMEOUT     200           // ms without a sync to go neutral
+#define I2C_BUS_TIMEOUT 25            // ms a transfer may stall mid-way before
+                                      //   it is dropped, letting go of SDA
+
+// RC RECEIVER INPUT
+#ifndef RC_INPUT
+#define RC_INPUT        0             // 1: servo pulses from a receiver on
+#endif                                //    an input pin replace its pot. A
+                                      //    pin held at ground counts as
+                                      //    disconnected. With FRAME_SYNC
+                                      //    the outputs also lock to the
+                                      //    receiver's frames.
+#define RC_PULSE_MIN    800           // us, shorter or longer pulses are
+#define RC_PULSE_MAX    2200          //   glitches
+#define RC_FRAME_MIN    2500          // us, pulse start to pulse start
+#define RC_FRAME_MAX    40000
+#define RC_GLITCH       300           // us, a bigger jump needs a second
+                                      //   pulse to confirm it
+#define RC_DETECT_PULSES 5            // good pulses in a row for a receiver
+#define RC_TIMEOUT      100           // ms without a good pulse to go
+                                      //   neutral
+#if RC_INPUT && (SERIAL_COMMAND || I2C_TARGET)
+#error "RC_INPUT shares the input pins and their pin change interrupt"
+#endif
+
+// TIMING STATISTICS
+#ifndef TIMING_STATS
+#define TIMING_STATS    0             // 1: time the control path on Timer1,
+#endif                                //    saved to EEPROM each time the
+                                      //    switch goes off at neutral
+#define TIMING_EEPROM   0             // EEPROM address of the snapshot
+
+// BLACK BOX RECORDER
+#ifndef BLACK_BOX
+#define BLACK_BOX       0             // 1: log the control path to EEPROM.
+#endif                                //    Opt-in, as it wears the EEPROM:
+                                      //    with the sticks always moving
+                                      //    the most written byte lasts
+                                      //    about 120 h, make blackbox has
+                                      //    the figure. Held sticks only
+                                      //    add to a run count.
+#define BLACK_BOX_EEPROM  256         // EEPROM address of the log
+#define BLACK_BOX_BLOCKS  4           // blocks written in turn, the oldest
+#define BLACK_BOX_BLOCK   64          //   over next (bytes each)
+#define BLACK_BOX_DT      250         // ms between samples
+#define BLACK_BOX_STEP    16          // adc counts or us a value moves to be
+                                      //   logged
+#define BLACK_BOX_RING    32          // bytes waiting in RAM for EEPROM
+#define BLACK_BOX_BATCH   16          // bytes to start writing, or
+#define BLACK_BOX_HOLD    1000        //   ms the oldest may wait
+
+// POWER SAVING
+#ifndef SLEEP_IDLE
+#define SLEEP_IDLE      0             // 1: idle the CPU between loop() passes
+#endif                                //    and stop sampling while disabled
+                                      //    at neutral, which delays the
+                                      //    first update after switching on.
+                                      //    Idle sleep only, the deeper
+                                      //    modes stop the timers.
+
 // DETECT PARAMETERS
 #define DETECT_LOW  20                // adc counts
 #define DETECT_HIGH 1003              // adc counts
+#define DETECT_SETTLE   10            // ms, DETECT drive to sample
+#define DETECT_DEBOUNCE 2             // consistent results to change state
 
 // BLINKER CHARACTERISTICS
 #define PERIOD_MIN  200               // ms
 #define PERIOD_MAX  2000              // ms
 
 // ACCELERATION CONTROL
-#define MAX_ACCEL   (HALF_RANGE/0.8f) // us/s
+#define MAX_ACCEL   (HALF_RANGE*5/4)  // us/s (half range in 0.8 s)
+#ifndef SCURVE_LIMITER
+#define SCURVE_LIMITER  0             // 1: jerk limited SCurveLimiter instead
+#endif
+#define SCURVE_SPEEDUP  (HALF_RANGE*5/2)  // us/s, moving away from neutral
+#define SCURVE_SLOWDOWN (HALF_RANGE*4)    // us/s, moving towards neutral
+#define SCURVE_REVERSAL (HALF_RANGE*5/4)  // us/s, within SCURVE_BAND of it
+#define SCURVE_BAND     (2*DEADZONE)      // us
+#define SCURVE_JERK     (HALF_RANGE*20)   // us/s^2
 
 // PWM UPDATE RATE
-#define UPDATE_DT   0.050f            // s
+#define UPDATE_DT   50                // ms
+#ifndef FRAME_SYNC
+#define FRAME_SYNC  I2C_TARGET        // 1: update once per PWM frame instead
+#endif                                //    of every UPDATE_DT, FRAME_LEAD
+                                      //    before the pulses go out
+#define FRAME_LEAD  2000              // us, update this long before a pulse
+                                      //   (at most half a frame)
+#if I2C_TARGET && !FRAME_SYNC
+#error "I2C_TARGET applies each sync on the next frame, so needs FRAME_SYNC"
+#endif
 
 // DETECT RATE
-#define DETECT_DT   0.250f            // s
+#define DETECT_DT   250               // ms
+#define DETECT_TICK 5                 // ms between detect() steps
+
+// TASK SCHEDULER
+#define TASK_MAX          4           // rows the task table can have
+#define UPDATE_BUDGET     250         // us a run of each task may take
+#define DETECT_BUDGET     100
+#define INDICATOR_BUDGET  150
+#define BLACK_BOX_BUDGET  50
+#define INDICATOR_DT      50          // ms between LED refreshes
+#define BLACK_BOX_FLUSH_DT 5          // ms between black box EEPROM writes
+#define DETECT_PHASE      2           // ms, releases of periodic tasks at
+#define INDICATOR_PHASE   4           //   these ticks mod 5, the update's
+#define BLACK_BOX_PHASE   1           //   (without FRAME_SYNC) at 0
+
+// FAILSAFE
+#ifndef FAILSAFE
+#define FAILSAFE        0             // 1: a 16 ms watchdog, fed every pass,
+#endif                                //    and update and ADC checks force
+                                      //    neutral on a fault; a second
+                                      //    missed feed resets the part. Not
+                                      //    yet timed on a board.
+#if FRAME_SYNC
+#define TICK_DEADLINE   30            // ms between updates before an overrun
+#else
+#define TICK_DEADLINE   (UPDATE_DT+20)
+#endif
+#define ADC_STALL       10            // ms without a new reading
+#define FAILSAFE_EEPROM 120           // EEPROM address of the reset log
 
 #endif
@@ -40,158 +40,629 @@ THE SOFTWARE.
 #include "Servo-Driver.h"
 #include "Indicator.h"
 #include "Limiter.h"
+#include "SCurve-Limiter.h"
+#include "ADC-Sampler.h"
+#include "Mapping.h"
+#include "Mixer.h"
+#include "Serial-Command.h"
+#include "Timing-Stats.h"
+#include "Power-Saving.h"
+#include "Failsafe.h"
+#include "I2C-Target.h"
+#include "RC-Input.h"
+#include "Black-Box.h"
+#include "Task-Scheduler.h"
 
 // Global Variable Declaration
 bool      inLIsConnected, inRIsConnected, inSPDIsConnected, inSTRIsConnected;
+#if SCURVE_LIMITER
+SCurveLimiter limiterL, limiterR;
+#else
 Limiter   limiterL, limiterR;
-uint32_t  lastpwmupdateruntime  = 0;
-uint32_t  lastdetectruntime     = 0;
+#endif
+
+// Outputs and patterns of the latest update, for the LEDs
+int       indicatedL            = PWM_NEUTRAL;
+int       indicatedR            = PWM_NEUTRAL;
+uint16_t  indicatedpatternL     = BLINK_S;
+uint16_t  indicatedpatternR     = BLINK_S;
+
+#if SERIAL_COMMAND
+// Latest command from a companion computer, if one ever arrived
+SerialCommand command;
+bool      commandseen           = false;
+uint32_t  lastcommandtime       = 0;
+#endif
+
+// Detect runs one phase per step so it never holds up the PWM update, with
+// a step every DETECT_TICK
+enum { DETECT_START, DETECT_SETTLE_HIGH, DETECT_SAMPLE_HIGH,
+       DETECT_SETTLE_LOW, DETECT_SAMPLE_LOW };
+uint8_t   detectphase           = DETECT_START;
+uint8_t   detectwait            = 0;  // steps before the next phase
+bool      detectclassified      = false;
+uint8_t   inLCount, inRCount, inSPDCount, inSTRCount;
+
+#if I2C_TARGET
+// Latest command from the bus master, made current by its latest sync
+I2CCommand buscommand;
+bool      busseen               = false;
+uint32_t  lastbustime           = 0;
+#endif
+
+#if SLEEP_IDLE
+// The sampler is stopped while disabled at neutral, and after starting again
+// the inputs count as disabled until every one has a fresh reading
+bool      lowpower              = false;
+bool      warming               = false;
+#endif
+
+#if TIMING_STATS
+// Counters are saved once per time the switch goes off, not at power-up
+bool      timingsaved           = true;
+#endif
+
+// What loop() runs, in priority order. The phases keep the periodic tasks
+// on separate ticks. With FRAME_SYNC the update is released on every pass
+// and runs once the PWM frame calls for it.
+enum { TASK_UPDATE, TASK_DETECT, TASK_INDICATOR,
+#if BLACK_BOX
+       TASK_BLACK_BOX,
+#endif
+       TASK_COUNT };
+const Task tasks[TASK_COUNT] = {
+  // run, ready, period, phase, budget
+#if FRAME_SYNC
+  { updateOutputs, pwmFrameDue, 0, 0, UPDATE_BUDGET },
+#else
+  { updateOutputs, 0, UPDATE_DT, 0, UPDATE_BUDGET },
+#endif
+  { detect, 0, DETECT_TICK, DETECT_PHASE, DETECT_BUDGET },
+  { refreshIndicator, 0, INDICATOR_DT, INDICATOR_PHASE, INDICATOR_BUDGET },
+#if BLACK_BOX
+  { flushBlackBox, 0, BLACK_BOX_FLUSH_DT, BLACK_BOX_PHASE, BLACK_BOX_BUDGET }
+#endif
+};
 
 
 void setup() {
-  // Set up pin modes
+#if TIMING_STATS
+  initializeTimingStats();
+#endif
+
+  // Initialize motor controllers first, so neutral pulses go out from the
+  // first frame. Holding SWITCH enabled at power-up picks the alternate
+  // output protocol.
+#if !I2C_TARGET
+  pinMode(SWITCH,INPUT);
+#endif
+  pinMode(PWM_L,OUTPUT);
+  pinMode(PWM_R,OUTPUT);
+#if PWM_CHANNELS > 2
+  pinMode(PWM_3,OUTPUT);
+#endif
+#if PWM_CHANNELS > 3
+  pinMode(PWM_4,OUTPUT);
+#endif
+  initializePWMController((readSwitch() == LOW) ? PWM_PROTOCOL_ALT
+                                                : PWM_PROTOCOL);
+
+#if FAILSAFE
+  // Watch for hangs from here on, and log why the last run ended
+  initializeFailsafe();
+#endif
+
+  // Set up the other pin modes
   pinMode(INPUT_L,INPUT);
   pinMode(INPUT_R,INPUT);
   pinMode(INPUT_SPD,INPUT);
   pinMode(INPUT_STR,INPUT);
-  pinMode(SWITCH,INPUT);
   pinMode(DETECT,OUTPUT);
-  pinMode(PWM_L,OUTPUT);
-  pinMode(PWM_R,OUTPUT);
   pinMode(LED_L,OUTPUT);
   pinMode(LED_R,OUTPUT);
 
-  // Initialize motor controllers
-  initializePWMController();
+  // Start sampling inputs in the background
+  initializeADCSampler();
+
+#if SLEEP_IDLE
+  // Sleep between loop() passes with nothing to do
+  initializePowerSaving();
+#endif
+
+#if SERIAL_COMMAND
+  // Listen for commands from a companion computer
+  initializeSerialCommand();
+#endif
+
+#if I2C_TARGET
+  // Take commands from a bus master, on the SWITCH pin and PA6
+  initializeI2CTarget();
+#endif
+
+#if RC_INPUT
+  // Measure pulses from a receiver on any input pin
+  initializeRCInput();
+#endif
+
+#if BLACK_BOX
+  // Log the control path, after what is already in EEPROM
+  initializeBlackBox();
+#endif
 
   // Initialize LEDs
   initializeLEDs();
   writeBlinker(BLINK_S);
 
   // Initialize PWM acceleration limiters
+#if SCURVE_LIMITER
+  limiterL = SCurveLimiter(SCURVE_SPEEDUP, SCURVE_JERK, PWM_NEUTRAL);
+  limiterR = SCurveLimiter(SCURVE_SPEEDUP, SCURVE_JERK, PWM_NEUTRAL);
+  limiterL.setDirectionalLimits(PWM_NEUTRAL, SCURVE_BAND, SCURVE_SPEEDUP,
+                                SCURVE_SLOWDOWN, SCURVE_REVERSAL);
+  limiterR.setDirectionalLimits(PWM_NEUTRAL, SCURVE_BAND, SCURVE_SPEEDUP,
+                                SCURVE_SLOWDOWN, SCURVE_REVERSAL);
+#else
   limiterL = Limiter(MAX_ACCEL, PWM_NEUTRAL);
   limiterR = Limiter(MAX_ACCEL, PWM_NEUTRAL);
+#endif
+
+  // Start the task phases, the first detect cycle starts DETECT_PHASE from
+  // now and live control waits for its result
+  initializeTasks(tasks, TASK_COUNT);
 }
 
 void loop() {
-  // Update PWM signals
-  if ((millis() - lastpwmupdateruntime) > UPDATE_DT*1000) {
-    int pwmL, pwmR, pwmSPD, pwmSTR;
-    int pwmOutL, pwmOutR;
-    int inputL, inputR, inputSPD, inputSTR, inputSWITCH;
-    uint16_t errorPtrn = 0;
-
-    // Record PWM update runtime
-    lastpwmupdateruntime = millis();
-
-    // Read switch
-    inputSWITCH = digitalRead(SWITCH);
-
-    // Read raw inputs
-    inputL   = analogRead(INPUT_L);
-    inputR   = analogRead(INPUT_R);
-    inputSPD = analogRead(INPUT_SPD);
-    inputSTR = analogRead(INPUT_STR);
-
-    // Map standard inputs to 1000-2000 µs range
-    pwmL   = map(inputL   - POT_OFFSET,0,1023,PWM_MIN,PWM_MAX);
-    pwmR   = map(inputR   - POT_OFFSET,0,1023,PWM_MIN,PWM_MAX);
-    pwmSPD = map(inputSPD - POT_OFFSET,0,1023,PWM_MIN,PWM_MAX);
-
-    // Map steering to +/- steering range
-    pwmSTR = map(inputSTR - POT_OFFSET,0,1023,-STEER_MAX,STEER_MAX);
-
-    // Logic:
-    // If SWITCH is pulled low (enabled):
-    //   If both L and R are connected:
-    //     L controls pwmOutL, R controls pwmOutR
-    //   If both SPD and STR are connected:
-    //     Mix SPD and STR to control pwmOutL and pwmOutR
-    //   If only L is connected:
-    //     L controls both pwmOutL and pwmOutR
-    //   If only R is connected:
-    //     R controls both pwmOutL and pwmOutR
-    if (inputSWITCH == LOW) {
-      if (inLIsConnected && inRIsConnected) {
-        pwmOutL = pwmL;
-        pwmOutR = pwmR;
-      } else if (inSPDIsConnected && inSTRIsConnected) {
-        pwmOutL = constrain(pwmSPD+pwmSTR,PWM_MIN,PWM_MAX);
-        pwmOutR = constrain(pwmSPD-pwmSTR,PWM_MIN,PWM_MAX);
-      } else if (inLIsConnected) {
-        pwmOutL = pwmL;
-        pwmOutR = pwmL;
-      } else if (inRIsConnected) {
-        pwmOutL = pwmR;
-        pwmOutR = pwmR;
-      } else {
-        pwmOutL   = PWM_NEUTRAL;
-        pwmOutR   = PWM_NEUTRAL;
-        errorPtrn = BLINK_2S;
-      }
+#if FAILSAFE && SLEEP_IDLE
+  // Feed the watchdog. Updates may slip a frame while sampling is stopped.
+  feedFailsafe(!lowpower);
+#elif FAILSAFE
+  feedFailsafe(true);
+#endif
+
+#if SERIAL_COMMAND
+  // Take in serial commands as they arrive
+  if (readSerialCommand(&command)) {
+    commandseen     = true;
+    lastcommandtime = millis();
+  }
+#endif
+
+#if SLEEP_IDLE
+  // Start sampling again as soon as the switch goes on, so the inputs are
+  // ready for the next update
+  if (lowpower && readSwitch() == LOW) {
+    startADCSampler();
+    lowpower = false;
+    warming  = true;
+  }
+#endif
+
+  // Run the first task due: the PWM update, a detect() step or the LEDs
+  if (runTasks()) {
+    return;
+  }
+
+#if SLEEP_IDLE
+  // Nothing was due, wait for an interrupt. With the sampler stopped only
+  // Timer0 wakes the CPU and an update can slip to the next frame, which
+  // is fine with the outputs held at neutral.
+  sleepUntilInterrupt();
+#endif
+}
+
+// Update PWM signals, in step with the PWM frame or every UPDATE_DT
+void updateOutputs() {
+  int pwmL, pwmR, pwmSPD, pwmSTR;
+  int pwmOutL, pwmOutR;
+  int inputL, inputR, inputSPD, inputSTR, inputSWITCH;
+  uint16_t errorPtrn = 0;
+  bool errorL = true, errorR = true;    // LEDs that show errorPtrn
+  TIMING_START(updatestart);
+
+#if FAILSAFE
+  tickFailsafe();
+#endif
+
+#if I2C_TARGET
+  // Take the command of the latest sync. Read here rather than at the top
+  // of loop(), so a sync that made this update due is never a pass late.
+  if (readI2CCommand(&buscommand)) {
+    busseen     = true;
+    lastbustime = millis();
+  }
+  checkI2CBus();
+#endif
+
+  // Read switch
+  inputSWITCH = readSwitch();
+
+#if SLEEP_IDLE
+  // Hold neutral until the sampler is running again and has fresh
+  // readings
+  if (lowpower) {
+    inputSWITCH = HIGH;
+  } else if (warming) {
+    if (adcSamplerReady()) {
+      warming     = false;
     } else {
+      inputSWITCH = HIGH;
+    }
+  }
+#endif
+
+  // Read oversampled inputs, kept up to date by the ADC interrupt
+  inputL   = readADCSampler(INPUT_L);
+  inputR   = readADCSampler(INPUT_R);
+  inputSPD = readADCSampler(INPUT_SPD);
+  inputSTR = readADCSampler(INPUT_STR);
+
+  // Map standard inputs to 1000-2000 µs range
+  pwmL   = mapThrottle(inputL);
+  pwmR   = mapThrottle(inputR);
+  pwmSPD = mapThrottle(inputSPD);
+
+  // Map steering to +/- steering range
+  pwmSTR = mapSteering(inputSTR);
+
+#if RC_INPUT
+  // A receiver's pulses replace the pot reading on their pin. L and SPD
+  // share a pin, so they share its channel too.
+  readRCInput();
+  if (rcInputActive(INPUT_L)) {
+    pwmL   = rcInputWidth(INPUT_L);
+    pwmSPD = pwmL;
+  }
+  if (rcInputActive(INPUT_R)) {
+    pwmR   = rcInputWidth(INPUT_R);
+  }
+  if (rcInputActive(INPUT_STR)) {
+    pwmSTR = mapPulseSteering(rcInputWidth(INPUT_STR));
+  }
+#endif
+
+  // Logic:
+  // If SWITCH is pulled low (enabled):
+  //   Until the first detect() cycle has classified the inputs:
+  //     Hold neutral
+  //   Otherwise the connected inputs pick a mixing mode (Mixer.cpp):
+  //     Both L and R: L controls pwmOutL, R controls pwmOutR
+  //     Both SPD and STR: SPD and STR mixed into pwmOutL and pwmOutR
+  //     Only L or only R: it controls both pwmOutL and pwmOutR
+  //     Nothing usable: hold neutral
+  if (inputSWITCH == LOW) {
+    if (!detectclassified) {
       pwmOutL   = PWM_NEUTRAL;
       pwmOutR   = PWM_NEUTRAL;
-      errorPtrn = BLINK_1L;
+      errorPtrn = BLINK_S;
+    } else {
+      uint8_t mode = mixerMode((inLIsConnected   ? MIX_CONNECTED_L   : 0)
+                               | (inRIsConnected   ? MIX_CONNECTED_R   : 0)
+                               | (inSPDIsConnected ? MIX_CONNECTED_SPD : 0)
+                               | (inSTRIsConnected ? MIX_CONNECTED_STR : 0));
+      int16_t mixinputs[MIX_INPUTS] = { (int16_t)(pwmL - PWM_NEUTRAL),
+                                        (int16_t)(pwmR - PWM_NEUTRAL),
+                                        (int16_t)(pwmSPD - PWM_NEUTRAL),
+                                        (int16_t)pwmSTR };
+      mixOutputs(mode, MIXER_DESATURATE, mixinputs, &pwmOutL, &pwmOutR);
+      if (mode == MIX_NEUTRAL) {
+        errorPtrn = BLINK_2S;
+      }
     }
+  } else {
+    pwmOutL   = PWM_NEUTRAL;
+    pwmOutR   = PWM_NEUTRAL;
+    errorPtrn = BLINK_1L;
+  }
 
-    // Limit acceleration
-    pwmOutL = limiterL.step(pwmOutL);
-    pwmOutR = limiterR.step(pwmOutR);
-
-    // Set pwm outputs
-    writePWM(PWM_L, pwmOutL);
-    writePWM(PWM_R, pwmOutR);
-
-    // Set LEDs
-    if (errorPtrn == 0) {
-      // No errors, display dimmer value
-      writeDimmer(LED_L, pwmOutL);
-      writeDimmer(LED_R, pwmOutR);
+#if RC_INPUT
+  // A receiver that stops sending good pulses gets neutral until it is
+  // back. Only the LED on the side of a lost channel blinks, both for
+  // steering.
+  if (inputSWITCH == LOW && rcInputLost()) {
+    pwmOutL   = PWM_NEUTRAL;
+    pwmOutR   = PWM_NEUTRAL;
+    errorPtrn = BLINK_3S;
+    errorL    = rcInputLost(INPUT_L) || rcInputLost(INPUT_STR);
+    errorR    = rcInputLost(INPUT_R) || rcInputLost(INPUT_STR);
+  }
+#endif
+
+#if SERIAL_COMMAND
+  // Once a companion computer has sent a command it takes priority over
+  // the pots. Without a fresh one go to neutral.
+  if (inputSWITCH == LOW && commandseen) {
+    errorPtrn = 0;
+    errorL    = errorR = true;
+    if (millis() - lastcommandtime > SERIAL_TIMEOUT) {
+      pwmOutL   = PWM_NEUTRAL;
+      pwmOutR   = PWM_NEUTRAL;
+      errorPtrn = BLINK_3S;
+    } else if (!command.armed) {
+      pwmOutL   = PWM_NEUTRAL;
+      pwmOutR   = PWM_NEUTRAL;
     } else {
-      // display error pattern
-      writeBlinker(errorPtrn);
+      pwmOutL   = constrain(command.left, PWM_MIN, PWM_MAX);
+      pwmOutR   = constrain(command.right, PWM_MIN, PWM_MAX);
     }
+  }
+#endif
+
+#if I2C_TARGET
+  // Armed over the bus, its commands replace the pots. Without a fresh
+  // sync go to neutral.
+  if (inputSWITCH == LOW) {
+    errorPtrn = 0;
+    errorL    = errorR = true;
+    if (millis() - lastbustime > I2C_TIMEOUT) {
+      pwmOutL   = PWM_NEUTRAL;
+      pwmOutR   = PWM_NEUTRAL;
+      errorPtrn = BLINK_3S;
+    } else {
+      pwmOutL   = constrain(buscommand.left, PWM_MIN, PWM_MAX);
+      pwmOutR   = constrain(buscommand.right, PWM_MIN, PWM_MAX);
+    }
+  }
+#endif
+
+#if FAILSAFE
+  // Hold neutral once after the failsafe forced it, and for as long as the
+  // sampler makes no new readings. The limiters start over from neutral.
+  if (failsafeTripped() || adcSamplerStalled()) {
+    pwmOutL   = PWM_NEUTRAL;
+    pwmOutR   = PWM_NEUTRAL;
+    errorPtrn = BLINK_2L;
+    errorL    = errorR = true;
+    limiterL.reset(PWM_NEUTRAL);
+    limiterR.reset(PWM_NEUTRAL);
+  }
+#endif
+
+  // Limit acceleration
+  pwmOutL = limiterL.step(pwmOutL);
+  pwmOutR = limiterR.step(pwmOutR);
+
+  // Set pwm outputs
+  writePWM(PWM_L, pwmOutL);
+  writePWM(PWM_R, pwmOutR);
+#if PWM_CHANNELS > 2
+  // Extra channels drive a second pair of thrusters alongside L and R
+  writePWM(PWM_3, pwmOutL);
+#endif
+#if PWM_CHANNELS > 3
+  writePWM(PWM_4, pwmOutR);
+#endif
+  TIMING_STOP(TIMING_LATENCY, adcSamplerStamp(INPUT_L));
+
+#if I2C_TARGET
+  // Report this update to the bus master
+  uint8_t status = (inputSWITCH == LOW ? I2C_STATUS_ARMED      : 0)
+                   | (detectclassified ? I2C_STATUS_CLASSIFIED : 0)
+                   | (inLIsConnected   ? I2C_STATUS_L          : 0)
+                   | (inRIsConnected   ? I2C_STATUS_R          : 0)
+                   | (inSPDIsConnected ? I2C_STATUS_SPD        : 0)
+                   | (inSTRIsConnected ? I2C_STATUS_STR        : 0);
+  if (errorPtrn == BLINK_3S || errorPtrn == BLINK_2L) {
+    status |= I2C_STATUS_FAULT;
+  }
+  updateI2CRegisters(status, pwmOutL, pwmOutR);
+#endif
+
+  // Leave the LEDs to refreshIndicator()
+  indicatedL        = pwmOutL;
+  indicatedR        = pwmOutR;
+  indicatedpatternL = errorL ? errorPtrn : 0;
+  indicatedpatternR = errorR ? errorPtrn : 0;
+
+#if BLACK_BOX
+  // Keep what this update saw and did, every BLACK_BOX_DT. A disconnected
+  // input follows the DETECT drive, so it is logged as 0 to save EEPROM.
+  BlackBoxSample sample = { {
+    (int16_t)((inLIsConnected || inSPDIsConnected) ? inputL/ADC_SCALE : 0),
+    (int16_t)(inRIsConnected ? inputR/ADC_SCALE : 0),
+    (int16_t)(inSTRIsConnected ? inputSTR/ADC_SCALE : 0),
+    (int16_t)pwmOutL, (int16_t)pwmOutR, (int16_t)errorPtrn,
+    (int16_t)((inputSWITCH == LOW ? BOX_ENABLED    : 0)
+              | (detectclassified ? BOX_CLASSIFIED : 0)
+              | (inLIsConnected   ? BOX_L          : 0)
+              | (inRIsConnected   ? BOX_R          : 0)
+              | (inSPDIsConnected ? BOX_SPD        : 0)
+              | (inSTRIsConnected ? BOX_STR        : 0)) } };
+  recordBlackBox(sample);
+#endif
+  TIMING_STOP(TIMING_UPDATE, updatestart);
+
+#if SLEEP_IDLE
+  // Disabled and settled at neutral, so nothing needs the inputs: stop
+  // sampling them and the CPU only wakes for Timer0. Timer1 carries on
+  // sending neutral pulses by itself. Detect finishes its first cycle
+  // first, so the switch can hand straight over to live control.
+  if (!lowpower && !warming && detectclassified && inputSWITCH == HIGH
+      && pwmOutL == PWM_NEUTRAL && pwmOutR == PWM_NEUTRAL) {
+    stopADCSampler();
+    lowpower = true;
+  }
+#endif
+
+#if TIMING_STATS
+  // Save the counters once the switch has brought the outputs to neutral,
+  // the EEPROM writes hold up loop() for a while
+  if (inputSWITCH == LOW) {
+    timingsaved = false;
+  } else if (!timingsaved && pwmOutL == PWM_NEUTRAL
+             && pwmOutR == PWM_NEUTRAL) {
+    saveTimingStats();
+    timingsaved = true;
+#if FAILSAFE
+    feedFailsafe(false);    // the save was meant to hold up the update
+#endif
+  }
+#endif
 
-    return;
+#if FAILSAFE
+  // Log faults while disabled at neutral, the EEPROM writes hold up loop()
+  if (inputSWITCH == HIGH && pwmOutL == PWM_NEUTRAL
+      && pwmOutR == PWM_NEUTRAL) {
+    saveFailsafeLog();
+  }
+#endif
+}
+
+// Set LEDs from the latest update, each on its own
+void refreshIndicator() {
+  if (indicatedpatternL == 0) {
+    // No errors on this side, display dimmer value
+    writeDimmer(LED_L, indicatedL);
+  } else {
+    // display error pattern
+    writeBlinker(LED_L, indicatedpatternL);
+  }
+  if (indicatedpatternR == 0) {
+    writeDimmer(LED_R, indicatedR);
+  } else {
+    writeBlinker(LED_R, indicatedpatternR);
   }
+}
 
-  // Update detect
-  if ((millis() - lastdetectruntime) > DETECT_DT*1000) {
-    // Record detect runtime
-    lastdetectruntime = millis();
 
-    // Re-run detect()
-    detect();
+// The enable switch, or with I2C_TARGET, where its pin is SCL, the arm state
+// sent by the bus master
+int readSwitch() {
+#if I2C_TARGET
+  return (busseen && buscommand.armed) ? LOW : HIGH;
+#else
+  return digitalRead(SWITCH);
+#endif
+}
 
-    return;
+// Only change a connected flag after DETECT_DEBOUNCE results in a row
+// disagree with it
+bool debounceDetect(bool connected, bool result, uint8_t *count) {
+  if (!detectclassified) {
+    // First result after power-up sets the state directly
+    *count = 0;
+    return result;
+  }
+  if (result == connected) {
+    *count = 0;
+    return connected;
+  }
+  if (++(*count) >= DETECT_DEBOUNCE) {
+    *count = 0;
+    return result;
   }
+  return connected;
 }
 
+#if RC_INPUT
+// A receiver's pulses leave the readings meaningless, so a pin with them is
+// connected. A silent receiver holds its pin at ground, which reads like a
+// pot at full astern: a pin stuck there counts as disconnected until it
+// sends pulses or moves off ground.
+bool detectRC(uint8_t pin, bool connected, int low) {
+  if (rcInputActive(pin)) {
+    return true;
+  }
+  return connected && low >= DETECT_LOW*ADC_SCALE;
+}
+#endif
 
 void detect() {
   // Detect what's connected by driving lines through 100k resistors
-  int inL[2], inR[2], inSPD[2], inSTR[2];   // 0:low, 1:high
-
-  // Drive both inputs high, wait, and log values
-  digitalWrite(DETECT,HIGH);
-  delay(10);
-  inL[1]   = analogRead(INPUT_L);
-  inR[1]   = analogRead(INPUT_R);
-  inSPD[1] = analogRead(INPUT_SPD);
-  inSTR[1] = analogRead(INPUT_STR);
-
-  // Drive both inputs low, wait, and log values
-  digitalWrite(DETECT,LOW);
-  delay(10);
-  inL[0]   = analogRead(INPUT_L);
-  inR[0]   = analogRead(INPUT_R);
-  inSPD[0] = analogRead(INPUT_SPD);
-  inSTR[0] = analogRead(INPUT_STR);
-
-  // If inputs follow, potentiometer is disconnected, otherwise it's connected
-  inLIsConnected   = !(inL[0]   < DETECT_LOW && inL[1]   > DETECT_HIGH);
-  inRIsConnected   = !(inR[0]   < DETECT_LOW && inR[1]   > DETECT_HIGH);
-  inSPDIsConnected = !(inSPD[0] < DETECT_LOW && inSPD[1] > DETECT_HIGH);
-  inSTRIsConnected = !(inSTR[0] < DETECT_LOW && inSTR[1] > DETECT_HIGH);
+  static int inL[2], inR[2], inSPD[2], inSTR[2];   // 0:low, 1:high
+
+#if FAILSAFE
+  // Look for a sampler stall on every step too, and force neutral right
+  // away instead of up to a frame later in the update
+  if (adcSamplerStalled()) {
+    tripFailsafe();
+  }
+#endif
+
+#if SLEEP_IDLE
+  // Hold the phase while the sampler is stopped or starting up again
+  if (lowpower || warming) {
+    return;
+  }
+#endif
+  if (detectwait > 0) {
+    detectwait--;
+    return;
+  }
+
+  switch (detectphase) {
+  case DETECT_START:
+    // Drive both inputs high
+    digitalWrite(DETECT,HIGH);
+    detectphase = DETECT_SETTLE_HIGH;
+    detectwait  = DETECT_SETTLE/DETECT_TICK - 1;
+    break;
+
+  case DETECT_SETTLE_HIGH:
+    // Settled, collect fresh readings for the next step
+    restartADCSampler();
+    detectphase = DETECT_SAMPLE_HIGH;
+    break;
+
+  case DETECT_SAMPLE_HIGH:
+    if (!adcSamplerReady()) {
+      break;
+    }
+    // Log values, then drive both inputs low
+    inL[1]   = readADCSampler(INPUT_L);
+    inR[1]   = readADCSampler(INPUT_R);
+    inSPD[1] = readADCSampler(INPUT_SPD);
+    inSTR[1] = readADCSampler(INPUT_STR);
+    digitalWrite(DETECT,LOW);
+    detectphase = DETECT_SETTLE_LOW;
+    detectwait  = DETECT_SETTLE/DETECT_TICK - 1;
+    break;
+
+  case DETECT_SETTLE_LOW:
+    // Settled, collect fresh readings for the next step
+    restartADCSampler();
+    detectphase = DETECT_SAMPLE_LOW;
+    break;
+
+  case DETECT_SAMPLE_LOW:
+    if (!adcSamplerReady()) {
+      break;
+    }
+    // Log values and decide
+    inL[0]   = readADCSampler(INPUT_L);
+    inR[0]   = readADCSampler(INPUT_R);
+    inSPD[0] = readADCSampler(INPUT_SPD);
+    inSTR[0] = readADCSampler(INPUT_STR);
+
+    // If inputs follow, potentiometer is disconnected, otherwise it's connected
+    inLIsConnected   = debounceDetect(inLIsConnected,
+                         !(inL[0]   < DETECT_LOW*ADC_SCALE
+                           && inL[1]   > DETECT_HIGH*ADC_SCALE), &inLCount);
+    inRIsConnected   = debounceDetect(inRIsConnected,
+                         !(inR[0]   < DETECT_LOW*ADC_SCALE
+                           && inR[1]   > DETECT_HIGH*ADC_SCALE), &inRCount);
+    inSPDIsConnected = debounceDetect(inSPDIsConnected,
+                         !(inSPD[0] < DETECT_LOW*ADC_SCALE
+                           && inSPD[1] > DETECT_HIGH*ADC_SCALE), &inSPDCount);
+    inSTRIsConnected = debounceDetect(inSTRIsConnected,
+                         !(inSTR[0] < DETECT_LOW*ADC_SCALE
+                           && inSTR[1] > DETECT_HIGH*ADC_SCALE), &inSTRCount);
+#if RC_INPUT
+    inLIsConnected   = detectRC(INPUT_L, inLIsConnected, inL[0]);
+    inRIsConnected   = detectRC(INPUT_R, inRIsConnected, inR[0]);
+    inSPDIsConnected = detectRC(INPUT_SPD, inSPDIsConnected, inSPD[0]);
+    inSTRIsConnected = detectRC(INPUT_STR, inSTRIsConnected, inSTR[0]);
+#endif
+#if SERIAL_COMMAND
+    // SERIAL_RX is the STR pin, where a line idling high would read as a
+    // pot at full steering
+    inSTRIsConnected = false;
+#endif
+    detectclassified = true;
+
+    // Start the next detect cycle DETECT_DT after this one started, seven
+    // steps in when both samples were ready on their first step
+    detectphase = DETECT_START;
+    detectwait  = (DETECT_DT - 2*DETECT_SETTLE)/DETECT_TICK - 3;
+    break;
+  }
 }
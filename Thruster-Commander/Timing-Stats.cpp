@@ -0,0 +1,147 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Timing Statistics
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#include "Timing-Stats.h"
+
+#if TIMING_STATS
+
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+
+namespace {
+TimingStat stats[TIMING_PROBES];
+
+// Timer1 ticks from start until now, across at most one wrap at TOP
+uint16_t ticksSince(uint16_t start) {
+  uint16_t now = timingNow();
+  if (now >= start) {
+    return now - start;
+  }
+  return now + (ICR1 + 1 - start);
+}
+
+uint8_t bucketOf(uint16_t ticks) {
+  uint8_t bucket = 0;
+  while (ticks >= 4 && bucket < TIMING_BUCKETS - 1) {
+    ticks >>= 2;
+    bucket++;
+  }
+  return bucket;
+}
+}
+
+///////////////
+// Functions //
+///////////////
+
+void initializeTimingStats() {
+  for (uint8_t i = 0; i < TIMING_PROBES; i++) {
+    memset(&stats[i], 0, sizeof(stats[i]));
+    stats[i].min = 0xffff;
+  }
+}
+
+// Timer1 count. TCNT1 is read through the shared 16-bit TEMP register, so
+// keep interrupts that time themselves out of the middle of the read.
+uint16_t timingNow() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t now = TCNT1;
+  SREG = sreg;
+  return now;
+}
+
+// Record the time since a TIMING_START() snapshot. Called from loop() and
+// from interrupts, but each probe only ever from one of them.
+void recordTiming(uint8_t probe, uint16_t start) {
+  uint16_t    ticks = ticksSince(start);
+  TimingStat *s     = &stats[probe];
+
+  s->last = ticks;
+  if (ticks < s->min) {
+    s->min = ticks;
+  }
+  if (ticks > s->max) {
+    s->max = ticks;
+  }
+  uint16_t *bucket = &s->histogram[bucketOf(ticks)];
+  if (*bucket != 0xffff) {
+    (*bucket)++;
+  }
+
+  // Count and sum stop together, so the mean stays right
+  if (s->count != 0xffff) {
+    s->count++;
+    s->sum += ticks;
+  }
+}
+
+// Copy the counters out, with the interrupts' probes held still
+void readTimingStats(TimingSnapshot *snapshot) {
+  static const uint16_t prescale[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+  snapshot->magic  = TIMING_MAGIC;
+  snapshot->probes = TIMING_PROBES;
+  snapshot->tickns = prescale[TCCR1B & 0x07]*(1000000000ul/CLOCK_FREQ);
+  cli();
+  memcpy(snapshot->stat, stats, sizeof(stats));
+  sei();
+}
+
+// Longest duration of one probe so far, to report while running
+uint16_t timingMax(uint8_t probe) {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t max = stats[probe].max;
+  SREG = sreg;
+  return max;
+}
+
+// Write the counters to EEPROM at TIMING_EEPROM. Only changed bytes are
+// written, but each takes 3.4 ms, so only call this with the outputs idle.
+// A whole snapshot outlasts the failsafe watchdog, which is fed per byte.
+void saveTimingStats() {
+  TimingSnapshot snapshot;
+  readTimingStats(&snapshot);
+  const uint8_t *src = (const uint8_t*)&snapshot;
+  for (uint8_t i = 0; i < sizeof(snapshot); i++) {
+    eeprom_update_byte((uint8_t*)TIMING_EEPROM + i, src[i]);
+    wdt_reset();
+  }
+}
+
+#endif
@@ -0,0 +1,94 @@
+/* Blue Robotics Thruster Commander Firmware
+-----------------------------------------------------
+
+Title: Blue Robotics Thruster Commander Firmware - Timing Statistics
+
+Description: This code is the default firmware for the Blue Robotics
+Thruster Commander, which provides a simple interface to control a
+bidirectional speed controller with PWM signals. It can be used to test
+motors or to control simple vehicles like a kayak.
+
+The code is designed for the ATtiny84 microcontroller and can be compiled and
+uploaded via the Arduino 1.0+ software.
+
+-------------------------------
+The MIT License (MIT)
+
+Copyright (c) 2017 Blue Robotics Inc.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/
+
+#ifndef TIMINGSTATS
+#define TIMINGSTATS
+
+#include <Arduino.h>
+#include "Thruster-Commander.h"
+
+// What is timed
+enum TimingProbe {
+  TIMING_UPDATE,            // PWM update block in loop()
+  TIMING_DETECT,            // one detect() phase
+  TIMING_INDICATOR,         // indicator interrupt
+  TIMING_LATENCY,           // input sample to writePWM()
+  TIMING_PROBES
+};
+
+// Durations are in Timer1 ticks, taken from TCNT1 snapshots. A duration
+// longer than one Timer1 period (one PWM frame) reads as that much shorter.
+// Histogram bucket n counts durations of 4^n to 4^(n+1)-1 ticks (0-3 for 0).
+// Min, max and the other buckets keep going once a count has stopped.
+#define TIMING_BUCKETS  8
+
+struct TimingStat {
+  uint32_t  sum;            // of the durations counted
+  uint16_t  count;          // stops counting at 65535
+  uint16_t  min;
+  uint16_t  max;
+  uint16_t  last;
+  uint16_t  histogram[TIMING_BUCKETS];  // each stops at 65535
+};
+
+// What goes to EEPROM, the same layout on the ATtiny and the host
+#define TIMING_MAGIC    0x54
+struct TimingSnapshot {
+  uint8_t    magic;
+  uint8_t    probes;
+  uint16_t   tickns;        // length of a Timer1 tick
+  TimingStat stat[TIMING_PROBES];
+};
+
+#if TIMING_STATS
+// Function Declarations
+void     initializeTimingStats();
+uint16_t timingNow();
+void     recordTiming(uint8_t probe, uint16_t start);
+void     readTimingStats(TimingSnapshot *snapshot);
+uint16_t timingMax(uint8_t probe);
+void     saveTimingStats();
+
+// Timer1 count now, to pass to recordTiming() later
+#define TIMING_START(name)          uint16_t name = timingNow()
+#define TIMING_STOP(probe, name)    recordTiming(probe, name)
+#else
+#define TIMING_START(name)
+#define TIMING_STOP(probe, name)
+#endif
+
+#endif
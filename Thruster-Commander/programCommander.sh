@@ -1,46 +1,175 @@
 #!/bin/bash
 
+# Flashes Thruster Commanders, one per programmer, all at once.
+#
+#   ./programCommander.sh [-b] [-c programmer] [-f hexfile] [-t seconds]
+#                         [port ...]
+#
+# Each port is an avrdude -P argument that picks one programmer, such as
+# usb:<serial number>, and gets its own board. With no port, the one
+# programmer avrdude finds is used. The image is the checked-in Arduino
+# build unless -f names another. -b builds one from these sources in
+# ../Bare-Metal first and flashes that instead; that build is experimental
+# until it has been verified on hardware. Fuses are read first and only
+# written if they differ. Set AVRDUDE to run another avrdude, such as the
+# stub in ../Simulator.
+
 # Color definitions
-BLACK='\033[;30m'
 RED='\033[0;31m'
 GREEN='\033[0;32m'
 BLUE='\033[0;34m'
-PURPLE='\033[0;35m'
-YELLOW='\033[1;33m'
-WHITE='\033[1;37m'
 NC='\033[0m'
+if [ ! -t 1 ]; then
+  RED= GREEN= BLUE= NC=
+fi
 
 
 # Configuration
-avrdude="avrdude"
+avrdude="${AVRDUDE:-avrdude}"
 programmer="usbtiny"
-conffile="/etc/avrdude.conf"
 microcontroller="t84"
-hexfile="Thruster-Commander.ino.tiny14.hex"
+baremetal="$(dirname "$0")/../Bare-Metal"
+hexfile="$(dirname "$0")/Thruster-Commander.ino.tiny14.hex"
+build=false                           # -b: the experimental bare-metal build
+timeout=60                            # seconds for each avrdude run
+lfuse="0xfe"                          # 8 MHz crystal, no clock divider
+hfuse="0xdf"
+efuse="0xff"
 
-# Flash Thruster Commander
-echo "Starting Thruster Commander Flash Sequence..."
+usage() {
+  echo "Usage: $0 [-b] [-c programmer] [-f hexfile] [-t seconds]" \
+       "[port ...]" >&2
+  exit 2
+}
+
+while getopts "bc:f:t:h" opt; do
+  case $opt in
+  b) build=true ;;
+  c) programmer="$OPTARG" ;;
+  f) hexfile="$OPTARG" ;;
+  t) timeout="$OPTARG" ;;
+  *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+ports=("$@")
+if [ ${#ports[@]} -eq 0 ]; then
+  ports=("")
+fi
+if $build; then
+  echo "Building the experimental bare-metal image in $baremetal..."
+  if ! make -s -C "$baremetal"; then
+    echo -e "${RED}Build failed, nothing flashed${NC}" >&2
+    exit 2
+  fi
+  hexfile="$baremetal/build/Thruster-Commander.hex"
+fi
+if [ ! -r "$hexfile" ]; then
+  echo -e "${RED}No image at $hexfile${NC}" >&2
+  exit 2
+fi
+
+now() {
+  date +%s.%N
+}
 
-#Write program and set fuses
-$avrdude -c$programmer -p$microcontroller -e -Uefuse:w:0xff:m -Uhfuse:w:0xdf:m -Ulfuse:w:0xfe:m -Uflash:w:$hexfile 2>&1 | tee programcommander.log
+# avrdude for one board, killed if it takes longer than the timeout
+runAvrdude() {
+  local port="$1"
+  shift
+  timeout "$timeout" "$avrdude" -c"$programmer" -p"$microcontroller" \
+    ${port:+-P"$port"} "$@"
+}
 
-echo -e "${BLUE}=========RESULT=========="
-echo -e "${GREEN}"
-grep "bytes of flash verified" programcommander.log
-grep "avrdude: safemode: Fuses OK" programcommander.log
-echo -e "${RED}"
-grep "mismatch" programcommander.log
-echo -e "${NC}"
-echo -e "${BLUE}========================="
-echo -e "${NC}"
+# Flash one board. Writes "fuses flash seconds" to the result file: fuses is
+# matched, written or - if never read, flash is verified, mismatch, timeout
+# or error. Everything avrdude said goes to the log.
+flashBoard() {
+  local port="$1" log="$2" result="$3"
+  local start fuses flash status
+  local writes=()
 
-rm programcommander.log
+  start=$(now)
+  fuses="-"
 
-echo -e "${GREEN}Done. Please check for proper verification.${NC}"
+  # Read the fuses, write them only if they differ
+  local current
+  current=$(runAvrdude "$port" -q -q -Ulfuse:r:-:h -Uhfuse:r:-:h \
+            -Uefuse:r:-:h 2>>"$log")
+  status=$?
+  if [ $status -eq 0 ]; then
+    current=$(echo $current | tr 'A-F' 'a-f')
+    if [ "$current" = "$lfuse $hfuse $efuse" ]; then
+      fuses="matched"
+    else
+      echo "fuses read $current, writing $lfuse $hfuse $efuse" >>"$log"
+      fuses="written"
+      writes=(-Uefuse:w:$efuse:m -Uhfuse:w:$hfuse:m -Ulfuse:w:$lfuse:m)
+    fi
+
+    # avrdude erases the chip before writing flash, and verifies both
+    runAvrdude "$port" "${writes[@]}" -Uflash:w:"$hexfile":i >>"$log" 2>&1
+    status=$?
+  fi
+
+  if [ $status -eq 0 ]; then
+    flash="verified"
+  elif [ $status -eq 124 ]; then
+    flash="timeout"
+  elif grep -qi "mismatch" "$log"; then
+    flash="mismatch"
+  else
+    flash="error"
+  fi
+  echo "$fuses $flash $(echo "$start $(now)" | awk '{print $2 - $1}')" \
+    >"$result"
+}
+
+# Flash Thruster Commander
+while true; do
+  echo "Starting Thruster Commander Flash Sequence on ${#ports[@]} board(s)..."
 
-echo -e "${GREEN}Press any key to repeat or Ctrl-C to quit.${NC}"
-read -n 1 -s
+  logs=$(mktemp -d)
+  start=$(now)
+  for i in "${!ports[@]}"; do
+    flashBoard "${ports[$i]}" "$logs/$i.log" "$logs/$i.result" &
+  done
+  wait
+  elapsed=$(echo "$start $(now)" | awk '{print $2 - $1}')
 
-./programCommander.sh
+  echo -e "${BLUE}=========RESULT==========${NC}"
+  printf "  %-5s %-24s %-8s %-9s %8s  %s\n" \
+    "board" "port" "fuses" "flash" "seconds" "result"
+  passed=0
+  for i in "${!ports[@]}"; do
+    read fuses flash seconds <"$logs/$i.result"
+    if [ "$flash" = "verified" ]; then
+      passed=$((passed + 1))
+      color=$GREEN
+      outcome="PASS"
+    else
+      color=$RED
+      outcome="FAIL, see $logs/$i.log"
+    fi
+    printf "  %-5s %-24s %-8s %-9s %8.1f  ${color}%s${NC}\n" \
+      "$((i + 1))" "${ports[$i]:-default}" "$fuses" "$flash" "$seconds" \
+      "$outcome"
+  done
+  echo -e "${BLUE}=========================${NC}"
+  printf "%d of %d board(s) passed in %.1f s\n" "$passed" "${#ports[@]}" \
+    "$elapsed"
 
+  # Keep the logs only if there is a failure to look into
+  if [ $passed -eq ${#ports[@]} ]; then
+    rm -rf "$logs"
+  fi
 
+  # Repeat for the next set of boards when run by hand
+  if [ ! -t 0 ]; then
+    [ $passed -eq ${#ports[@]} ]
+    exit
+  fi
+  echo -e "${GREEN}Press any key to repeat or Ctrl-C to quit.${NC}"
+  read -n 1 -s
+done